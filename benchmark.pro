@@ -0,0 +1,52 @@
+# Standalone benchmark for the CPU side of the sim; needs no GL context or window.
+# Run it with --out results.json and diff the output between commits.
+
+TARGET = benchmark
+
+HEADERS = \
+   $$PWD/opengl_physics/arrayND.hpp \
+   $$PWD/opengl_physics/voxelStorage.hpp \
+   $$PWD/opengl_physics/faceOrder.hpp \
+   $$PWD/opengl_physics/occupancyGrid.hpp \
+   $$PWD/opengl_physics/shapes.hpp \
+   $$PWD/opengl_physics/physState.hpp \
+   $$PWD/opengl_physics/cpuSim.hpp \
+   $$PWD/opengl_physics/constraints.hpp \
+   $$PWD/opengl_physics/bounds.hpp \
+   $$PWD/opengl_physics/quaternion.hpp \
+   $$PWD/opengl_physics/workerPool.hpp \
+   $$PWD/opengl_physics/diagnostics.hpp \
+   $$PWD/opengl_physics/mappedFile.hpp \
+   $$PWD/opengl_physics/topologyFile.hpp \
+   $$PWD/opengl_physics/slabTopology.hpp \
+   $$PWD/opengl_physics/topologyCache.hpp \
+   $$PWD/opengl_physics/rewind.hpp \
+   $$PWD/opengl_physics/surfaceSkin.hpp \
+   $$PWD/opengl_physics/surfacePicker.hpp \
+   $$PWD/opengl_physics/surfaceLod.hpp
+
+SOURCES = \
+   $$PWD/opengl_physics/benchmark.cpp \
+   $$PWD/opengl_physics/voxelStorage.cpp \
+   $$PWD/opengl_physics/faceOrder.cpp \
+   $$PWD/opengl_physics/occupancyGrid.cpp \
+   $$PWD/opengl_physics/shapes.cpp \
+   $$PWD/opengl_physics/physState.cpp \
+   $$PWD/opengl_physics/cpuSim.cpp \
+   $$PWD/opengl_physics/constraints.cpp \
+   $$PWD/opengl_physics/bounds.cpp \
+   $$PWD/opengl_physics/workerPool.cpp \
+   $$PWD/opengl_physics/diagnostics.cpp \
+   $$PWD/opengl_physics/mappedFile.cpp \
+   $$PWD/opengl_physics/topologyFile.cpp \
+   $$PWD/opengl_physics/slabTopology.cpp \
+   $$PWD/opengl_physics/topologyCache.cpp \
+   $$PWD/opengl_physics/rewind.cpp \
+   $$PWD/opengl_physics/surfaceSkin.cpp \
+   $$PWD/opengl_physics/surfacePicker.cpp \
+   $$PWD/opengl_physics/surfaceLod.cpp
+
+INCLUDEPATH = $$PWD/opengl_physics/include/
+
+CONFIG += c++14 thread console release
+CONFIG -= qt app_bundle
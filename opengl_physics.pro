@@ -8,6 +8,34 @@ HEADERS = \
    $$PWD/opengl_physics/bridge.hpp \
    $$PWD/opengl_physics/loaders.hpp \
    $$PWD/opengl_physics/voxels.hpp \
+   $$PWD/opengl_physics/voxelStorage.hpp \
+   $$PWD/opengl_physics/physState.hpp \
+   $$PWD/opengl_physics/cpuSim.hpp \
+   $$PWD/opengl_physics/quaternion.hpp \
+   $$PWD/opengl_physics/quaternionBatch.hpp \
+   $$PWD/opengl_physics/workerPool.hpp \
+   $$PWD/opengl_physics/diagnostics.hpp \
+   $$PWD/opengl_physics/occupancyGrid.hpp \
+   $$PWD/opengl_physics/shapes.hpp \
+   $$PWD/opengl_physics/mappedFile.hpp \
+   $$PWD/opengl_physics/voxelImport.hpp \
+   $$PWD/opengl_physics/topologyFile.hpp \
+   $$PWD/opengl_physics/slabTopology.hpp \
+   $$PWD/opengl_physics/topologyCache.hpp \
+   $$PWD/opengl_physics/checkpoint.hpp \
+   $$PWD/opengl_physics/replay.hpp \
+   $$PWD/opengl_physics/rewind.hpp \
+   $$PWD/opengl_physics/surfaceSkin.hpp \
+   $$PWD/opengl_physics/meshExport.hpp \
+   $$PWD/opengl_physics/surfacePicker.hpp \
+   $$PWD/opengl_physics/constraints.hpp \
+   $$PWD/opengl_physics/bounds.hpp \
+   $$PWD/opengl_physics/bodyBatch.hpp \
+   $$PWD/opengl_physics/stateRing.hpp \
+   $$PWD/opengl_physics/surfaceLod.hpp \
+   $$PWD/opengl_physics/faceOrder.hpp \
+   $$PWD/opengl_physics/frameScheduler.hpp \
+   $$PWD/opengl_physics/programCache.hpp \
     opengl_physics/input.hpp
 
 SOURCES = \
@@ -16,11 +44,38 @@ SOURCES = \
    $$PWD/opengl_physics/loaders.cpp \
    $$PWD/opengl_physics/main.cpp \
    $$PWD/opengl_physics/voxels.cpp \
+   $$PWD/opengl_physics/voxelStorage.cpp \
+   $$PWD/opengl_physics/physState.cpp \
+   $$PWD/opengl_physics/cpuSim.cpp \
+   $$PWD/opengl_physics/quaternionBatch.cpp \
+   $$PWD/opengl_physics/workerPool.cpp \
+   $$PWD/opengl_physics/diagnostics.cpp \
+   $$PWD/opengl_physics/occupancyGrid.cpp \
+   $$PWD/opengl_physics/shapes.cpp \
+   $$PWD/opengl_physics/mappedFile.cpp \
+   $$PWD/opengl_physics/voxelImport.cpp \
+   $$PWD/opengl_physics/topologyFile.cpp \
+   $$PWD/opengl_physics/slabTopology.cpp \
+   $$PWD/opengl_physics/topologyCache.cpp \
+   $$PWD/opengl_physics/checkpoint.cpp \
+   $$PWD/opengl_physics/replay.cpp \
+   $$PWD/opengl_physics/rewind.cpp \
+   $$PWD/opengl_physics/surfaceSkin.cpp \
+   $$PWD/opengl_physics/meshExport.cpp \
+   $$PWD/opengl_physics/surfacePicker.cpp \
+   $$PWD/opengl_physics/constraints.cpp \
+   $$PWD/opengl_physics/bounds.cpp \
+   $$PWD/opengl_physics/bodyBatch.cpp \
+   $$PWD/opengl_physics/stateRing.cpp \
+   $$PWD/opengl_physics/surfaceLod.cpp \
+   $$PWD/opengl_physics/faceOrder.cpp \
+   $$PWD/opengl_physics/frameScheduler.cpp \
+   $$PWD/opengl_physics/programCache.cpp \
     opengl_physics/input.cpp
 
 INCLUDEPATH = $$PWD/opengl_physics/include/
 
-CONFIG += c++14
+CONFIG += c++14 thread
 
 LIBS += -ldl -lglfw
 
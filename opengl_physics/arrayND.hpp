@@ -3,117 +3,241 @@
 
 #include <vector>
 #include <array>
+#include <stdexcept>
+#include <cstddef>
 
 
 
 namespace {
-template<typename arrayT, typename innerT, unsigned int n, unsigned int newN>
-struct subArrayBase {
+// arr[x][y][z] goes through these. Each level only carries the linear offset so far, so it costs the same as computing the index by hand.
+template<typename arrayT, unsigned int newN>
+struct subArray {
 	arrayT* theArr;
-	size_t indices[n - newN];
-	
-	subArrayBase(arrayT* theArr): theArr(theArr) {};
-};
-template<typename arrayT, typename innerT, unsigned int n, unsigned int newN>
-struct subArray : public subArrayBase<arrayT, innerT, n, newN> {
-	using subArrayBase<arrayT, innerT, n, newN>::subArrayBase;
-	
-	typedef subArray<arrayT, innerT, n, newN-1> under;
-	inline under operator[](size_t i) {
-		under toReturn((this->theArr));
-		
-		for (int j = 0; j < n - newN; ++j) {
-			toReturn.indices[j] = this->indices[j];
-		}
-		toReturn.indices[n - newN] = i;
-		
-		return toReturn;
+	size_t offset;
+
+	typedef subArray<arrayT, newN-1> under;
+	inline under operator[](size_t i) const {
+		return under{ theArr, offset + i * theArr->strides[arrayT::dimensions - newN] };
 	}
 };
-template<typename arrayT, typename innerT, unsigned int n>
-struct subArray<arrayT, innerT, n, 1> : public subArrayBase<arrayT, innerT, n, 1> {
-	using subArrayBase<arrayT, innerT, n, 1>::subArrayBase;
-	
-	typedef innerT under;
-	
-	inline typename arrayT::containerT::reference operator[](size_t i) {
-		size_t accumulatedStride = 1;
-		size_t idx = 0;
-		for (int j = 0; j < n - 1; ++j) {
-			idx += this->indices[j] * accumulatedStride;
-			accumulatedStride *= this->theArr->sizes[j];
-		}
-		idx += i * accumulatedStride;
-		return this->theArr->linear()[idx];
+template<typename arrayT>
+struct subArray<arrayT, 1> {
+	arrayT* theArr;
+	size_t offset;
+
+	inline typename arrayT::containerT::reference operator[](size_t i) const {
+		return theArr->linear()[offset + i * theArr->strides[arrayT::dimensions - 1]];
 	}
 };
 }
 
+// A run of elements that are next to each other in memory, like one x row or one z slab
+template<typename iteratorT>
+struct arrayNDRange {
+	iteratorT first, last;
+	iteratorT begin() const { return first; }
+	iteratorT end() const { return last; }
+	size_t size() const { return last - first; }
+};
+
+// The first coordinate is the one that's contiguous in memory, so loops should have it innermost
 template<typename innerT, unsigned int n>
 class arrayND : public std::vector<innerT> {
-	
+
 public:
+	static constexpr unsigned int dimensions = n;
 	typedef std::vector<innerT> containerT;
 	typedef std::array<size_t, n> sizesT;
+	// Linear offset to the element one further along each coordinate
+	typedef std::array<ptrdiff_t, 2 * n> faceStencilT;
+	typedef std::array<ptrdiff_t, (1 << n)> cornerStencilT;
+	typedef arrayNDRange<typename containerT::iterator> rangeT;
+
 	sizesT sizes;
+	// Cached from sizes; strides[0] is always 1
+	sizesT strides;
+
 	explicit arrayND(sizesT sizes) : sizes(sizes) {
+		updateStrides();
 		containerT::resize(total());
 		static_assert(sizes.size() == n, "you must provide n dimensions");
 		static_assert(n >= 2, "must have at least 2 dimensions");
 	};
 	explicit arrayND(sizesT sizes, innerT initValue)
 	: sizes(sizes) {
+		updateStrides();
 		containerT::resize(total(), initValue);
 		static_assert(sizes.size() == n, "you must provide n dimensions");
 		static_assert(n >= 2, "must have at least 2 dimensions");
 	}
-	
-	typedef subArray<arrayND<innerT, n>, innerT, n, n-1> under;
+
+	typedef subArray<arrayND<innerT, n>, n-1> under;
 	inline under operator[](size_t i) {
-		
-		under toReturn(this);
-		toReturn.indices[0] = i;
-		return toReturn;
-	}
-	size_t total() {
-		size_t total = 1;
-		for (int i = 0; i < n; ++i) {
-			total *= sizes[i];
-		}
-		return total;
+		return under{ this, i };
+	}
+	size_t total() const {
+		return strides[n - 1] * sizes[n - 1];
 	}
 	containerT& linear() {
 		return *this;
 	}
-	sizesT ind2coord(size_t i) {
+	const containerT& linear() const {
+		return *this;
+	}
+	sizesT ind2coord(size_t i) const {
 		sizesT coords;
-		for (int j = 0; j < n; ++j) {
+		for (unsigned int j = 0; j < n; ++j) {
 			coords[j] = i % this->sizes[j];
 			i /= this->sizes[j];
 		}
 		return coords;
 	}
-	size_t coord2ind(sizesT coords) {
-		size_t accumulatedStride = 1;
-		size_t idx = 0;
-		for (int j = 0; j < n; ++j) {
-			if (coords[j] >= sizes[j]) throw std::out_of_range("arrayND coord2ind");
-			idx += coords[j] * accumulatedStride;
-			accumulatedStride *= this->sizes[j];
-		}
-		return idx;
+	size_t coord2ind(sizesT coords) const {
+		if (!inBounds(coords)) throw std::out_of_range("arrayND coord2ind");
+		return index(coords);
 	}
 	inline typename containerT::reference operator[](sizesT coord) {
 		return linear()[coord2ind(coord)];
 	}
-	bool inBounds(sizesT coord) {
-		for (int i = 0; i < n; ++i) {
+	bool inBounds(sizesT coord) const {
+		for (unsigned int i = 0; i < n; ++i) {
 			if (coord[i] >= sizes[i]) return false;
 		}
 		return true;
 	}
-	bool inBounds(ssize_t i) {
-		return i >= 0 && i < total();
+	bool inBounds(ssize_t i) const {
+		return i >= 0 && (size_t) i < total();
+	}
+
+	// Unchecked. For hot loops that have already made sure the coordinates are in range.
+	inline size_t index(sizesT coords) const {
+		size_t idx = 0;
+		for (unsigned int j = 0; j < n; ++j) {
+			idx += coords[j] * strides[j];
+		}
+		return idx;
+	}
+	template<typename first, typename... coordsT>
+	inline size_t index(first x, coordsT... rest) const {
+		static_assert(sizeof...(rest) == n - 1, "you must provide n coordinates");
+		// strides[0] is always 1
+		return (size_t) x + indexFrom(1, rest...);
+	}
+	template<typename... coordsT>
+	inline typename containerT::reference operator()(coordsT... coords) {
+		return linear()[index(coords...)];
+	}
+	template<typename... coordsT>
+	inline typename containerT::const_reference operator()(coordsT... coords) const {
+		return linear()[index(coords...)];
+	}
+
+	// All of the first coordinate, at the given values of the others
+	template<typename... coordsT>
+	rangeT row(coordsT... rest) {
+		static_assert(sizeof...(rest) == n - 1, "you must provide n - 1 coordinates");
+		auto first = containerT::begin() + index((size_t) 0, rest...);
+		return rangeT{ first, first + sizes[0] };
+	}
+	// Everything at one value of the last coordinate
+	rangeT slab(size_t last) {
+		auto first = containerT::begin() + last * strides[n - 1];
+		return rangeT{ first, first + strides[n - 1] };
+	}
+
+	// In the order -x, -y, -z, +x, +y, +z, same as VoxelStorage::CubeData. Only valid away from the edges.
+	faceStencilT faceStencil() const {
+		faceStencilT stencil;
+		for (unsigned int j = 0; j < n; ++j) {
+			stencil[j] = -(ptrdiff_t) strides[j];
+			stencil[j + n] = strides[j];
+		}
+		return stencil;
+	}
+	// Offsets of the 2^n elements in the box starting at an element, with bit j of the position set meaning +1 along coordinate j.
+	// Same order as VoxelStorage::VertNeighbors, once the base is moved back one along every coordinate.
+	cornerStencilT cornerStencil() const {
+		cornerStencilT stencil;
+		for (unsigned int i = 0; i < stencil.size(); ++i) {
+			stencil[i] = 0;
+			for (unsigned int j = 0; j < n; ++j) {
+				if (i & (1 << j)) stencil[i] += strides[j];
+			}
+		}
+		return stencil;
+	}
+
+private:
+	inline size_t indexFrom(unsigned int) const { return 0; }
+	template<typename... coordsT>
+	inline size_t indexFrom(unsigned int j, size_t first, coordsT... rest) const {
+		return first * strides[j] + indexFrom(j + 1, rest...);
+	}
+	void updateStrides() {
+		size_t accumulatedStride = 1;
+		for (unsigned int j = 0; j < n; ++j) {
+			strides[j] = accumulatedStride;
+			accumulatedStride *= sizes[j];
+		}
+	}
+};
+template<typename innerT, unsigned int n>
+constexpr unsigned int arrayND<innerT, n>::dimensions;
+
+
+namespace {
+template<size_t... extents>
+struct fixedExtents;
+template<>
+struct fixedExtents<> {
+	static constexpr size_t total = 1;
+	static constexpr size_t stride(unsigned int) { return 1; }
+};
+template<size_t first, size_t... rest>
+struct fixedExtents<first, rest...> {
+	static constexpr size_t total = first * fixedExtents<rest...>::total;
+	// The first extent is the contiguous one, same as arrayND
+	static constexpr size_t stride(unsigned int j) { return j == 0 ? 1 : first * fixedExtents<rest...>::stride(j - 1); }
+};
+}
+
+// Same layout as arrayND, with the sizes known at compile time, so every stride is a constant and there's no heap allocation
+template<typename innerT, size_t... extents>
+class fixedArrayND : public std::array<innerT, fixedExtents<extents...>::total> {
+	typedef fixedExtents<extents...> extentsT;
+
+public:
+	static constexpr unsigned int dimensions = sizeof...(extents);
+	typedef std::array<innerT, extentsT::total> containerT;
+	typedef std::array<size_t, dimensions> sizesT;
+
+	static constexpr size_t total() { return extentsT::total; }
+	static constexpr size_t stride(unsigned int j) { return extentsT::stride(j); }
+	static constexpr sizesT sizes() { return sizesT{{ extents... }}; }
+
+	containerT& linear() {
+		return *this;
+	}
+
+	template<typename... coordsT>
+	static constexpr size_t index(coordsT... coords) {
+		static_assert(sizeof...(coords) == dimensions, "you must provide one coordinate per extent");
+		return indexFrom(0, coords...);
+	}
+	template<typename... coordsT>
+	inline innerT& operator()(coordsT... coords) {
+		return (*this)[index(coords...)];
+	}
+	template<typename... coordsT>
+	inline const innerT& operator()(coordsT... coords) const {
+		return (*this)[index(coords...)];
+	}
+
+private:
+	static constexpr size_t indexFrom(unsigned int) { return 0; }
+	template<typename... coordsT>
+	static constexpr size_t indexFrom(unsigned int j, size_t first, coordsT... rest) {
+		return first * stride(j) + indexFrom(j + 1, rest...);
 	}
 };
 
@@ -0,0 +1,522 @@
+// Standalone benchmark for the parts of the sim that don't need a GL context.
+// Writes one JSON object per run, with keys in a fixed order so runs from two commits can be diffed directly.
+//
+// benchmark [--radii 5,10,25,50,100,200] [--threads 1,2,4] [--steps 20] [--scene 1024] [--out results.json]
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <thread>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "voxels.hpp"
+#include "voxelStorage.hpp"
+#include "occupancyGrid.hpp"
+#include "shapes.hpp"
+#include "cpuSim.hpp"
+#include "topologyFile.hpp"
+#include "topologyCache.hpp"
+#include "rewind.hpp"
+#include "surfaceSkin.hpp"
+#include "surfacePicker.hpp"
+#include "surfaceLod.hpp"
+
+
+// Every allocation in the process goes through these, so each benchmark can report how many it made. The whole family is replaced, so
+// whichever form something is allocated with, it's counted and freed the same way.
+static std::atomic<uint64_t> allocationCount(0), allocationBytes(0);
+
+static void* countedAlloc(size_t size, size_t alignment) {
+	++allocationCount;
+	allocationBytes += size;
+	void* p = nullptr;
+	if (alignment <= alignof(std::max_align_t)) p = malloc(size ? size : 1);
+	else if (posix_memalign(&p, alignment, size ? size : 1) != 0) p = nullptr;
+	return p;
+}
+
+// GCC sees these free pointers that came from operator new once they're inlined into callers, and warns that they don't match,
+// not knowing operator new is also replaced here to get them from malloc
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t size) {
+	if (void* p = countedAlloc(size, 0)) return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+	if (void* p = countedAlloc(size, 0)) return p;
+	throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size, 0); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t alignment) {
+	if (void* p = countedAlloc(size, (size_t) alignment)) return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+	if (void* p = countedAlloc(size, (size_t) alignment)) return p;
+	throw std::bad_alloc();
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAlloc(size, (size_t) alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAlloc(size, (size_t) alignment); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { free(p); }
+#endif
+
+#pragma GCC diagnostic pop
+
+
+namespace {
+
+uint64_t peakRssBytes() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+}
+
+struct Result {
+	std::string name;
+	float radius;
+	unsigned threads;
+	size_t cubes;
+	// Cube-steps for the solver, cubes for everything else. For the indexing benchmarks cubes is a checksum.
+	double items;
+	double seconds;
+	uint64_t allocations, allocatedBytes;
+	// Of the whole process so far; it only ever goes up, so smaller radii should be run first
+	uint64_t peakRss;
+	// For solver runs with diagnostics on: how far the total energy moved from the first step to the last, relative to where it started. null otherwise.
+	double energyDrift = NAN;
+};
+
+// Times func, along with the allocations it makes
+template<typename Func>
+Result measure(const std::string& name, float radius, unsigned threads, Func func) {
+	Result result;
+	result.name = name;
+	result.radius = radius;
+	result.threads = threads;
+	uint64_t allocsBefore = allocationCount, bytesBefore = allocationBytes;
+	auto start = std::chrono::steady_clock::now();
+	func(result);
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.allocations = allocationCount - allocsBefore;
+	result.allocatedBytes = allocationBytes - bytesBefore;
+	result.peakRss = peakRssBytes();
+	return result;
+}
+
+// Runs steps solver steps, ping-ponging between two copies of the state. With diagnostics, gives the energy drift as Result::energyDrift has it.
+template<typename T>
+double runSteps(CpuSimT<T>& sim, std::vector<PhysData3DT<T>> (&data3D)[2], std::vector<PhysData4DT<T>> (&data4D)[2], int steps, StepDiagnostics* diagnostics = nullptr) {
+	double startEnergy = 0;
+	for (int i = 0; i < steps; ++i) {
+		int cur = i % 2, next = 1 - cur;
+		sim.step(data3D[cur].data(), data4D[cur].data(), data3D[next].data(), data4D[next].data(), nullptr, (T) PHYS_TIME_DELTA, diagnostics);
+		if (diagnostics && i == 0) startEnergy = diagnostics->totalEnergy();
+	}
+	if (!diagnostics) return NAN;
+	return std::abs(diagnostics->totalEnergy() - startEnergy) / std::max(std::abs(startEnergy), 1e-9);
+}
+
+// multiStep with diagnostics on, from the starting state, so float and double can be compared on both speed and how well they keep energy
+template<typename T>
+Result measureEnergyDrift(const std::string& name, const TopologyView& voxels, float radius, unsigned threads, int steps) {
+	CpuSimT<T> sim(voxels, threads);
+	std::vector<PhysData3DT<T>> data3D[2];
+	std::vector<PhysData4DT<T>> data4D[2];
+	for (int i = 0; i < 2; ++i) initPhysState<T>(voxels, data3D[i], data4D[i]);
+	StepDiagnostics diagnostics;
+	return measure(name, radius, sim.numThreads(), [&](Result& r) {
+		r.energyDrift = runSteps(sim, data3D, data4D, steps, &diagnostics);
+		r.cubes = sim.numCubes();
+		r.items = (double) sim.numCubes() * steps;
+	});
+}
+
+// Every way of reading an arrayND, against hand-written flat indexing. Each sums the neighbors along -x, -y and -z,
+// the pattern setCubes uses, so there's some arithmetic for the index math to hide behind or not.
+void benchmarkIndexing(const arrayND<bool, 3>& shape, float radius, std::vector<Result>& results) {
+	arrayND<int32_t, 3> values(shape.sizes);
+	for (size_t i = 0; i < shape.total(); ++i) values.linear()[i] = shape.linear()[i];
+	const size_t sizeX = values.sizes[0], sizeY = values.sizes[1], sizeZ = values.sizes[2];
+	const size_t items = (sizeX - 1) * (sizeY - 1) * (sizeZ - 1);
+
+	results.push_back(measure("arrayNDFlat", radius, 1, [&](Result& r) {
+		const int32_t* data = values.data();
+		int64_t sum = 0;
+		for (size_t z = 1; z < sizeZ; ++z)
+		for (size_t y = 1; y < sizeY; ++y)
+		for (size_t x = 1; x < sizeX; ++x) {
+			size_t i = x + sizeX * (y + sizeY * z);
+			sum += data[i - 1] + data[i - sizeX] + data[i - sizeX * sizeY];
+		}
+		r.items = items;
+		r.cubes = sum;
+	}));
+	results.push_back(measure("arrayNDProxy", radius, 1, [&](Result& r) {
+		int64_t sum = 0;
+		for (size_t z = 1; z < sizeZ; ++z)
+		for (size_t y = 1; y < sizeY; ++y)
+		for (size_t x = 1; x < sizeX; ++x) {
+			sum += values[x - 1][y][z] + values[x][y - 1][z] + values[x][y][z - 1];
+		}
+		r.items = items;
+		r.cubes = sum;
+	}));
+	results.push_back(measure("arrayNDChecked", radius, 1, [&](Result& r) {
+		int64_t sum = 0;
+		for (size_t z = 1; z < sizeZ; ++z)
+		for (size_t y = 1; y < sizeY; ++y)
+		for (size_t x = 1; x < sizeX; ++x) {
+			sum += values[{x - 1, y, z}] + values[{x, y - 1, z}] + values[{x, y, z - 1}];
+		}
+		r.items = items;
+		r.cubes = sum;
+	}));
+	results.push_back(measure("arrayNDUnchecked", radius, 1, [&](Result& r) {
+		int64_t sum = 0;
+		for (size_t z = 1; z < sizeZ; ++z)
+		for (size_t y = 1; y < sizeY; ++y)
+		for (size_t x = 1; x < sizeX; ++x) {
+			sum += values(x - 1, y, z) + values(x, y - 1, z) + values(x, y, z - 1);
+		}
+		r.items = items;
+		r.cubes = sum;
+	}));
+	results.push_back(measure("arrayNDRowStencil", radius, 1, [&](Result& r) {
+		auto stencil = values.faceStencil();
+		int64_t sum = 0;
+		for (size_t z = 1; z < sizeZ; ++z)
+		for (size_t y = 1; y < sizeY; ++y) {
+			auto row = values.row(y, z);
+			for (auto it = row.begin() + 1; it != row.end(); ++it) {
+				sum += it[stencil[0]] + it[stencil[1]] + it[stencil[2]];
+			}
+		}
+		r.items = items;
+		r.cubes = sum;
+	}));
+}
+
+// Counting surface faces and corners one voxel at a time, against whole words at a time.
+// Both count the same things setCubes looks for, so the counts (in cubes) have to match.
+void benchmarkSurface(const arrayND<bool, 3>& shape, float radius, std::vector<Result>& results) {
+	const size_t sizeX = shape.sizes[0], sizeY = shape.sizes[1], sizeZ = shape.sizes[2];
+	auto filled = [&](ptrdiff_t x, ptrdiff_t y, ptrdiff_t z) {
+		return x >= 0 && y >= 0 && z >= 0 && (size_t) x < sizeX && (size_t) y < sizeY && (size_t) z < sizeZ && shape(x, y, z);
+	};
+	results.push_back(measure("surfaceBytewise", radius, 1, [&](Result& r) {
+		size_t faces = 0, corners = 0;
+		for (size_t z = 0; z < sizeZ; ++z)
+		for (size_t y = 0; y < sizeY; ++y)
+		for (size_t x = 0; x < sizeX; ++x) {
+			if (shape(x, y, z)) {
+				faces += !filled(x - 1, y, z) + !filled(x, y - 1, z) + !filled(x, y, z - 1)
+				+ !filled(x + 1, y, z) + !filled(x, y + 1, z) + !filled(x, y, z + 1);
+			}
+		}
+		for (size_t z = 0; z <= sizeZ; ++z)
+		for (size_t y = 0; y <= sizeY; ++y)
+		for (size_t x = 0; x <= sizeX; ++x) {
+			int around = 0;
+			for (int i = 0; i < 8; ++i) {
+				around += filled(x - !(i & 1), y - !(i & 2), z - !(i & 4));
+			}
+			corners += around != 0 && around != 8;
+		}
+		r.items = shape.total();
+		r.cubes = faces + corners;
+	}));
+
+	std::unique_ptr<OccupancyGrid> grid;
+	results.push_back(measure("occupancyPack", radius, 1, [&](Result& r) {
+		grid.reset(new OccupancyGrid(shape));
+		r.items = shape.total();
+		r.cubes = grid->count();
+	}));
+	results.push_back(measure("surfaceBitPacked", radius, 1, [&](Result& r) {
+		r.items = shape.total();
+		r.cubes = grid->countFaces() + grid->countSurfaceCorners();
+	}));
+}
+
+// Compile-time extents, so only one size. Compared against the same loop over a runtime sized arrayND.
+void benchmarkFixedIndexing(std::vector<Result>& results) {
+	constexpr size_t SIZE = 64;
+	std::unique_ptr<fixedArrayND<int32_t, SIZE, SIZE, SIZE>> fixed(new fixedArrayND<int32_t, SIZE, SIZE, SIZE>());
+	arrayND<int32_t, 3> dynamic({SIZE, SIZE, SIZE});
+	for (size_t i = 0; i < fixed->total(); ++i) {
+		(*fixed)[i] = dynamic.linear()[i] = i % 7;
+	}
+
+	auto sumNeighbors = [](auto& arr, Result& r) {
+		int64_t sum = 0;
+		for (int repeat = 0; repeat < 16; ++repeat)
+		for (size_t z = 1; z < SIZE; ++z)
+		for (size_t y = 1; y < SIZE; ++y)
+		for (size_t x = 1; x < SIZE; ++x) {
+			sum += arr(x - 1, y, z) + arr(x, y - 1, z) + arr(x, y, z - 1);
+		}
+		r.items = 16 * (SIZE - 1) * (SIZE - 1) * (SIZE - 1);
+		r.cubes = sum;
+	};
+	results.push_back(measure("fixedArrayNDUnchecked", SIZE / 2, 1, [&](Result& r) { sumNeighbors(*fixed, r); }));
+	results.push_back(measure("arrayNDUncheckedSameSize", SIZE / 2, 1, [&](Result& r) { sumNeighbors(dynamic, r); }));
+}
+
+// A mix of every primitive and CSG operation, filling a size^3 grid
+void benchmarkScene(size_t size, std::vector<Result>& results) {
+	float c = size / 2.0f;
+	ShapePtr scene = shapeSubtract(
+		shapeUnion(shapeUnion(
+			sphere(glm::vec3(c), size * 0.3f),
+			box(glm::vec3(c, c * 0.4f, c), glm::vec3(size * 0.45f, size * 0.05f, size * 0.45f))),
+			torus(glm::vec3(c, c * 1.5f, c), size * 0.3f, size * 0.08f)),
+		capsule(glm::vec3(c * 0.3f, c, c), glm::vec3(c * 1.7f, c, c), size * 0.1f));
+
+	OccupancyGrid grid({size, size, size});
+	// Started outside the timing, the way the app keeps it around
+	WorkerPool& workers = rasterWorkers();
+	results.push_back(measure("shapeScene", c, workers.size(), [&](Result& r) {
+		rasterize(*scene, grid, workers);
+		r.items = (double) size * size * size;
+		r.cubes = grid.count();
+	}));
+}
+
+void benchmarkRadius(float radius, const std::vector<unsigned>& threadCounts, int steps, std::vector<Result>& results) {
+	std::unique_ptr<OccupancyGrid> grid;
+	results.push_back(measure("genSphere", radius, std::thread::hardware_concurrency(), [&](Result& r) {
+		grid.reset(new OccupancyGrid(genSphere(radius)));
+		// Grid cells, filled or not
+		r.items = r.cubes = grid->words.size() / grid->wordsPerRow * grid->sizes[0];
+	}));
+	arrayND<bool, 3> shape = grid->toArray();
+
+	benchmarkIndexing(shape, radius, results);
+	benchmarkSurface(shape, radius, results);
+
+	std::unique_ptr<VoxelStorage> voxels;
+	results.push_back(measure("setCubes", radius, 1, [&](Result& r) {
+		voxels.reset(new VoxelStorage(*grid));
+		r.items = r.cubes = voxels->cubesData.size();
+	}));
+
+	// What a launch with a warm topology cache costs instead of setCubes
+	uint64_t hash = 0;
+	results.push_back(measure("occupancyHash", radius, 1, [&](Result& r) {
+		hash = hashOccupancy(*grid);
+		r.cubes = voxels->cubesData.size();
+		r.items = grid->words.size();
+	}));
+	std::string topologyPath = "/tmp/benchmark-" + std::to_string(getpid()) + ".topology";
+	results.push_back(measure("topologyWrite", radius, 1, [&](Result& r) {
+		writeTopology(*voxels, topologyPath, hash);
+		r.items = r.cubes = voxels->cubesData.size();
+	}));
+	results.push_back(measure("topologyMap", radius, 1, [&](Result& r) {
+		MappedTopology mapped;
+		mapped.open(topologyPath);
+		r.items = r.cubes = mapped.numCubes();
+	}));
+	unlink(topologyPath.c_str());
+	// Both coarser surfaces the renderer builds at load; items is their faces, and cubes the full surface's
+	BrickLayout bricks(voxels->cubesPos.size());
+	results.push_back(measure("surfaceLod", radius, 1, [&](Result& r) {
+		r.items = buildSurfaceLod(*voxels, 2, bricks).numFaces() + buildSurfaceLod(*voxels, 4, bricks).numFaces();
+		r.cubes = voxels->faceCubes.size();
+	}));
+
+	for (unsigned threads : threadCounts) {
+		CpuSim sim(*voxels, threads);
+		std::vector<PhysData3D> data3D[2];
+		std::vector<PhysData4D> data4D[2];
+		initPhysState(*voxels, data3D[0], data4D[0]);
+		data3D[1].resize(sim.numCubes());
+		data4D[1].resize(sim.numCubes());
+
+		// The first step pulls everything into cache; the multi-step run then measures the steady state
+		results.push_back(measure("singleStep", radius, sim.numThreads(), [&](Result& r) {
+			runSteps(sim, data3D, data4D, 1);
+			r.cubes = sim.numCubes();
+			r.items = sim.numCubes();
+		}));
+		results.push_back(measure("multiStep", radius, sim.numThreads(), [&](Result& r) {
+			runSteps(sim, data3D, data4D, steps);
+			r.cubes = sim.numCubes();
+			r.items = (double) sim.numCubes() * steps;
+		}));
+		// Same, with every 100th cube pulled somewhere else. Constraints are looked up as each cube is stepped, so this should cost next to nothing over multiStep.
+		ConstraintSet constraints(sim.numCubes());
+		for (size_t i = 0; i < sim.numCubes(); i += 100) constraints.grab(i, data3D[0][i].pos + glm::vec3(1, 0, 0));
+		sim.constraints = &constraints;
+		results.push_back(measure("multiStepConstrained", radius, sim.numThreads(), [&](Result& r) {
+			runSteps(sim, data3D, data4D, steps);
+			r.cubes = sim.numCubes();
+			r.items = (double) sim.numCubes() * steps;
+		}));
+		sim.constraints = nullptr;
+		// Same, with the boxes culling works from filled in as the cubes are written
+		BodyBounds bounds;
+		sim.bounds = &bounds;
+		results.push_back(measure("multiStepBounds", radius, sim.numThreads(), [&](Result& r) {
+			runSteps(sim, data3D, data4D, steps);
+			r.cubes = sim.numCubes();
+			r.items = (double) sim.numCubes() * steps;
+		}));
+		sim.bounds = nullptr;
+		// Same, keeping a state to rewind to as often as the renderer does by default. The difference from multiStep is what recording costs.
+		RewindBuffer rewind(sim.numCubes(), DEFAULT_REWIND_BYTES);
+		results.push_back(measure("multiStepRewind", radius, sim.numThreads(), [&](Result& r) {
+			for (int i = 0; i < steps; ++i) {
+				runSteps(sim, data3D, data4D, 1);
+				std::swap(data3D[0], data3D[1]);
+				std::swap(data4D[0], data4D[1]);
+				if ((i + 1) % (DEFAULT_REWIND_INTERVAL * PHYS_STEPS_PER_FRAME) == 0) rewind.record(i, data3D[0].data(), data4D[0].data());
+			}
+			rewind.clear();
+			r.cubes = sim.numCubes();
+			r.items = (double) sim.numCubes() * steps;
+		}));
+		// The same steps in float and in double, with the energy drift of each
+		results.push_back(measureEnergyDrift<float>("multiStepEnergyFloat", *voxels, radius, threads, steps));
+		results.push_back(measureEnergyDrift<double>("multiStepEnergyDouble", *voxels, radius, threads, steps));
+		// Every vertex, as after a step where everything moved
+		SurfaceSkin skin(*voxels, sim.numThreads());
+		results.push_back(measure("surfaceSkin", radius, sim.numThreads(), [&](Result& r) {
+			for (int i = 0; i < steps; ++i) {
+				skin.invalidate();
+				skin.update(data3D[0].data(), data4D[0].data());
+			}
+			r.cubes = sim.numCubes();
+			r.items = (double) skin.numVerts() * steps;
+		}));
+		// Rays from a ring around the body to its middle, after refitting to where the last step left it
+		SurfacePicker picker(*voxels);
+		picker.refit(skin.vertPositions());
+		results.push_back(measure("surfaceRefit", radius, 1, [&](Result& r) {
+			for (int i = 0; i < steps; ++i) picker.refit(skin.vertPositions());
+			r.cubes = sim.numCubes();
+			r.items = steps;
+		}));
+		results.push_back(measure("surfaceRaycast", radius, 1, [&](Result& r) {
+			const int rays = 1000;
+			size_t hits = 0;
+			glm::vec3 center(radius);
+			for (int i = 0; i < rays; ++i) {
+				float angle = i * 2 * glm::pi<float>() / rays;
+				glm::vec3 origin = center + glm::vec3(std::cos(angle), 0.3f, std::sin(angle)) * radius * 3.0f;
+				SurfacePicker::Hit hit;
+				hits += picker.raycast(origin, center - origin, hit);
+			}
+			if (hits == 0) std::cerr << "No rays hit" << std::endl;
+			r.cubes = sim.numCubes();
+			r.items = rays;
+		}));
+	}
+}
+
+std::vector<float> parseList(const char* arg) {
+	std::vector<float> list;
+	std::string s(arg);
+	size_t start = 0;
+	while (start <= s.size()) {
+		size_t comma = s.find(',', start);
+		if (comma == std::string::npos) comma = s.size();
+		if (comma > start) list.push_back(atof(s.substr(start, comma - start).c_str()));
+		start = comma + 1;
+	}
+	return list;
+}
+
+void writeJson(FILE* out, const std::vector<Result>& results, int steps) {
+	fprintf(out, "{\n\t\"stepsPerMultiStep\": %d,\n\t\"hardwareThreads\": %u,\n\t\"results\": [\n", steps, std::thread::hardware_concurrency());
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result& r = results[i];
+		char energyDrift[32] = "null";
+		if (!std::isnan(r.energyDrift)) snprintf(energyDrift, sizeof(energyDrift), "%.6g", r.energyDrift);
+		fprintf(out, "\t\t{\"name\": \"%s\", \"radius\": %g, \"threads\": %u, \"cubes\": %zu, \"seconds\": %.6g, "
+				"\"cubesPerSecond\": %.6g, \"nsPerItem\": %.6g, \"peakRssBytes\": %llu, \"allocations\": %llu, \"allocatedBytes\": %llu, \"energyDrift\": %s}%s\n",
+				r.name.c_str(), r.radius, r.threads, r.cubes, r.seconds,
+				r.items / r.seconds, r.seconds * 1e9 / r.items, (unsigned long long) r.peakRss,
+				(unsigned long long) r.allocations, (unsigned long long) r.allocatedBytes, energyDrift,
+				i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "\t]\n}\n");
+}
+
+}
+
+
+int main(int argc, char** argv) {
+	std::vector<float> radii = { 5, 10, 25, 50, 100, 200 };
+	std::vector<unsigned> threadCounts = { 1 };
+	for (unsigned i = 2; i <= std::thread::hardware_concurrency(); i *= 2) threadCounts.push_back(i);
+	int steps = 20;
+	size_t sceneSize = 1024;
+	std::string outPath;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--radii") radii = parseList(argv[i + 1]);
+		else if (arg == "--threads") {
+			threadCounts.clear();
+			for (float t : parseList(argv[i + 1])) threadCounts.push_back((unsigned) t);
+		}
+		else if (arg == "--steps") steps = atoi(argv[i + 1]);
+		else if (arg == "--scene") sceneSize = atol(argv[i + 1]);
+		else if (arg == "--out") outPath = argv[i + 1];
+		else {
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	benchmarkFixedIndexing(results);
+	if (sceneSize > 0) benchmarkScene(sceneSize, results);
+	for (float radius : radii) {
+		std::cerr << "radius " << radius << std::endl;
+		benchmarkRadius(radius, threadCounts, steps, results);
+	}
+
+	FILE* out = stdout;
+	if (!outPath.empty()) {
+		out = fopen(outPath.c_str(), "w");
+		if (out == nullptr) {
+			perror((std::string("Error opening ") + outPath).c_str());
+			return 1;
+		}
+	}
+	writeJson(out, results, steps);
+	if (out != stdout) fclose(out);
+	return 0;
+}
@@ -0,0 +1,53 @@
+#include "bodyBatch.hpp"
+#include <cmath>
+
+
+void BodyBatch::add(const TopologyView& body, glm::vec3 offset) {
+	Range range{cubesPos.size(), body.numCubes, vertsNeighbors.size(), body.numVerts, faceCubes.size(), body.numFaces};
+	ranges.push_back(range);
+	
+	for (size_t i = 0; i < body.numCubes; ++i) {
+		cubesPos.push_back(body.cubesPos[i] + offset);
+		VoxelStorage::CubeData cube = body.cubesData[i];
+		for (int32_t& neighbor : cube.neighbors) {
+			if (neighbor != -1) neighbor += range.cubeStart;
+		}
+		cubesData.push_back(cube);
+	}
+	for (size_t i = 0; i < body.numVerts; ++i) {
+		VoxelStorage::VertNeighbors vert = body.vertsNeighbors[i];
+		for (int32_t& neighbor : vert.neighbors) {
+			if (neighbor != -1) neighbor += range.cubeStart;
+		}
+		vertsNeighbors.push_back(vert);
+	}
+	for (size_t i = 0; i < body.numFaces * 4; ++i) faceIndices.push_back(body.faceIndices[i] + range.vertStart);
+	for (size_t i = 0; i < body.numFaces; ++i) faceCubes.push_back(body.faceCubes[i] + range.cubeStart);
+	
+	extent = glm::max(extent, offset + glm::vec3(body.sizes[0], body.sizes[1], body.sizes[2]));
+}
+
+TopologyView BodyBatch::view() const {
+	TopologyView view;
+	for (int i = 0; i < 3; ++i) view.sizes[i] = std::ceil(extent[i]);
+	view.numCubes = cubesPos.size();
+	view.numVerts = vertsNeighbors.size();
+	view.numFaces = faceCubes.size();
+	view.cubesPos = cubesPos.data();
+	view.cubesData = cubesData.data();
+	view.vertsNeighbors = vertsNeighbors.data();
+	view.faceIndices = faceIndices.data();
+	view.faceCubes = faceCubes.data();
+	return view;
+}
+
+BodyBatch repeatBody(const TopologyView& body, unsigned count, float gap) {
+	BodyBatch batch;
+	// As close to square as it goes
+	unsigned perRow = std::ceil(std::sqrt(float(count)));
+	glm::vec3 spacing = glm::vec3(body.sizes[0], 0, body.sizes[2]) + glm::vec3(gap, 0, gap);
+	for (unsigned i = 0; i < count; ++i) {
+		batch.add(body, glm::vec3(i % perRow, 0, i / perRow) * spacing);
+	}
+	return batch;
+}
@@ -0,0 +1,45 @@
+#ifndef bodyBatch_hpp
+#define bodyBatch_hpp
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "voxelStorage.hpp"
+
+
+// Several bodies' topologies packed one after another into shared tables, so they're simulated and drawn as one body in pieces: one physics pass and
+// one draw covers all of them, however many there are. Each body's cube, vertex and face indices are moved up by where its own start, so nothing
+// points across bodies, and they never pull on each other.
+class BodyBatch {
+public:
+	// Where one body's entries are in the shared tables
+	struct Range {
+		size_t cubeStart, numCubes;
+		size_t vertStart, numVerts;
+		size_t faceStart, numFaces;
+	};
+
+	// Copies the body's tables in, with its starting positions moved by offset
+	void add(const TopologyView& body, glm::vec3 offset);
+
+	size_t numBodies() const { return ranges.size(); }
+	const Range& range(size_t body) const { return ranges[body]; }
+	// Only good until the next add
+	TopologyView view() const;
+
+private:
+	std::vector<Range> ranges;
+	std::vector<glm::vec3> cubesPos;
+	std::vector<VoxelStorage::CubeData> cubesData;
+	std::vector<VoxelStorage::VertNeighbors> vertsNeighbors;
+	std::vector<uint32_t> faceIndices, faceCubes;
+	// Far corner of everything added, for TopologyView::sizes
+	glm::vec3 extent = glm::vec3(0);
+};
+
+// count copies of body in rows on the floor, gap cubes apart
+BodyBatch repeatBody(const TopologyView& body, unsigned count, float gap);
+
+
+#endif /* bodyBatch_hpp */
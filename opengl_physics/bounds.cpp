@@ -0,0 +1,85 @@
+#include "bounds.hpp"
+#include <algorithm>
+
+
+BrickLayout::BrickLayout(size_t numCubes, const std::vector<size_t>& bodyStarts) {
+	std::vector<size_t> starts = bodyStarts;
+	if (starts.empty() || starts[0] != 0) starts.insert(starts.begin(), 0);
+	for (size_t body = 0; body < starts.size(); ++body) {
+		bodyBrickStarts.push_back(brickStarts.size());
+		size_t end = body + 1 < starts.size() ? starts[body + 1] : numCubes;
+		for (size_t cube = starts[body]; cube < end; cube = std::min((cube / COMPACT_BRICK_SIZE + 1) * COMPACT_BRICK_SIZE, end)) brickStarts.push_back(cube);
+	}
+	bodyBrickStarts.push_back(brickStarts.size());
+	brickStarts.push_back(numCubes);
+	// Every run starts a brick, since bricks are cut at every run boundary
+	size_t brick = 0;
+	for (size_t run = 0; run * COMPACT_BRICK_SIZE < numCubes; ++run) {
+		while (brickStarts[brick] < run * COMPACT_BRICK_SIZE) ++brick;
+		runFirstBricks.push_back(brick);
+	}
+}
+
+void BodyBounds::reset(size_t numCubes) {
+	if (layout.numCubes() != numCubes || layout.brickStarts.empty()) layout = BrickLayout(numCubes);
+	bricks.assign(layout.numBricks(), Aabb());
+	bodies.assign(layout.numBodies(), Aabb());
+	all = Aabb();
+	maxSpeed = 0;
+}
+
+void BodyBounds::finish() {
+	for (Aabb& brick : bricks) brick.pad(CUBE_HALF_DIAGONAL);
+	mergeBricks();
+}
+
+void BodyBounds::addSurface(const glm::vec3* vertPositions, const uint32_t* faceIndices, const uint32_t* brickFaceStarts) {
+	for (size_t b = 0; b < bricks.size(); ++b) {
+		for (size_t i = brickFaceStarts[b] * 4; i < brickFaceStarts[b + 1] * 4; ++i) bricks[b].add(vertPositions[faceIndices[i]]);
+	}
+	mergeBricks();
+}
+
+void BodyBounds::mergeBricks() {
+	all = Aabb();
+	for (size_t body = 0; body < bodies.size(); ++body) {
+		bodies[body] = Aabb();
+		for (size_t b = layout.bodyBrickStarts[body]; b < layout.bodyBrickStarts[body + 1]; ++b) bodies[body].merge(bricks[b]);
+		all.merge(bodies[body]);
+	}
+}
+
+void computeBounds(const PhysData3D* data3D, size_t numCubes, BodyBounds& bounds) {
+	bounds.reset(numCubes);
+	float maxSpeed2 = 0;
+	for (size_t b = 0; b < bounds.numBricks(); ++b) {
+		Aabb& brick = bounds.bricks[b];
+		for (size_t i = bounds.layout.brickStarts[b]; i < bounds.layout.brickStarts[b + 1]; ++i) {
+			brick.add(data3D[i].pos);
+			maxSpeed2 = std::max(maxSpeed2, glm::dot(data3D[i].vel, data3D[i].vel));
+		}
+	}
+	bounds.maxSpeed = std::sqrt(maxSpeed2);
+	bounds.finish();
+}
+
+
+Frustum::Frustum(const glm::mat4& transform) {
+	// Gribb and Hartmann: each plane is the last row of the matrix plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i) rows[i] = glm::vec4(transform[0][i], transform[1][i], transform[2][i], transform[3][i]);
+	for (int i = 0; i < 3; ++i) {
+		planes[i * 2] = rows[3] + rows[i];
+		planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+}
+
+bool Frustum::intersects(const Aabb& box) const {
+	if (box.empty()) return false;
+	for (const glm::vec4& plane : planes) {
+		// The corner furthest along the plane's normal
+		glm::vec3 corner(plane.x > 0 ? box.max.x : box.min.x, plane.y > 0 ? box.max.y : box.min.y, plane.z > 0 ? box.max.z : box.min.z);
+		if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0) return false;
+	}
+	return true;
+}
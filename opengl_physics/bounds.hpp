@@ -0,0 +1,98 @@
+#ifndef bounds_hpp
+#define bounds_hpp
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "physState.hpp"
+
+
+// Axis-aligned box. Starts out empty, inside out, so adding the first point makes it just that point.
+struct Aabb {
+	glm::vec3 min = glm::vec3(INFINITY), max = glm::vec3(-INFINITY);
+
+	bool empty() const { return min.x > max.x; }
+	void add(glm::vec3 p) {
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+	void merge(const Aabb& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+	void pad(float amount) {
+		if (empty()) return;
+		min -= glm::vec3(amount);
+		max += glm::vec3(amount);
+	}
+};
+
+// Cubes' corners are at most this far from their centers, unless they're being stretched apart
+constexpr float CUBE_HALF_DIAGONAL = 0.8660254f;
+
+// Which brick each cube is in: runs of COMPACT_BRICK_SIZE consecutive cubes, cut again wherever a body of a batch starts, so no brick has
+// cubes of two bodies in it. Each brick is inside one run, so anything that never splits a run between threads never splits a brick either.
+struct BrickLayout {
+	// First cube of each brick, then the number of cubes
+	std::vector<size_t> brickStarts;
+	// First brick of each body, then the number of bricks
+	std::vector<size_t> bodyBrickStarts;
+	// First brick in each run
+	std::vector<size_t> runFirstBricks;
+
+	BrickLayout() = default;
+	// bodyStarts is each body's first cube, in order. Empty is all one body.
+	explicit BrickLayout(size_t numCubes, const std::vector<size_t>& bodyStarts = std::vector<size_t>());
+
+	size_t numCubes() const { return brickStarts.empty() ? 0 : brickStarts.back(); }
+	size_t numBricks() const { return brickStarts.empty() ? 0 : brickStarts.size() - 1; }
+	size_t numBodies() const { return bodyBrickStarts.empty() ? 0 : bodyBrickStarts.size() - 1; }
+	size_t brickOf(size_t cube) const {
+		// At most a few bodies start in any one run
+		size_t brick = runFirstBricks[cube / COMPACT_BRICK_SIZE];
+		while (brickStarts[brick + 1] <= cube) ++brick;
+		return brick;
+	}
+};
+
+// A box around each brick, each body, and all of them. Each takes in every corner of its cubes, and after addSurface, every vertex of its faces.
+struct BodyBounds {
+	// Set once for the bodies being simulated; reset makes one body of numCubes if it doesn't match
+	BrickLayout layout;
+	Aabb all;
+	std::vector<Aabb> bodies;
+	std::vector<Aabb> bricks;
+	// Fastest any cube is going, for telling how far out of its box it could be by some time later
+	float maxSpeed = 0;
+
+	size_t numBricks() const { return bricks.size(); }
+	// Empties every box, ready for the cubes to be added again
+	void reset(size_t numCubes);
+	// Pads the bricks out to their cubes' corners and works out the bodies' boxes from them
+	void finish();
+	// Grows each brick to take in its faces' skinned vertices, which average the corners of up to 8 cubes that can be in other bricks,
+	// so under stretch they reach past its own cubes' corners. Faces are in runs by the layout's bricks, from brickFaceStarts.
+	void addSurface(const glm::vec3* vertPositions, const uint32_t* faceIndices, const uint32_t* brickFaceStarts);
+
+private:
+	// Works out the bodies' boxes and all from the bricks
+	void mergeBricks();
+};
+
+// Bounds of the whole state at once, for when it didn't come from CpuSim, which works them out as it goes
+void computeBounds(const PhysData3D* data3D, size_t numCubes, BodyBounds& bounds);
+
+
+// The six planes of a view volume, pointing in
+struct Frustum {
+	glm::vec4 planes[6];
+
+	// From a projection * view * model matrix, into the model's space
+	explicit Frustum(const glm::mat4& transform);
+	// False only if box is entirely outside. Boxes near a corner can come out true without being in.
+	bool intersects(const Aabb& box) const;
+};
+
+
+#endif /* bounds_hpp */
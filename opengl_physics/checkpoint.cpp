@@ -0,0 +1,160 @@
+#include "checkpoint.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include "topologyFile.hpp"
+
+
+namespace {
+
+const uint64_t PAGE_SIZE = 4096;
+
+uint64_t pageAlign(uint64_t offset) {
+	return (offset + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+bool writeAt(FILE* file, uint64_t offset, const void* data, size_t bytes) {
+	return bytes == 0 || (fseek(file, offset, SEEK_SET) == 0 && fwrite(data, 1, bytes, file) == bytes);
+}
+
+// Whether count items of itemSize starting at offset are all inside the file, and start aligned for them
+bool arrayFits(uint64_t offset, uint64_t count, size_t itemSize, size_t alignment, uint64_t fileSize) {
+	return offset % alignment == 0 && offset <= fileSize && count <= (fileSize - offset) / itemSize;
+}
+
+}
+
+
+bool writeCheckpoint(const std::string& path, const CheckpointState& state) {
+	// Reading it back takes a material for every cube
+	if (!state.cubesMaterial.empty() && state.cubesMaterial.size() != state.data3D.size()) {
+		std::cout << "Not saving " << path << ": " << state.cubesMaterial.size() << " materials for " << state.data3D.size() << " cubes" << std::endl;
+		return false;
+	}
+	CheckpointHeader header = {};
+	memcpy(header.magic, "BCCP", 4);
+	header.version = CHECKPOINT_VERSION;
+	header.occupancyHash = state.occupancyHash;
+	header.builderVersion = TOPOLOGY_BUILDER_VERSION;
+	header.paletteSize = state.palette.size();
+	header.numCubes = state.data3D.size();
+	header.stepCount = state.stepCount;
+
+	uint64_t offset = pageAlign(sizeof(CheckpointHeader));
+	auto place = [&offset](uint64_t& arrayOffset, uint64_t bytes) {
+		arrayOffset = offset;
+		offset = pageAlign(offset + bytes);
+	};
+	place(header.data3DOffset, state.data3D.size() * sizeof(PhysData3D));
+	place(header.data4DOffset, state.data4D.size() * sizeof(PhysData4D));
+	if (!state.cubesMaterial.empty()) place(header.materialsOffset, state.cubesMaterial.size());
+	place(header.paletteOffset, state.palette.size() * sizeof(uint32_t));
+	header.fileSize = offset;
+
+	std::string partial = path + ".part";
+	FILE* file = fopen(partial.c_str(), "wb");
+	if (!file) {
+		perror((std::string("Error creating ") + partial).c_str());
+		return false;
+	}
+	const uint8_t zero = 0;
+	bool ok = writeAt(file, header.fileSize - 1, &zero, 1)
+		&& writeAt(file, 0, &header, sizeof(header))
+		&& writeAt(file, header.data3DOffset, state.data3D.data(), state.data3D.size() * sizeof(PhysData3D))
+		&& writeAt(file, header.data4DOffset, state.data4D.data(), state.data4D.size() * sizeof(PhysData4D))
+		&& writeAt(file, header.materialsOffset, state.cubesMaterial.data(), state.cubesMaterial.size())
+		&& writeAt(file, header.paletteOffset, state.palette.data(), state.palette.size() * sizeof(uint32_t))
+		// On disk before it replaces the old one, or a crash could leave neither
+		&& fflush(file) == 0 && fsync(fileno(file)) == 0;
+	if (fclose(file) != 0) ok = false;
+	if (ok && rename(partial.c_str(), path.c_str()) != 0) ok = false;
+	if (!ok) {
+		perror((std::string("Error writing ") + path).c_str());
+		unlink(partial.c_str());
+	}
+	return ok;
+}
+
+
+bool MappedCheckpoint::open(const std::string& path) {
+	if (!file.open(path)) return false;
+	if (file.size() < sizeof(CheckpointHeader) || memcmp(header().magic, "BCCP", 4) != 0) {
+		std::cout << path << " is not a checkpoint" << std::endl;
+		file.close();
+		return false;
+	}
+	if (header().version != CHECKPOINT_VERSION || header().fileSize != file.size()) {
+		std::cout << path << " is from a different version, or was cut short" << std::endl;
+		file.close();
+		return false;
+	}
+	// Cubes are numbered by the topology builder, so another builder's numbering wouldn't line up with the state
+	if (header().builderVersion != TOPOLOGY_BUILDER_VERSION) {
+		std::cout << path << " was saved with a different topology builder, and its cubes would be in the wrong places" << std::endl;
+		file.close();
+		return false;
+	}
+	const CheckpointHeader& h = header();
+	uint64_t size = file.size();
+	bool fits = arrayFits(h.data3DOffset, h.numCubes, sizeof(PhysData3D), alignof(PhysData3D), size)
+		&& arrayFits(h.data4DOffset, h.numCubes, sizeof(PhysData4D), alignof(PhysData4D), size)
+		&& (h.materialsOffset == 0 || arrayFits(h.materialsOffset, h.numCubes, 1, 1, size))
+		&& arrayFits(h.paletteOffset, h.paletteSize, sizeof(uint32_t), alignof(uint32_t), size);
+	if (!fits) {
+		std::cout << path << " has arrays that run past its end" << std::endl;
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+
+CheckpointWriter::CheckpointWriter() : thread(&CheckpointWriter::run, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	thread.join();
+}
+
+bool CheckpointWriter::save(const std::string& path, CheckpointState state) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (hasPending) return false;
+		pendingPath = path;
+		pending = std::move(state);
+		hasPending = true;
+	}
+	changed.notify_all();
+	return true;
+}
+
+bool CheckpointWriter::busy() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return hasPending;
+}
+
+void CheckpointWriter::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return !hasPending; });
+}
+
+void CheckpointWriter::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [this] { return hasPending || stopping; });
+		if (!hasPending) return;
+
+		// pending is left alone until hasPending is cleared, so it can be written without the lock
+		lock.unlock();
+		writeCheckpoint(pendingPath, pending);
+		lock.lock();
+		pending = CheckpointState();
+		hasPending = false;
+		changed.notify_all();
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef checkpoint_hpp
+#define checkpoint_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "physState.hpp"
+#include "mappedFile.hpp"
+
+
+// A saved run: the state of every cube, laid out the same as the GL buffers, plus what's needed to carry on from it.
+// The topology isn't in it, just its hash, which names it in the topology cache. Each array starts on a page boundary, so a mapped
+// checkpoint can be uploaded or stepped from as is.
+struct CheckpointHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t occupancyHash;
+	uint32_t builderVersion;
+	uint32_t paletteSize;
+	uint64_t numCubes;
+	uint64_t stepCount;
+	// Bytes from the start of the file. materialsOffset is 0 if the body has no materials.
+	uint64_t data3DOffset, data4DOffset, materialsOffset, paletteOffset;
+	uint64_t fileSize;
+};
+
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+struct CheckpointState {
+	uint64_t occupancyHash = 0;
+	uint64_t stepCount = 0;
+	std::vector<PhysData3D> data3D;
+	std::vector<PhysData4D> data4D;
+	// Per cube, or empty
+	std::vector<uint8_t> cubesMaterial;
+	std::vector<uint32_t> palette;
+};
+
+// Writes to a temporary file and renames it over path, so an interrupted save leaves the last checkpoint as it was.
+// Prints why and returns false on failure.
+bool writeCheckpoint(const std::string& path, const CheckpointState& state);
+
+
+class MappedCheckpoint {
+public:
+	// Prints why and returns false if the file can't be opened, isn't a checkpoint this version can read, or was saved from
+	// topologies built differently from how they're built now
+	bool open(const std::string& path);
+	bool isOpen() const { return file.isOpen(); }
+
+	const CheckpointHeader& header() const { return *(const CheckpointHeader*) file.data(); }
+	size_t numCubes() const { return header().numCubes; }
+	const PhysData3D* data3D() const { return (const PhysData3D*) (file.data() + header().data3DOffset); }
+	const PhysData4D* data4D() const { return (const PhysData4D*) (file.data() + header().data4DOffset); }
+	// Null if there are none
+	const uint8_t* cubesMaterial() const { return header().materialsOffset ? file.data() + header().materialsOffset : nullptr; }
+	const uint32_t* palette() const { return (const uint32_t*) (file.data() + header().paletteOffset); }
+
+private:
+	MappedFile file;
+};
+
+
+// Where the renderer saves to when K is pressed, and what it starts from
+struct CheckpointSettings {
+	std::string path = "checkpoint.bcc";
+	// Saved along with the state, since the topology doesn't have them
+	std::vector<uint8_t> cubesMaterial;
+	std::vector<uint32_t> palette;
+	// If it's open, the body starts in this state instead of at rest
+	std::shared_ptr<MappedCheckpoint> restoreFrom;
+};
+
+
+// Saves checkpoints on its own thread, so whatever is running only stops long enough to hand over a copy of its state
+class CheckpointWriter {
+public:
+	CheckpointWriter();
+	// Finishes the checkpoint being written, if there is one
+	~CheckpointWriter();
+
+	// Returns false without doing anything if the last checkpoint is still being written
+	bool save(const std::string& path, CheckpointState state);
+	bool busy() const;
+	// Until the checkpoint being written is done
+	void wait();
+
+private:
+	std::string pendingPath;
+	CheckpointState pending;
+	bool hasPending = false, stopping = false;
+	mutable std::mutex mutex;
+	std::condition_variable changed;
+	std::thread thread;
+
+	void run();
+};
+
+
+#endif /* checkpoint_hpp */
@@ -0,0 +1,108 @@
+#include "constraints.hpp"
+#include <algorithm>
+
+
+CubeConstraint& ConstraintSet::recordFor(uint32_t cube) {
+	recordsChanged = true;
+	if (cubeIndices[cube] < 0) {
+		cubeIndices[cube] = records.size();
+		records.push_back(CubeConstraint());
+		recordCubes.push_back(cube);
+		changedCubes.push_back(cube);
+	}
+	return records[cubeIndices[cube]];
+}
+
+void ConstraintSet::grab(uint32_t cube, glm::vec3 target, float stiffness, float damping) {
+	CubeConstraint& record = recordFor(cube);
+	glm::vec3 impulse = record.impulse;
+	record = CubeConstraint();
+	record.target = target;
+	record.stiffness = stiffness;
+	record.damping = damping;
+	record.impulse = impulse;
+}
+
+void ConstraintSet::pin(uint32_t cube, glm::vec3 at) {
+	CubeConstraint& record = recordFor(cube);
+	glm::vec3 impulse = record.impulse;
+	record = CubeConstraint();
+	record.target = at;
+	record.pinned = 1;
+	record.impulse = impulse;
+}
+
+void ConstraintSet::push(uint32_t cube, glm::vec3 force) {
+	CubeConstraint& record = recordFor(cube);
+	glm::vec3 impulse = record.impulse;
+	record = CubeConstraint();
+	record.force = force;
+	record.impulse = impulse;
+}
+
+void ConstraintSet::impulse(uint32_t cube, glm::vec3 impulse) {
+	CubeConstraint& record = recordFor(cube);
+	if (record.impulse == glm::vec3(0)) ++pendingImpulses;
+	record.impulse += impulse;
+}
+
+void ConstraintSet::moveTarget(uint32_t cube, glm::vec3 target) {
+	if (cubeIndices[cube] < 0) return;
+	records[cubeIndices[cube]].target = target;
+	recordsChanged = true;
+}
+
+void ConstraintSet::release(uint32_t cube) {
+	int32_t index = cubeIndices[cube];
+	if (index < 0) return;
+	if (records[index].impulse != glm::vec3(0)) --pendingImpulses;
+	// The last record fills the gap
+	uint32_t moved = recordCubes.back();
+	records[index] = records.back();
+	recordCubes[index] = moved;
+	cubeIndices[moved] = index;
+	records.pop_back();
+	recordCubes.pop_back();
+	cubeIndices[cube] = -1;
+	changedCubes.push_back(cube);
+	if (moved != cube) changedCubes.push_back(moved);
+	recordsChanged = true;
+}
+
+void ConstraintSet::clear() {
+	for (uint32_t cube : recordCubes) {
+		cubeIndices[cube] = -1;
+		changedCubes.push_back(cube);
+	}
+	records.clear();
+	recordCubes.clear();
+	pendingImpulses = 0;
+	recordsChanged = true;
+}
+
+void ConstraintSet::impulsesApplied() {
+	if (pendingImpulses == 0) return;
+	// A record that was only there for an impulse has nothing left to do
+	for (size_t i = records.size(); i-- > 0;) {
+		CubeConstraint& record = records[i];
+		if (record.impulse == glm::vec3(0)) continue;
+		record.impulse = glm::vec3(0);
+		if (record.stiffness == 0 && record.pinned == 0 && record.force == glm::vec3(0)) release(recordCubes[i]);
+	}
+	pendingImpulses = 0;
+	recordsChanged = true;
+}
+
+std::vector<uint32_t> ConstraintSet::takeChangedCubes() {
+	std::vector<uint32_t> changed;
+	changed.swap(changedCubes);
+	std::sort(changed.begin(), changed.end());
+	changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+	return changed;
+}
+
+bool ConstraintSet::takeRecordsChanged() {
+	bool changed = recordsChanged;
+	recordsChanged = false;
+	return changed;
+}
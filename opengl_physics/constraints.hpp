@@ -0,0 +1,76 @@
+#ifndef constraints_hpp
+#define constraints_hpp
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+
+// What's done to one cube from outside the body, applied by the solver as part of the cube's own step. Laid out as the three RGBA32F texels
+// sim.vert reads per constraint.
+struct CubeConstraint {
+	// Pulled toward target with stiffness in force per distance. 0 for no pull.
+	glm::vec3 target = glm::vec3(0);
+	float stiffness = 0;
+	// Added every step, along with damping times the cube's velocity taken away
+	glm::vec3 force = glm::vec3(0);
+	float damping = 0;
+	// Added to the momentum once, on the next step
+	glm::vec3 impulse = glm::vec3(0);
+	// Non-zero to hold the cube at target, still
+	float pinned = 0;
+};
+static_assert(sizeof(CubeConstraint) == 12 * sizeof(float), "Has to match the texels sim.vert reads");
+
+// Stiff enough to follow the mouse closely, and damped just short of bouncing back
+constexpr float GRAB_STIFFNESS = 2000;
+constexpr float GRAB_DAMPING = 80;
+
+// Every cube that has something done to it, at most one constraint each. Constraints are packed together; each cube has the index of
+// its constraint, or -1, so the solver finds it without searching and without a pass of its own.
+class ConstraintSet {
+public:
+	explicit ConstraintSet(size_t numCubes) : cubeIndices(numCubes, -1) {}
+
+	// Each of these replaces whatever the cube had before
+	void grab(uint32_t cube, glm::vec3 target, float stiffness = GRAB_STIFFNESS, float damping = GRAB_DAMPING);
+	void pin(uint32_t cube, glm::vec3 at);
+	// Steady, until released
+	void push(uint32_t cube, glm::vec3 force);
+	// Added on top of whatever else the cube has, and only applied once
+	void impulse(uint32_t cube, glm::vec3 impulse);
+	// Grabs and pins only
+	void moveTarget(uint32_t cube, glm::vec3 target);
+	void release(uint32_t cube);
+	void clear();
+
+	// Solvers call this after each step, so impulses only happen once
+	void impulsesApplied();
+	bool hasImpulses() const { return pendingImpulses > 0; }
+
+	size_t size() const { return records.size(); }
+	bool empty() const { return records.empty(); }
+	const CubeConstraint* data() const { return records.data(); }
+	// One per cube
+	const int32_t* indices() const { return cubeIndices.data(); }
+	const CubeConstraint* find(uint32_t cube) const { return cubeIndices[cube] >= 0 ? &records[cubeIndices[cube]] : nullptr; }
+
+	// Cubes whose index changed since the last call, so only those need uploading. Whether any record changed is separate, since they're small enough to upload whole.
+	std::vector<uint32_t> takeChangedCubes();
+	bool takeRecordsChanged();
+
+private:
+	std::vector<CubeConstraint> records;
+	// Which cube each record is for
+	std::vector<uint32_t> recordCubes;
+	std::vector<int32_t> cubeIndices;
+	std::vector<uint32_t> changedCubes;
+	size_t pendingImpulses = 0;
+	bool recordsChanged = false;
+
+	CubeConstraint& recordFor(uint32_t cube);
+};
+
+
+#endif /* constraints_hpp */
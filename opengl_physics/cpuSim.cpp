@@ -0,0 +1,405 @@
+#include "cpuSim.hpp"
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include "quaternion.hpp"
+
+
+namespace {
+
+// Must match the constants in sim.vert
+constexpr double materialSpringiness = 3000;
+constexpr double materialTwistiness = 1000;
+constexpr double cubeMass = 1;
+constexpr double dampingFactor = 0.05;
+constexpr double angDampingFactor = 0.05;
+constexpr double gravity = 32;
+constexpr double floorY = -50;
+
+template<typename T>
+glm::vec<3, T> spring(glm::vec<3, T> offsets) {
+	return offsets * T(materialSpringiness);
+}
+
+template<typename T>
+T normAngle(T inAngle) {
+	const T pi = T(M_PI);
+	// GLSL mod
+	T divisor = pi * 2;
+	inAngle = (inAngle + pi) - divisor * std::floor((inAngle + pi) / divisor);
+	if (inAngle < 0) inAngle += pi * 2;
+	return inAngle - pi;
+}
+template<typename T>
+glm::vec<3, T> normAxisAngle(glm::vec<3, T> inAxisAngle) {
+	T inAngle = glm::length(inAxisAngle);
+	if (inAngle < T(M_PI)) return inAxisAngle;
+	return inAxisAngle / inAngle * normAngle(inAngle);
+}
+
+template<typename T>
+struct FullSource {
+	const PhysData3DT<T>* data3D;
+	const PhysData4DT<T>* data4D;
+	CubeStateT<T> load(size_t i) const {
+		return { data3D[i].pos, data3D[i].vel, data3D[i].angVel, data4D[i].turn };
+	}
+};
+template<typename T>
+struct CompactSource {
+	const CompactPhysState& state;
+	CubeStateT<T> load(size_t i) const {
+		return convertState<T>(decodeCube(state.cubes[i], state.bricks[i / COMPACT_BRICK_SIZE]));
+	}
+};
+
+// Stands in for DiagnosticsAccumulator when diagnostics are off, so they cost nothing
+struct NoDiagnostics {
+	void addBondEnergy(double) {}
+	void addFloorEnergy(double) {}
+	template<typename T>
+	void addCube(const CubeStateT<T>&, float) {}
+};
+
+struct Diagnostics {
+	DiagnosticsAccumulator& accumulator;
+
+	// Each connection is seen from both of its cubes, so each side counts half of its energy, which is half of twiceEnergy
+	void addBondEnergy(double twiceEnergy) {
+		accumulator.springEnergy += 0.25 * twiceEnergy;
+	}
+	void addFloorEnergy(double energy) {
+		accumulator.springEnergy += energy;
+	}
+	template<typename T>
+	void addCube(const CubeStateT<T>& cube, float strain) {
+		glm::dvec3 pos(cube.pos), vel(cube.vel), angVel(cube.angVel);
+		accumulator.kineticEnergy += 0.5 * cubeMass * glm::dot(vel, vel);
+		// The step divides torque by cubeMass, so that's the moment of inertia the energy has to use to be conserved
+		accumulator.rotationalEnergy += 0.5 * cubeMass * glm::dot(angVel, angVel);
+		accumulator.gravityEnergy += cubeMass * gravity * (pos.y - floorY);
+		accumulator.linearMomentum += cubeMass * vel;
+		accumulator.angularMomentum += glm::cross(pos, cubeMass * vel) + cubeMass * angVel;
+		if (!std::isfinite(pos.x + pos.y + pos.z + vel.x + vel.y + vel.z)) ++accumulator.nonFiniteCubes;
+		accumulator.addStrain(strain);
+	}
+};
+
+// Null for cubes without a constraint, and for every cube when there are none
+struct ConstraintLookup {
+	const CubeConstraint* records = nullptr;
+	const int32_t* indices = nullptr;
+	explicit ConstraintLookup(const ConstraintSet* constraints) {
+		if (constraints && !constraints->empty()) {
+			records = constraints->data();
+			indices = constraints->indices();
+		}
+	}
+	const CubeConstraint* find(size_t i) const {
+		return records && indices[i] >= 0 ? records + indices[i] : nullptr;
+	}
+};
+
+// The body of sim.vert
+template<typename T, typename Source, typename Diag>
+CubeStateT<T> stepCube(const Source& in, const VoxelStorage::CubeData& data, size_t i, const CubeConstraint* constraint, T timeDelta, float& debugFeedback, Diag& diag) {
+	typedef glm::vec<3, T> vec3T;
+	CubeStateT<T> self = in.load(i);
+
+	vec3T offsets(0), angOffsets(0), twists(0), neighVels(0), neighAngVels(0);
+	T neighborAmount = 0;
+	T feedback = 0;
+
+	for (int j = 0; j < 6; ++j) {
+		int32_t neighborIdx = data.neighbors[j];
+		if (neighborIdx == -1) continue;
+		vec3T baseNormal(0);
+		baseNormal[j % 3] = j < 3 ? -1 : 1;
+
+		vec3T normal = quat_rotate_vector(baseNormal / T(2), self.turn);
+		CubeStateT<T> neigh = in.load(neighborIdx);
+		vec3T neighborNormal = quat_rotate_vector(-baseNormal / T(2), neigh.turn);
+
+		vec3T offset = (neigh.pos + neighborNormal) - (self.pos + normal);
+		offsets += offset;
+		vec3T angOffset = glm::cross(normal, offset);
+		angOffsets += angOffset;
+		vec3T twistOffset = normAxisAngle(quat_to_axisAngle(quat_mul(neigh.turn, quat_conj(self.turn))));
+		twists += twistOffset;
+		feedback += glm::length(offset) + glm::length(angOffset) + glm::length(twistOffset);
+		diag.addBondEnergy(materialSpringiness * glm::dot(offset, offset) + materialTwistiness * glm::dot(twistOffset, twistOffset));
+
+		++neighborAmount;
+
+		neighVels += neigh.vel + glm::cross(neigh.angVel, neighborNormal) - glm::cross(self.angVel, normal);
+		neighAngVels += neigh.angVel;
+	}
+	debugFeedback = (float) feedback;
+	diag.addCube(self, debugFeedback);
+
+	if (neighborAmount > 0) {
+		neighVels /= neighborAmount;
+		neighAngVels /= neighborAmount;
+	}
+
+	if (self.pos.y < T(floorY)) {
+		offsets.y += (T(floorY) - self.pos.y);
+		diag.addFloorEnergy(0.5 * materialSpringiness * (floorY - self.pos.y) * (floorY - self.pos.y));
+	}
+
+	CubeStateT<T> out;
+	out.vel = glm::mix(self.vel, neighVels, T(dampingFactor) * neighborAmount);
+	out.vel = out.vel + (spring(offsets) / T(cubeMass) + vec3T(0, -gravity, 0)) * timeDelta;
+
+	vec3T dampedInAngVel = glm::mix(self.angVel, neighAngVels, T(angDampingFactor) * neighborAmount);
+	out.angVel = dampedInAngVel + (spring(angOffsets) + T(materialTwistiness) * twists) / T(cubeMass) * timeDelta;
+
+	if (constraint) {
+		out.vel += ((vec3T(constraint->target) - self.pos) * T(constraint->stiffness) - self.vel * T(constraint->damping) + vec3T(constraint->force)) / T(cubeMass) * timeDelta
+			+ vec3T(constraint->impulse) / T(cubeMass);
+		if (constraint->pinned != 0) out.vel = vec3T(0);
+	}
+
+	out.pos = self.pos + out.vel * timeDelta;
+	if (constraint && constraint->pinned != 0) out.pos = vec3T(constraint->target);
+	out.turn = quat_mul(quat_from_axisAngle(out.angVel * timeDelta), self.turn);
+	return out;
+}
+
+}
+
+
+// Cubes each worker does at once. A multiple of the compact brick size, so bricks are never split between workers.
+constexpr size_t STEP_GRAIN = COMPACT_BRICK_SIZE;
+
+template<typename T>
+void CpuSimT<T>::step(const PhysData3DT<T>* in3D, const PhysData4DT<T>* in4D, PhysData3DT<T>* out3D, PhysData4DT<T>* out4D, float* debugFeedback, T timeDelta, StepDiagnostics* diagnostics) {
+	FullSource<T> in{in3D, in4D};
+	ConstraintLookup lookup(constraints);
+
+	auto stepRange = [&](size_t begin, size_t end, unsigned worker, auto& diag) {
+		float feedback;
+		for (size_t i = begin; i < end; ++i) {
+			CubeStateT<T> out = stepCube(in, cubesData[i], i, lookup.find(i), timeDelta, feedback, diag);
+			out3D[i].pos = out.pos;
+			out3D[i].vel = out.vel;
+			out3D[i].angVel = out.angVel;
+			out4D[i].turn = out.turn;
+			if (debugFeedback) debugFeedback[i] = feedback;
+			if (bounds) addToBounds(i, glm::vec3(out.pos), glm::vec3(out.vel), worker);
+		}
+	};
+
+	resetDiagnostics(diagnostics);
+	resetBounds();
+	workers.parallelFor(cubes, STEP_GRAIN, [&](size_t begin, size_t end, unsigned worker) {
+		if (diagnostics) {
+			for (size_t chunk = begin; chunk < end; chunk += STEP_GRAIN) {
+				Diagnostics diag{chunkDiagnostics[chunk / STEP_GRAIN]};
+				stepRange(chunk, std::min(chunk + STEP_GRAIN, end), worker, diag);
+			}
+		}
+		else {
+			NoDiagnostics diag;
+			stepRange(begin, end, worker, diag);
+		}
+	});
+	finishBounds();
+	finishDiagnostics(diagnostics);
+}
+
+template<typename T>
+void CpuSimT<T>::step(const CompactPhysState& in, CompactPhysState& out, float* debugFeedback, T timeDelta, StepDiagnostics* diagnostics) {
+	out.resize(cubes);
+	CompactSource<T> source{in};
+	ConstraintLookup lookup(constraints);
+
+	auto stepBricks = [&](size_t begin, size_t end, unsigned worker, auto& diag) {
+		CubeState brickCubes[COMPACT_BRICK_SIZE];
+		float feedback;
+		for (size_t start = begin; start < end; start += COMPACT_BRICK_SIZE) {
+			size_t count = std::min(COMPACT_BRICK_SIZE, end - start);
+			for (size_t i = 0; i < count; ++i) {
+				brickCubes[i] = convertState<float>(stepCube(source, cubesData[start + i], start + i, lookup.find(start + i), timeDelta, feedback, diag));
+				if (debugFeedback) debugFeedback[start + i] = feedback;
+				if (bounds) addToBounds(start + i, brickCubes[i].pos, brickCubes[i].vel, worker);
+			}
+			encodeBrick(brickCubes, count, out.bricks[start / COMPACT_BRICK_SIZE], &out.cubes[start]);
+		}
+	};
+
+	resetDiagnostics(diagnostics);
+	resetBounds();
+	workers.parallelFor(cubes, STEP_GRAIN, [&](size_t begin, size_t end, unsigned worker) {
+		if (diagnostics) {
+			for (size_t chunk = begin; chunk < end; chunk += STEP_GRAIN) {
+				Diagnostics diag{chunkDiagnostics[chunk / STEP_GRAIN]};
+				stepBricks(chunk, std::min(chunk + STEP_GRAIN, end), worker, diag);
+			}
+		}
+		else {
+			NoDiagnostics diag;
+			stepBricks(begin, end, worker, diag);
+		}
+	});
+	finishBounds();
+	finishDiagnostics(diagnostics);
+}
+
+template<typename T>
+void CpuSimT<T>::resetDiagnostics(StepDiagnostics* diagnostics) {
+	if (diagnostics) chunkDiagnostics.assign((cubes + STEP_GRAIN - 1) / STEP_GRAIN, DiagnosticsAccumulator());
+}
+
+template<typename T>
+void CpuSimT<T>::resetBounds() {
+	if (bounds) {
+		bounds->reset(cubes);
+		for (auto& i : partials) i.maxSpeed2 = 0;
+	}
+}
+
+template<typename T>
+void CpuSimT<T>::finishBounds() {
+	if (bounds) {
+		float maxSpeed2 = 0;
+		for (auto& i : partials) maxSpeed2 = std::max(maxSpeed2, i.maxSpeed2);
+		bounds->maxSpeed = std::sqrt(maxSpeed2);
+		bounds->finish();
+	}
+}
+
+template<typename T>
+void CpuSimT<T>::finishDiagnostics(StepDiagnostics* diagnostics) {
+	if (diagnostics) {
+		DiagnosticsAccumulator total;
+		for (const DiagnosticsAccumulator& chunk : chunkDiagnostics) {
+			total.merge(chunk);
+		}
+		total.finish(stepCount, *diagnostics);
+	}
+	if (constraints) constraints->impulsesApplied();
+	++stepCount;
+}
+
+template class CpuSimT<float>;
+template class CpuSimT<double>;
+
+
+template<typename T>
+void initPhysState(const TopologyView& voxels, std::vector<PhysData3DT<T>>& data3D, std::vector<PhysData4DT<T>>& data4D, glm::vec3 offset) {
+	data3D.assign(voxels.numCubes, PhysData3DT<T>());
+	data4D.assign(voxels.numCubes, PhysData4DT<T>());
+	for (size_t i = 0; i < voxels.numCubes; ++i) {
+		data3D[i].pos = glm::vec<3, T>(voxels.cubesPos[i]) + glm::vec<3, T>(offset);
+	}
+}
+template void initPhysState<float>(const TopologyView&, std::vector<PhysData3D>&, std::vector<PhysData4D>&, glm::vec3);
+template void initPhysState<double>(const TopologyView&, std::vector<PhysData3DT<double>>&, std::vector<PhysData4DT<double>>&, glm::vec3);
+
+CompactDriftReport measureCompactDrift(const VoxelStorage& voxels, int steps, float timeDelta) {
+	CpuSim sim(voxels);
+	size_t n = sim.numCubes();
+
+	std::vector<PhysData3D> full3D[2], expanded3D(n);
+	std::vector<PhysData4D> full4D[2], expanded4D(n);
+	initPhysState<float>(voxels, full3D[0], full4D[0]);
+	full3D[1].resize(n);
+	full4D[1].resize(n);
+
+	CompactPhysState compact[2];
+	compactState(full3D[0].data(), full4D[0].data(), n, compact[0]);
+
+	CompactDriftReport report;
+	report.numCubes = n;
+	report.fullBytesPerCube = sizeof(PhysData3D) + sizeof(PhysData4D);
+	report.compactBytesPerCube = (double) compact[0].bytes() / n;
+	report.maxPosError = 0;
+	report.maxTurnError = 0;
+	report.rmsPosError = 0;
+
+	std::chrono::steady_clock::duration fullTime{}, compactTime{};
+
+	for (int s = 0; s < steps; ++s) {
+		int cur = s % 2, next = 1 - cur;
+
+		auto start = std::chrono::steady_clock::now();
+		sim.step(full3D[cur].data(), full4D[cur].data(), full3D[next].data(), full4D[next].data(), nullptr, timeDelta);
+		auto mid = std::chrono::steady_clock::now();
+		sim.step(compact[cur], compact[next], nullptr, timeDelta);
+		auto end = std::chrono::steady_clock::now();
+		fullTime += mid - start;
+		compactTime += end - mid;
+
+		expandState(compact[next], expanded3D.data(), expanded4D.data());
+		double sumSquares = 0;
+		for (size_t i = 0; i < n; ++i) {
+			float posError = glm::length(expanded3D[i].pos - full3D[next][i].pos);
+			sumSquares += posError * posError;
+			report.maxPosError = std::max(report.maxPosError, posError);
+
+			float cosHalfAngle = std::abs(glm::dot(glm::normalize(expanded4D[i].turn), glm::normalize(full4D[next][i].turn)));
+			float turnError = 2 * std::acos(std::min(cosHalfAngle, 1.0f));
+			report.maxTurnError = std::max(report.maxTurnError, turnError);
+		}
+		report.rmsPosError = (float) std::sqrt(sumSquares / n);
+	}
+
+	double cubeSteps = (double) n * std::max(steps, 1);
+	report.fullNsPerCubeStep = std::chrono::duration<double, std::nano>(fullTime).count() / cubeSteps;
+	report.compactNsPerCubeStep = std::chrono::duration<double, std::nano>(compactTime).count() / cubeSteps;
+	return report;
+}
+
+
+PrecisionReport measurePrecision(const VoxelStorage& voxels, int steps, double timeDelta, glm::vec3 offset) {
+	CpuSimT<float> floatSim(voxels);
+	CpuSimT<double> doubleSim(voxels);
+	size_t n = floatSim.numCubes();
+
+	std::vector<PhysData3DT<float>> float3D[2];
+	std::vector<PhysData4DT<float>> float4D[2];
+	std::vector<PhysData3DT<double>> double3D[2];
+	std::vector<PhysData4DT<double>> double4D[2];
+	for (int i = 0; i < 2; ++i) {
+		initPhysState<float>(voxels, float3D[i], float4D[i], offset);
+		initPhysState<double>(voxels, double3D[i], double4D[i], offset);
+	}
+
+	PrecisionReport report;
+	report.numCubes = n;
+	report.startEnergy = report.floatEnergy = report.doubleEnergy = 0;
+	report.maxEnergyDrift = 0;
+	StepDiagnostics floatDiagnostics, doubleDiagnostics;
+
+	std::chrono::steady_clock::duration floatTime{}, doubleTime{};
+
+	for (int s = 0; s < steps; ++s) {
+		int cur = s % 2, next = 1 - cur;
+
+		auto start = std::chrono::steady_clock::now();
+		floatSim.step(float3D[cur].data(), float4D[cur].data(), float3D[next].data(), float4D[next].data(), nullptr, (float) timeDelta, &floatDiagnostics);
+		auto mid = std::chrono::steady_clock::now();
+		doubleSim.step(double3D[cur].data(), double4D[cur].data(), double3D[next].data(), double4D[next].data(), nullptr, timeDelta, &doubleDiagnostics);
+		auto end = std::chrono::steady_clock::now();
+		floatTime += mid - start;
+		doubleTime += end - mid;
+
+		report.floatEnergy = floatDiagnostics.totalEnergy();
+		report.doubleEnergy = doubleDiagnostics.totalEnergy();
+		if (s == 0) report.startEnergy = report.doubleEnergy;
+		double drift = std::abs(report.floatEnergy - report.doubleEnergy) / std::max(std::abs(report.doubleEnergy), 1e-9);
+		report.maxEnergyDrift = std::max(report.maxEnergyDrift, drift);
+	}
+
+	int last = steps % 2;
+	report.maxPosError = 0;
+	for (size_t i = 0; i < n; ++i) {
+		report.maxPosError = std::max(report.maxPosError, glm::length(glm::dvec3(float3D[last][i].pos) - double3D[last][i].pos));
+	}
+
+	double cubeSteps = (double) n * std::max(steps, 1);
+	report.floatNsPerCubeStep = std::chrono::duration<double, std::nano>(floatTime).count() / cubeSteps;
+	report.doubleNsPerCubeStep = std::chrono::duration<double, std::nano>(doubleTime).count() / cubeSteps;
+	return report;
+}
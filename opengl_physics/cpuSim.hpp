@@ -0,0 +1,97 @@
+#ifndef cpuSim_hpp
+#define cpuSim_hpp
+
+#include <vector>
+#include <algorithm>
+#include "physState.hpp"
+#include "voxelStorage.hpp"
+#include "workerPool.hpp"
+#include "diagnostics.hpp"
+#include "constraints.hpp"
+#include "bounds.hpp"
+
+
+// Runs the same step as sim.vert, on the CPU. Used for headless runs and for checking the compact state layout.
+// T is the scalar everything is computed in. Only float and double are instantiated; float matches the GPU exactly.
+template<typename T>
+class CpuSimT {
+public:
+	// Reads the neighbor table in place, so whatever voxels points into has to outlive this
+	explicit CpuSimT(const TopologyView& voxels, unsigned threads = 1) : cubesData(voxels.cubesData), cubes(voxels.numCubes), workers(threads), partials(workers.size()) {}
+
+	size_t numCubes() const { return cubes; }
+	unsigned numThreads() const { return workers.size(); }
+
+	// Full precision, same layout as the GL buffers when T is float. debugFeedback may be null.
+	// If diagnostics isn't null, it's filled in with totals for the in state, summed up while the step reads it
+	void step(const PhysData3DT<T>* in3D, const PhysData4DT<T>* in4D, PhysData3DT<T>* out3D, PhysData4DT<T>* out4D, float* debugFeedback, T timeDelta, StepDiagnostics* diagnostics = nullptr);
+	// Decodes neighbors as they are read and encodes each brick as it's finished, so the full precision state never exists as a whole
+	void step(const CompactPhysState& in, CompactPhysState& out, float* debugFeedback, T timeDelta, StepDiagnostics* diagnostics = nullptr);
+
+	// Counts steps taken, for StepDiagnostics::step
+	uint64_t stepCount = 0;
+	// Applied in every step while set, and has to outlive those steps. Impulses are cleared after the step they're applied in.
+	ConstraintSet* constraints = nullptr;
+	// Filled in with the out state's boxes by every step while set, as the cubes are written, so there's no pass of its own
+	BodyBounds* bounds = nullptr;
+
+private:
+	const VoxelStorage::CubeData* cubesData;
+	size_t cubes;
+	WorkerPool workers;
+	// One per worker, padded apart so they don't share cache lines
+	struct alignas(64) PaddedPartial {
+		// For BodyBounds::maxSpeed
+		float maxSpeed2 = 0;
+	};
+	std::vector<PaddedPartial> partials;
+	// One per STEP_GRAIN cubes rather than per worker, and merged in order, so the sums come out the same whatever the thread count
+	std::vector<DiagnosticsAccumulator> chunkDiagnostics;
+
+	void resetDiagnostics(StepDiagnostics* diagnostics);
+	void finishDiagnostics(StepDiagnostics* diagnostics);
+	void resetBounds();
+	void addToBounds(size_t cube, glm::vec3 pos, glm::vec3 vel, unsigned worker) {
+		// Workers never split a brick, so each brick's box only has one writer
+		bounds->bricks[bounds->layout.brickOf(cube)].add(pos);
+		partials[worker].maxSpeed2 = std::max(partials[worker].maxSpeed2, glm::dot(vel, vel));
+	}
+	void finishBounds();
+};
+typedef CpuSimT<float> CpuSim;
+
+// Same starting state the renderer uploads: every cube at rest where it is in the voxel grid, moved by offset
+template<typename T>
+void initPhysState(const TopologyView& voxels, std::vector<PhysData3DT<T>>& data3D, std::vector<PhysData4DT<T>>& data4D, glm::vec3 offset = glm::vec3(0));
+
+
+struct CompactDriftReport {
+	size_t numCubes;
+	double fullBytesPerCube, compactBytesPerCube;
+	double fullNsPerCubeStep, compactNsPerCubeStep;
+	// Largest difference seen at any step, between running in full precision and in the compact layout
+	float maxPosError, maxTurnError;
+	// At the last step
+	float rmsPosError;
+};
+
+// Drops the body from its starting position and runs both layouts side by side
+CompactDriftReport measureCompactDrift(const VoxelStorage& voxels, int steps, float timeDelta);
+
+
+struct PrecisionReport {
+	size_t numCubes;
+	double floatNsPerCubeStep, doubleNsPerCubeStep;
+	// Energy at the start, and at the start of the last step of each run
+	double startEnergy, floatEnergy, doubleEnergy;
+	// Largest relative difference in energy between the two runs at any step
+	double maxEnergyDrift;
+	// Largest distance between the same cube in the two runs, at the last step
+	double maxPosError;
+};
+
+// Drops the body, placed at offset from where genSphere puts it, in float and in double side by side
+PrecisionReport measurePrecision(const VoxelStorage& voxels, int steps, double timeDelta, glm::vec3 offset);
+
+
+#endif /* cpuSim_hpp */
@@ -0,0 +1,101 @@
+#include "diagnostics.hpp"
+#include <cmath>
+#include <algorithm>
+
+
+void DiagnosticsAccumulator::addStrain(float strain) {
+	++numCubes;
+	maxStrain = std::max(maxStrain, strain);
+	int bin = 0;
+	if (strain > 0) {
+		float scaled = (std::log2(strain) - STRAIN_MIN_EXPONENT) * STRAIN_BINS_PER_OCTAVE;
+		bin = (int) std::min(std::max(scaled, 0.0f), (float) STRAIN_BINS - 1);
+	}
+	++strainHistogram[bin];
+}
+
+void DiagnosticsAccumulator::merge(const DiagnosticsAccumulator& other) {
+	kineticEnergy += other.kineticEnergy;
+	rotationalEnergy += other.rotationalEnergy;
+	springEnergy += other.springEnergy;
+	gravityEnergy += other.gravityEnergy;
+	linearMomentum += other.linearMomentum;
+	angularMomentum += other.angularMomentum;
+	maxStrain = std::max(maxStrain, other.maxStrain);
+	nonFiniteCubes += other.nonFiniteCubes;
+	numCubes += other.numCubes;
+	for (int i = 0; i < STRAIN_BINS; ++i) {
+		strainHistogram[i] += other.strainHistogram[i];
+	}
+}
+
+void DiagnosticsAccumulator::finish(uint64_t step, StepDiagnostics& out) const {
+	out.step = step;
+	out.kineticEnergy = kineticEnergy;
+	out.rotationalEnergy = rotationalEnergy;
+	out.springEnergy = springEnergy;
+	out.gravityEnergy = gravityEnergy;
+	out.linearMomentum = linearMomentum;
+	out.angularMomentum = angularMomentum;
+	out.maxStrain = maxStrain;
+	out.nonFiniteCubes = nonFiniteCubes;
+
+	// Upper edge of the bin the percentile falls in, but never past the actual max
+	auto percentile = [this](double fraction) {
+		uint64_t target = (uint64_t) std::ceil(fraction * numCubes);
+		uint64_t seen = 0;
+		for (int i = 0; i < STRAIN_BINS; ++i) {
+			seen += strainHistogram[i];
+			if (seen >= target && seen > 0) {
+				float edge = std::exp2((float) (i + 1) / STRAIN_BINS_PER_OCTAVE + STRAIN_MIN_EXPONENT);
+				return std::min(edge, maxStrain);
+			}
+		}
+		return maxStrain;
+	};
+	out.medianStrain = percentile(0.5);
+	out.p90Strain = percentile(0.9);
+	out.p99Strain = percentile(0.99);
+}
+
+
+DiagnosticsWriter::DiagnosticsWriter(const std::string& path) {
+	binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+	file = fopen(path.c_str(), binary ? "wb" : "w");
+	if (file == nullptr) {
+		perror((std::string("Error opening diagnostics file ") + path).c_str());
+		return;
+	}
+
+	if (binary) {
+		// Magic, version, then the size of each record so readers can check they match
+		const char magic[4] = { 'B', 'C', 'D', 'G' };
+		uint32_t version = 1, recordSize = sizeof(StepDiagnostics);
+		fwrite(magic, 1, sizeof(magic), file);
+		fwrite(&version, sizeof(version), 1, file);
+		fwrite(&recordSize, sizeof(recordSize), 1, file);
+	}
+	else {
+		fputs("step,kinetic,rotational,spring,gravity,total,"
+			  "momentumX,momentumY,momentumZ,angMomentumX,angMomentumY,angMomentumZ,"
+			  "maxStrain,medianStrain,p90Strain,p99Strain,nonFiniteCubes\n", file);
+	}
+}
+
+DiagnosticsWriter::~DiagnosticsWriter() {
+	if (file) fclose(file);
+}
+
+void DiagnosticsWriter::write(const StepDiagnostics& d) {
+	if (!file) return;
+	if (binary) {
+		fwrite(&d, sizeof(d), 1, file);
+	}
+	else {
+		fprintf(file, "%llu,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%g,%g,%g,%g,%u\n",
+				(unsigned long long) d.step, d.kineticEnergy, d.rotationalEnergy, d.springEnergy, d.gravityEnergy, d.totalEnergy(),
+				d.linearMomentum.x, d.linearMomentum.y, d.linearMomentum.z,
+				d.angularMomentum.x, d.angularMomentum.y, d.angularMomentum.z,
+				d.maxStrain, d.medianStrain, d.p90Strain, d.p99Strain, d.nonFiniteCubes);
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef diagnostics_hpp
+#define diagnostics_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <glm/glm.hpp>
+
+
+// Totals over the whole body, for the state a step started from
+struct StepDiagnostics {
+	uint64_t step = 0;
+	double kineticEnergy = 0, rotationalEnergy = 0, springEnergy = 0, gravityEnergy = 0;
+	// About the world origin
+	glm::dvec3 linearMomentum = glm::dvec3(0), angularMomentum = glm::dvec3(0);
+	// Strain is the per-cube value sim.vert writes to debugFeedback. Percentiles are within a factor of 2^(1/4).
+	float maxStrain = 0, medianStrain = 0, p90Strain = 0, p99Strain = 0;
+	// Cubes with a NaN or infinite position or velocity. Anything but 0 means the simulation has blown up.
+	uint32_t nonFiniteCubes = 0;
+
+	double totalEnergy() const {
+		return kineticEnergy + rotationalEnergy + springEnergy + gravityEnergy;
+	}
+};
+
+
+// Partial sums from one chunk of a step's cubes, merged into StepDiagnostics at the end
+struct DiagnosticsAccumulator {
+	// 4 per octave, from 2^-16 to 2^16
+	static constexpr int STRAIN_BINS = 128;
+	static constexpr int STRAIN_BINS_PER_OCTAVE = 4;
+	static constexpr int STRAIN_MIN_EXPONENT = -16;
+
+	double kineticEnergy = 0, rotationalEnergy = 0, springEnergy = 0, gravityEnergy = 0;
+	glm::dvec3 linearMomentum = glm::dvec3(0), angularMomentum = glm::dvec3(0);
+	float maxStrain = 0;
+	uint32_t nonFiniteCubes = 0, numCubes = 0;
+	uint32_t strainHistogram[STRAIN_BINS] = {};
+
+	void reset() {
+		*this = DiagnosticsAccumulator();
+	}
+	void addStrain(float strain);
+	void merge(const DiagnosticsAccumulator& other);
+	void finish(uint64_t step, StepDiagnostics& out) const;
+};
+
+
+// Streams one record per step, as CSV or as raw binary records
+class DiagnosticsWriter {
+public:
+	// Binary if the path ends in .bin, CSV otherwise
+	explicit DiagnosticsWriter(const std::string& path);
+	~DiagnosticsWriter();
+	DiagnosticsWriter(const DiagnosticsWriter&) = delete;
+	DiagnosticsWriter& operator=(const DiagnosticsWriter&) = delete;
+
+	bool isOpen() const { return file != nullptr; }
+	void write(const StepDiagnostics& diagnostics);
+
+private:
+	FILE* file;
+	bool binary;
+};
+
+
+#endif /* diagnostics_hpp */
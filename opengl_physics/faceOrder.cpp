@@ -0,0 +1,167 @@
+#include "faceOrder.hpp"
+#include <vector>
+#include <algorithm>
+#include "physState.hpp"
+
+
+namespace {
+
+// Tipsify over one brick's faces, with vertices numbered 0 to numVerts - 1, starting from first. Writes the faces in their new order to order.
+void tipsify(const uint32_t* quads, size_t numFaces, size_t numVerts, uint32_t first, unsigned cacheSize, std::vector<uint32_t>& order) {
+	// Faces of each vertex, and how many of them haven't been emitted yet
+	std::vector<uint32_t> vertFaceStarts(numVerts + 1, 0), vertFaces(numFaces * 4);
+	for (size_t i = 0; i < numFaces * 4; ++i) ++vertFaceStarts[quads[i] + 1];
+	for (size_t v = 0; v < numVerts; ++v) vertFaceStarts[v + 1] += vertFaceStarts[v];
+	std::vector<uint32_t> filled(vertFaceStarts.begin(), vertFaceStarts.end() - 1);
+	for (size_t i = 0; i < numFaces * 4; ++i) vertFaces[filled[quads[i]]++] = i / 4;
+	std::vector<uint32_t> live(numVerts);
+	for (size_t v = 0; v < numVerts; ++v) live[v] = vertFaceStarts[v + 1] - vertFaceStarts[v];
+
+	// A vertex is in the cache if it went in less than cacheSize misses ago
+	std::vector<uint64_t> cacheTime(numVerts, 0);
+	uint64_t time = cacheSize + 1;
+	std::vector<bool> emitted(numFaces, false);
+	// Vertices of emitted faces, most recent last, for when fanning runs out of places to go
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	size_t cursor = 0;
+
+	order.clear();
+	int64_t fanning = numFaces > 0 ? first : -1;
+	while (fanning >= 0) {
+		candidates.clear();
+		for (uint32_t i = vertFaceStarts[fanning]; i < vertFaceStarts[fanning + 1]; ++i) {
+			uint32_t f = vertFaces[i];
+			if (emitted[f]) continue;
+			emitted[f] = true;
+			order.push_back(f);
+			for (int c = 0; c < 4; ++c) {
+				uint32_t v = quads[f * 4 + c];
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+				if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+			}
+		}
+
+		// The vertex that's been in the cache longest and will still be in it after its faces are drawn, each of which can add 3 more
+		fanning = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) continue;
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 3 * live[v] <= cacheSize) priority = time - cacheTime[v];
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+		if (fanning >= 0) continue;
+		// Nowhere nearby left: the most recently used vertex that still has faces, or else the next one in order that does
+		while (!deadEnd.empty() && fanning < 0) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0) fanning = v;
+		}
+		while (cursor < numVerts && fanning < 0) {
+			if (live[cursor] > 0) fanning = cursor;
+			++cursor;
+		}
+	}
+}
+
+// The post-transform cache as a ring of vertex indices, for following it from one brick to the next
+class FifoCache {
+public:
+	explicit FifoCache(unsigned size) : entries(size, UINT32_MAX) {}
+
+	// True if v had to be transformed
+	bool use(uint32_t v) {
+		if (std::find(entries.begin(), entries.end(), v) != entries.end()) return false;
+		entries[next] = v;
+		next = (next + 1) % entries.size();
+		return true;
+	}
+	// What drawing faces in order would cost, without changing what's in the cache
+	size_t misses(const uint32_t* faceIndices, const std::vector<uint32_t>& order) const {
+		FifoCache copy = *this;
+		size_t total = 0;
+		for (uint32_t f : order) {
+			for (int c = 0; c < 4; ++c) total += copy.use(faceIndices[f * 4 + c]);
+		}
+		return total;
+	}
+
+private:
+	std::vector<uint32_t> entries;
+	size_t next = 0;
+};
+
+}
+
+
+void reorderFaces(uint32_t* faceIndices, uint32_t* faceCubes, size_t numFaces, unsigned cacheSize) {
+	std::vector<uint32_t> verts, quads, order, unchanged, oldIndices, oldCubes;
+	FifoCache cache(cacheSize);
+	for (size_t start = 0, end; start < numFaces; start = end) {
+		size_t brick = faceCubes[start] / COMPACT_BRICK_SIZE;
+		for (end = start + 1; end < numFaces && faceCubes[end] / COMPACT_BRICK_SIZE == brick; ++end) {}
+		size_t count = end - start;
+
+		// Numbers the run's vertices from 0, so the tables are only as big as the run
+		verts.assign(faceIndices + start * 4, faceIndices + end * 4);
+		std::sort(verts.begin(), verts.end());
+		verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+		quads.resize(count * 4);
+		for (size_t i = 0; i < count * 4; ++i) {
+			quads[i] = std::lower_bound(verts.begin(), verts.end(), faceIndices[start * 4 + i]) - verts.begin();
+		}
+		// Starting where the last brick left off, the vertices of its last faces can still be in the cache
+		uint32_t first = quads[0];
+		for (size_t i = start * 4; i-- > 0 && i + cacheSize > start * 4;) {
+			auto found = std::lower_bound(verts.begin(), verts.end(), faceIndices[i]);
+			if (found != verts.end() && *found == faceIndices[i]) {
+				first = found - verts.begin();
+				break;
+			}
+		}
+		tipsify(quads.data(), count, verts.size(), first, cacheSize, order);
+		// Cube order reuses vertices between neighboring rows, which a small brick's worth of Tipsify can lose out to with a big cache,
+		// so whichever does better after the bricks before is kept
+		const uint32_t* runIndices = faceIndices + start * 4;
+		unchanged.resize(count);
+		for (size_t i = 0; i < count; ++i) unchanged[i] = i;
+		if (cache.misses(runIndices, unchanged) <= cache.misses(runIndices, order)) order.swap(unchanged);
+		for (uint32_t f : order) {
+			for (int c = 0; c < 4; ++c) cache.use(runIndices[f * 4 + c]);
+		}
+
+		oldIndices.assign(faceIndices + start * 4, faceIndices + end * 4);
+		oldCubes.assign(faceCubes + start, faceCubes + end);
+		for (size_t i = 0; i < count; ++i) {
+			std::copy(&oldIndices[order[i] * 4], &oldIndices[order[i] * 4] + 4, faceIndices + (start + i) * 4);
+			faceCubes[start + i] = oldCubes[order[i]];
+		}
+	}
+}
+
+VertexCacheStats simulateVertexCache(const uint32_t* faceIndices, size_t numFaces, size_t numVerts, unsigned cacheSize) {
+	VertexCacheStats stats;
+	// When each vertex last went in, counted in misses. It's still in if fewer than cacheSize have gone in since.
+	std::vector<uint64_t> insertedAt(numVerts, UINT64_MAX);
+	std::vector<bool> used(numVerts, false);
+	size_t numUsed = 0;
+	for (size_t i = 0; i < numFaces * 4; ++i) {
+		uint32_t v = faceIndices[i];
+		if (insertedAt[v] == UINT64_MAX || stats.transforms - insertedAt[v] >= cacheSize) {
+			insertedAt[v] = stats.transforms++;
+		}
+		if (!used[v]) {
+			used[v] = true;
+			++numUsed;
+		}
+	}
+	if (numFaces > 0) stats.perFace = (double) stats.transforms / numFaces;
+	if (numUsed > 0) stats.perVertex = (double) stats.transforms / numUsed;
+	return stats;
+}
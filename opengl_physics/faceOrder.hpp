@@ -0,0 +1,34 @@
+#ifndef faceOrder_hpp
+#define faceOrder_hpp
+
+#include <cstdint>
+#include <cstddef>
+
+
+// Whether topologies are built with their faces reordered so neighboring faces are drawn close together, which lets the GPU reuse more of
+// stretchyVoxels.vert's results. Changing it changes TOPOLOGY_BUILDER_VERSION, so cached topologies get rebuilt.
+constexpr bool REORDER_FACES = true;
+// Entries in the post-transform cache the order is made for. Most GPUs have somewhere around this many. Made for 16, a radius 40 sphere takes
+// 1.70 transforms a face against 1.83 in cube order with a 16-entry cache, and 2.19 against 2.32 with 8, but 1.69 against 1.69 with 32:
+// a bigger cache already does well on cube order and gets nothing from this one. Made for the cache's own size it's 1.95 and 1.68.
+// --vertex-cache prints these for any radius.
+constexpr unsigned VERTEX_CACHE_SIZE = 16;
+
+// Reorders faces with Tipsify (Sander, Nehab and Barczak, 2007): fans around a vertex that's still in the cache, then jumps to whichever vertex
+// left the cache least long ago. Faces only move within a run of faces of the same brick, so bricks' faces stay together in the same order.
+// faceCubes moves along with faceIndices; nothing else refers to faces by index until after the topology is built.
+void reorderFaces(uint32_t* faceIndices, uint32_t* faceCubes, size_t numFaces, unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+
+// What drawing faces in order would cost a FIFO post-transform cache
+struct VertexCacheStats {
+	// Vertex shader runs
+	size_t transforms = 0;
+	// Per face and per distinct vertex. 1 is as good as a vertex can do; a face of a big flat grid can get down to about 1 too.
+	double perFace = 0, perVertex = 0;
+};
+
+VertexCacheStats simulateVertexCache(const uint32_t* faceIndices, size_t numFaces, size_t numVerts, unsigned cacheSize);
+
+
+#endif /* faceOrder_hpp */
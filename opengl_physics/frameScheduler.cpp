@@ -0,0 +1,75 @@
+#include "frameScheduler.hpp"
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include "input.hpp"
+
+
+// Waits for events are cut off this often, so nothing can keep the loop asleep for long if it's missed
+constexpr double IDLE_WAIT_SECONDS = 0.5;
+
+
+void FrameTimeHistogram::add(double seconds) {
+	size_t bucket = std::min((size_t) (seconds * 1000), (size_t) NUM_BUCKETS - 1);
+	++buckets[bucket];
+	++total;
+	sum += seconds;
+	longest = std::max(longest, seconds);
+}
+
+double FrameTimeHistogram::percentile(double fraction) const {
+	size_t wanted = (size_t) std::ceil(total * fraction), seen = 0;
+	for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+		seen += buckets[i];
+		if (seen >= wanted && seen > 0) return i + 1 < NUM_BUCKETS ? (i + 1) / 1000.0 : longest;
+	}
+	return 0;
+}
+
+void FrameTimeHistogram::print(std::ostream& out) const {
+	if (total == 0) {
+		out << "No frames drawn" << std::endl;
+		return;
+	}
+	out << total << " frames, mean " << sum / total * 1000 << "ms, 50% under " << percentile(0.5) * 1000 << "ms, 90% under "
+	<< percentile(0.9) * 1000 << "ms, 99% under " << percentile(0.99) * 1000 << "ms, longest " << longest * 1000 << "ms" << std::endl;
+	for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+		if (buckets[i] == 0) continue;
+		if (i + 1 < NUM_BUCKETS) out << "  " << i << "-" << i + 1 << "ms: " << buckets[i] << std::endl;
+		else out << "  " << i << "ms+: " << buckets[i] << std::endl;
+	}
+}
+
+
+FrameScheduler::FrameScheduler(const FramePolicy& policy) : policy(policy), frameStart(std::chrono::steady_clock::now()), lastFrameStart(frameStart) {
+	glfwSwapInterval(policy.swapInterval);
+}
+
+void FrameScheduler::waitForFrame(bool animating) {
+	if (animating) {
+		glfwPollEvents();
+	}
+	else {
+		auto idleStart = std::chrono::steady_clock::now();
+		while (!windowData.dirty && !glfwWindowShouldClose(windowData.window)) {
+			glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+		}
+		idleTime += std::chrono::steady_clock::now() - idleStart;
+	}
+	windowData.dirty = false;
+
+	auto now = std::chrono::steady_clock::now();
+	if (policy.maxFps > 0) {
+		auto earliest = lastFrameStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / policy.maxFps));
+		if (now < earliest) {
+			std::this_thread::sleep_until(earliest);
+			now = std::chrono::steady_clock::now();
+		}
+	}
+	frameStart = now;
+}
+
+void FrameScheduler::frameDrawn() {
+	frameTimes.add(std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count());
+	lastFrameStart = frameStart;
+}
@@ -0,0 +1,60 @@
+#ifndef frameScheduler_hpp
+#define frameScheduler_hpp
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+
+
+// How often frames can be drawn. They're only drawn at all when something's moving or input came in.
+struct FramePolicy {
+	// Frames a second at most, on top of whatever vsync allows. 0 for no cap.
+	double maxFps = 0;
+	// glfwSwapInterval: 1 waits for vsync, 0 doesn't, and -1 waits unless the frame's already late, where the driver supports it
+	int swapInterval = 1;
+};
+
+// Frame times in 1 ms buckets up to 100 ms, and one more for anything longer
+class FrameTimeHistogram {
+public:
+	static constexpr unsigned NUM_BUCKETS = 101;
+
+	void add(double seconds);
+	size_t count() const { return total; }
+	// The time that fraction of frames took at most, to the bucket
+	double percentile(double fraction) const;
+	// Count, mean, percentiles and the buckets that have any frames in them
+	void print(std::ostream& out) const;
+
+private:
+	size_t buckets[NUM_BUCKETS] = {};
+	size_t total = 0;
+	double sum = 0, longest = 0;
+};
+
+// Decides when the main loop draws. While nothing's changing it sleeps in glfwWaitEventsTimeout, so an idle window costs next to nothing.
+// Input and window events set windowData.dirty, which wakes it for one frame.
+class FrameScheduler {
+public:
+	// Sets the swap interval, so the window's context has to be current
+	explicit FrameScheduler(const FramePolicy& policy);
+
+	// Handles events, and returns once the next frame should be drawn: straight away if animating or something's dirty,
+	// otherwise after waiting for input. Then holds off until the frame cap allows another frame.
+	void waitForFrame(bool animating);
+	// After the frame's swapped
+	void frameDrawn();
+
+	const FrameTimeHistogram& histogram() const { return frameTimes; }
+	// Spent in waitForFrame with nothing to do, as opposed to being held back by the cap
+	double idleSeconds() const { return std::chrono::duration<double>(idleTime).count(); }
+
+private:
+	FramePolicy policy;
+	std::chrono::steady_clock::time_point frameStart, lastFrameStart;
+	std::chrono::steady_clock::duration idleTime{};
+	FrameTimeHistogram frameTimes;
+};
+
+
+#endif /* frameScheduler_hpp */
@@ -8,6 +8,7 @@ WindowData windowData;
 std::map<int, std::function<void(int, int, int)>> keyListeners;
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	windowData.dirty = true;
 
 	if (keyListeners.count(key) != 0) keyListeners[key](scancode, action, mods);
 }
@@ -23,6 +24,7 @@ void addClickListener(std::function<void(int, int, int)> callback) {
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+	windowData.dirty = true;
 	for (auto i : clickListeners) {
 		i(button, action, mods);
 	}
@@ -31,4 +33,6 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 void setupInput(GLFWwindow* window) {
 	glfwSetKeyCallback(window, key_callback);
 	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	// Uncovered or otherwise needing to be drawn again
+	glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { windowData.dirty = true; });
 }
@@ -8,6 +8,8 @@ struct WindowData {
 	GLFWwindow* window;
 	int width = 800;
 	int height = 600;
+	// Set by input and window events, so a window that's been idle draws again. The frame scheduler clears it.
+	bool dirty = true;
 };
 extern WindowData windowData;
 
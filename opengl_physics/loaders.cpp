@@ -77,7 +77,7 @@ std::string loadShaderFile(const char* name) {
 }
 
 // Processes includes. Must be of the form @include "file" as the first thing on a line
-GLuint loadShader(const char* name, GLenum type) {
+ShaderSource loadShader(const char* name, GLenum type) {
 	
 	std::string shaderString = loadShaderFile(name);
 	
@@ -103,56 +103,14 @@ GLuint loadShader(const char* name, GLenum type) {
 		stringPtrs.push_back(&shaderString[lineEnd]);
 	}
 	
-	GLuint shader = glCreateShader(type);
-	glShaderSource(shader, stringPtrs.size(), stringPtrs.data(), NULL);
-	glCompileShader(shader);
-	
-	int  success;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-	
-	if(!success) {
-		char infoLog[512];
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		std::cout << "ERROR: SHADER " << name << " COMPILATION FAILED\n" << infoLog << std::endl;
-		glfwTerminate();
-		exit(1);
-	}
-	return shader;
+	// All of it as one string, since that's what the binary cache is keyed by
+	ShaderSource source{type, name, ""};
+	for (const char* part : stringPtrs) source.text += part;
+	return source;
 }
 
-GLuint linkShaders(std::vector<GLuint> shaders,  bool deleteShaders, std::function<void(GLuint)> preLinkOptions) {
-	
-	GLuint shaderProgram = glCreateProgram();
-	for (GLuint i : shaders) {
-		glAttachShader(shaderProgram, i);
-	}
-	if (preLinkOptions != nullptr) preLinkOptions(shaderProgram);
-	
-	glLinkProgram(shaderProgram);
-	
-	int success;
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if(!success) {
-		char infoLog[512];
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR: SHADER LINKING FAILED\n" << infoLog << std::endl;
-		glfwTerminate();
-		exit(1);
-	}
-	
-	if (deleteShaders) for (GLuint i : shaders) {
-		glDeleteShader(i);
-	}
-	
-	return shaderProgram;
-}
-
-GLuint loadShaders(const char* vert, const char* frag) {
-	
-	GLuint vertexShader = loadShader(vert, GL_VERTEX_SHADER);
-	GLuint fragmentShader = loadShader(frag, GL_FRAGMENT_SHADER);
-	
-	return linkShaders({vertexShader, fragmentShader});
+std::vector<ShaderSource> loadShaders(const char* vert, const char* frag) {
+	return { loadShader(vert, GL_VERTEX_SHADER), loadShader(frag, GL_FRAGMENT_SHADER) };
 }
 
 GLenum glCheckError_(const char *file, int line) {
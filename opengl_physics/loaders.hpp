@@ -4,15 +4,16 @@
 #include <vector>
 #include <functional>
 #include <glad/glad.h>
+#include "programCache.hpp"
 
 
 GLuint loadTexture(const char* name);
 GLuint loadCubemap(const std::vector<std::string>& faces);
 
-GLuint loadShader(const char* name, GLenum type);
-GLuint linkShaders(std::vector<GLuint> shaders, bool deleteShaders = true, std::function<void(GLuint)> preLinkOptions = nullptr);
+// Reads a shader and splices in its includes, ready for a Program
+ShaderSource loadShader(const char* name, GLenum type);
 
-GLuint loadShaders(const char* vert, const char* frag);
+std::vector<ShaderSource> loadShaders(const char* vert, const char* frag);
 
 void dumpImage(uint8_t* data, int width, int height);
 
@@ -11,11 +11,27 @@
 #include <unistd.h>
 #include <chrono>
 #include <execinfo.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
 
 #include "bridge.hpp"
 #include "loaders.hpp"
 #include "input.hpp"
 #include "voxels.hpp"
+#include "voxelStorage.hpp"
+#include "shapes.hpp"
+#include "voxelImport.hpp"
+#include "slabTopology.hpp"
+#include "topologyFile.hpp"
+#include "topologyCache.hpp"
+#include "checkpoint.hpp"
+#include "replay.hpp"
+#include "meshExport.hpp"
+#include "cpuSim.hpp"
+#include "quaternionBatch.hpp"
+#include "faceOrder.hpp"
+#include "frameScheduler.hpp"
 
 
 #ifndef __APPLE__
@@ -33,7 +49,7 @@ class Skybox {
 		"skybox/front.jpg",
 		"skybox/back.jpg"
 	});
-	GLuint shaderProgram = loadShaders("skybox.vert", "skybox.frag");
+	Program shaderProgram{loadShaders("skybox.vert", "skybox.frag")};
 	
 	GLuint VBO;
 	GLuint VAO;
@@ -119,7 +135,7 @@ public:
 class HelloTriangle {
 	
 	Skybox skybox;
-	GLuint shaderProgram = loadShaders("intro.vert", "intro.frag");
+	Program shaderProgram{loadShaders("intro.vert", "intro.frag")};
 	GLuint VBO;
 	GLuint VAO;
 	GLuint floorTexture;
@@ -128,10 +144,10 @@ class HelloTriangle {
 	glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 5.0f);
 	glm::vec3 cameraDirection = glm::normalize(-cameraPos);
 	
-	std::unique_ptr<VoxelRenderer> voxelRenderer = getVoxelRenderer();
+	std::unique_ptr<VoxelRenderer> voxelRenderer;
 	
 public:
-	HelloTriangle() {
+	HelloTriangle(std::unique_ptr<CachedTopology> body, const CheckpointSettings& checkpoints, const RendererSettings& settings) : voxelRenderer(getVoxelRenderer(std::move(body), checkpoints, settings)) {
 		
 		/*float vertices[] = {
 			// positions         // colors
@@ -157,11 +173,18 @@ public:
 		floorTexture = loadTexture("wall.jpg");*/
 	}
 	
+	VoxelRenderer& voxels() { return *voxelRenderer; }
+	// Moves the camera back along where it's looking
+	void backAway(float distance) { cameraPos -= cameraDirection * distance; }
+	
 	std::chrono::steady_clock::time_point lastFrameTime = std::chrono::steady_clock::now();
 	
-	void processInput(GLFWwindow* window) {
+	// True if the camera moved
+	bool processInput(GLFWwindow* window) {
 		auto currentFrameTime = std::chrono::steady_clock::now();
-		float deltaTime = std::chrono::duration<float>(currentFrameTime - lastFrameTime).count();
+		// Time spent waiting for input while idle isn't time a key was held
+		float deltaTime = std::min(std::chrono::duration<float>(currentFrameTime - lastFrameTime).count(), 0.1f);
+		glm::vec3 oldPos = cameraPos, oldDirection = cameraDirection;
 		
 		float moveAmount = deltaTime*5;
 		
@@ -206,6 +229,7 @@ public:
 		
 		
 		lastFrameTime = currentFrameTime;
+		return cameraPos != oldPos || cameraDirection != oldDirection;
 	}
 	
 	void render() {
@@ -305,9 +329,465 @@ void APIENTRY myDebugOutput(GLenum source,
 }
 #endif
 
+// Runs the standard drop on the CPU in both the full and compact state layouts, and prints how far apart they end up
+int runCompactDrift(int steps) {
+	VoxelStorage voxels(genSphere(RADIUS));
+	CompactDriftReport report = measureCompactDrift(voxels, steps, PHYS_TIME_DELTA);
+	
+	std::cout << report.numCubes << " cubes, " << steps << " steps" << std::endl;
+	std::cout << "bytes/cube: full " << report.fullBytesPerCube << ", compact " << report.compactBytesPerCube << std::endl;
+	std::cout << "ns/cube-step: full " << report.fullNsPerCubeStep << ", compact " << report.compactNsPerCubeStep << std::endl;
+	std::cout << "position error: max " << report.maxPosError << ", final rms " << report.rmsPosError << std::endl;
+	std::cout << "turn error (radians): max " << report.maxTurnError << std::endl;
+	return 0;
+}
+
+// Runs the standard drop on the CPU in float and in double, optionally far from the origin, and prints how far apart they end up
+int runPrecisionCompare(int steps, float offset) {
+	VoxelStorage voxels(genSphere(RADIUS));
+	PrecisionReport report = measurePrecision(voxels, steps, PHYS_TIME_DELTA, glm::vec3(offset, 0, offset));
+	
+	std::cout << report.numCubes << " cubes, " << steps << " steps, offset " << offset << std::endl;
+	std::cout << "ns/cube-step: float " << report.floatNsPerCubeStep << ", double " << report.doubleNsPerCubeStep << std::endl;
+	std::cout << "energy: start " << report.startEnergy << ", float " << report.floatEnergy << ", double " << report.doubleEnergy << std::endl;
+	std::cout << "max relative energy difference " << report.maxEnergyDrift << ", final max position difference " << report.maxPosError << std::endl;
+	return 0;
+}
+
+// How many times a sphere's vertices would go through stretchyVoxels.vert, with faces in cube order, reordered as topologies are built,
+// and reordered for each cache size, for a few cache sizes
+int runVertexCacheCheck(float radius) {
+	OccupancyGrid grid = genSphere(radius);
+	auto start = std::chrono::steady_clock::now();
+	VoxelStorage cubeOrder(grid, {}, false);
+	auto built = std::chrono::steady_clock::now();
+	VoxelStorage reordered(grid, {}, true);
+	auto reorderedBuilt = std::chrono::steady_clock::now();
+	
+	size_t numFaces = cubeOrder.faceCubes.size(), numVerts = cubeOrder.vertsNeighbors.size();
+	std::cout << numFaces << " faces, " << numVerts << " vertices; built in " << std::chrono::duration<double>(built - start).count() * 1000
+	<< "ms in cube order, " << std::chrono::duration<double>(reorderedBuilt - built).count() * 1000 << "ms reordered" << std::endl;
+	std::cout << "transforms per face (per vertex), FIFO cache" << std::endl;
+	for (unsigned cacheSize : { 8u, 16u, 32u }) {
+		std::vector<uint32_t> faceIndices = cubeOrder.faceIndices, faceCubes = cubeOrder.faceCubes;
+		reorderFaces(faceIndices.data(), faceCubes.data(), numFaces, cacheSize);
+		VertexCacheStats before = simulateVertexCache(cubeOrder.faceIndices.data(), numFaces, numVerts, cacheSize);
+		VertexCacheStats after = simulateVertexCache(reordered.faceIndices.data(), numFaces, numVerts, cacheSize);
+		VertexCacheStats matched = simulateVertexCache(faceIndices.data(), numFaces, numVerts, cacheSize);
+		std::cout << cacheSize << " entries: cube order " << before.perFace << " (" << before.perVertex << "), reordered for "
+		<< VERTEX_CACHE_SIZE << " " << after.perFace << " (" << after.perVertex << "), reordered for " << cacheSize << " "
+		<< matched.perFace << " (" << matched.perVertex << ")" << std::endl;
+	}
+	return 0;
+}
+
+// Times the batch quaternion functions against the scalar ones and prints how far apart their results are
+int runQuatBatchCheck(size_t count) {
+	QuatBatchReport report = checkQuatBatch(count);
+	
+	std::cout << report.count << " quaternions, ns each for mul + to/from axisAngle + rotate" << std::endl;
+	std::cout << "scalar " << report.scalarNs << std::endl;
+	const int widths[3] = { 4, 8, 16 };
+	for (int i = 0; i < 3; ++i) {
+		std::cout << "width " << widths[i] << ": exact " << report.exactNs[i] << ", fast " << report.fastNs[i] << std::endl;
+	}
+	std::cout << "max error: exact " << report.exactMaxError << ", fast quat_to_axisAngle " << report.fastToAxisAngleError
+	<< ", fast quat_from_axisAngle " << report.fastFromAxisAngleError << ", fast quat_rotate_vector " << report.fastRotateError << std::endl;
+	if (!report.withinBounds) {
+		std::cout << "Error over the bounds in quaternionBatch.hpp: exact " << EXACT_BATCH_MAX_ERROR << ", fast quat_to_axisAngle "
+		<< FAST_TO_AXIS_ANGLE_MAX_ERROR << ", fast quat_from_axisAngle " << FAST_FROM_AXIS_ANGLE_MAX_ERROR << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Runs the standard drop on the CPU, writing energy, momentum and strain for every step to diagnosticsPath (if it isn't empty)
+int runSimulate(int steps, const std::string& diagnosticsPath, unsigned threads) {
+	VoxelStorage voxels(genSphere(RADIUS));
+	CpuSim sim(voxels, threads);
+	std::vector<PhysData3D> data3D[2];
+	std::vector<PhysData4D> data4D[2];
+	initPhysState(voxels, data3D[0], data4D[0]);
+	data3D[1].resize(sim.numCubes());
+	data4D[1].resize(sim.numCubes());
+	
+	std::unique_ptr<DiagnosticsWriter> writer;
+	if (!diagnosticsPath.empty()) {
+		writer.reset(new DiagnosticsWriter(diagnosticsPath));
+		if (!writer->isOpen()) return 1;
+	}
+	
+	StepDiagnostics diagnostics;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; ++i) {
+		int cur = i % 2, next = 1 - cur;
+		sim.step(data3D[cur].data(), data4D[cur].data(), data3D[next].data(), data4D[next].data(), nullptr, PHYS_TIME_DELTA, &diagnostics);
+		if (writer) writer->write(diagnostics);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	std::cout << sim.numCubes() << " cubes, " << steps << " steps, " << sim.numThreads() << " threads" << std::endl;
+	std::cout << "ns/cube-step: " << seconds * 1e9 / ((double) steps * sim.numCubes()) << std::endl;
+	std::cout << "last step: energy " << diagnostics.totalEnergy() << ", max strain " << diagnostics.maxStrain
+	<< ", p99 strain " << diagnostics.p99Strain << ", non-finite cubes " << diagnostics.nonFiniteCubes << std::endl;
+	return 0;
+}
+
+// Runs the standard drop on the CPU up to step steps, saving a checkpoint every interval steps as it goes.
+// Carries on from the checkpoint if there already is one, so a run that was killed can be started again the same way.
+int runCheckpointed(uint64_t steps, const std::string& path, uint64_t interval, unsigned threads) {
+	CachedTopology body(genSphere(RADIUS));
+	CpuSim sim(body.view(), threads);
+	const size_t n = sim.numCubes();
+	std::vector<PhysData3D> data3D[2];
+	std::vector<PhysData4D> data4D[2];
+	
+	// A restored state is stepped from straight out of the mapping, without being copied first
+	MappedCheckpoint restored;
+	const PhysData3D* in3D;
+	const PhysData4D* in4D;
+	if (access(path.c_str(), F_OK) == 0) {
+		// A checkpoint that can't be carried on from is left alone rather than started over and saved on top of
+		if (!restored.open(path)) {
+			std::cout << "Not overwriting " << path << "; move it out of the way to start over" << std::endl;
+			return 1;
+		}
+		if (restored.header().occupancyHash != body.occupancyHash() || restored.numCubes() != n) {
+			std::cout << path << " is a checkpoint of a different body" << std::endl;
+			return 1;
+		}
+		sim.stepCount = restored.header().stepCount;
+		in3D = restored.data3D();
+		in4D = restored.data4D();
+		std::cout << "Carrying on from step " << sim.stepCount << std::endl;
+	}
+	else {
+		initPhysState(body.view(), data3D[1], data4D[1]);
+		in3D = data3D[1].data();
+		in4D = data4D[1].data();
+	}
+	for (int i = 0; i < 2; ++i) {
+		data3D[i].resize(n);
+		data4D[i].resize(n);
+	}
+	
+	auto snapshot = [&](int latest) {
+		CheckpointState state;
+		state.occupancyHash = body.occupancyHash();
+		state.stepCount = sim.stepCount;
+		state.data3D = data3D[latest];
+		state.data4D = data4D[latest];
+		return state;
+	};
+	CheckpointWriter writer;
+	size_t skipped = 0;
+	auto start = std::chrono::steady_clock::now();
+	uint64_t firstStep = sim.stepCount;
+	for (int next = 0; sim.stepCount < steps; next = 1 - next) {
+		sim.step(in3D, in4D, data3D[next].data(), data4D[next].data(), nullptr, PHYS_TIME_DELTA);
+		in3D = data3D[next].data();
+		in4D = data4D[next].data();
+		if (interval > 0 && sim.stepCount % interval == 0 && sim.stepCount < steps) {
+			// Skipped rather than waited for, if the last one is still being written
+			if (!writer.save(path, snapshot(next))) ++skipped;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	writer.wait();
+	int latest = in3D == data3D[0].data() ? 0 : 1;
+	if (sim.stepCount > firstStep && !writeCheckpoint(path, snapshot(latest))) return 1;
+	std::cout << n << " cubes, steps " << firstStep << " to " << sim.stepCount << " in " << seconds << "s, "
+	<< skipped << " checkpoints skipped while the last was still being written" << std::endl;
+	return 0;
+}
+
+// Runs the standard drop on the CPU, recording every step to path, and prints how big the recording came out
+int runRecord(int steps, const std::string& path, unsigned threads) {
+	CachedTopology body(genSphere(RADIUS));
+	CpuSim sim(body.view(), threads);
+	std::vector<PhysData3D> data3D[2];
+	std::vector<PhysData4D> data4D[2];
+	initPhysState(body.view(), data3D[0], data4D[0]);
+	data3D[1].resize(sim.numCubes());
+	data4D[1].resize(sim.numCubes());
+	
+	ReplayRecorder recorder(path, sim.numCubes(), body.occupancyHash());
+	if (!recorder.isOpen()) return 1;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; ++i) {
+		int cur = i % 2, next = 1 - cur;
+		recorder.record(sim.stepCount, data3D[cur].data(), data4D[cur].data());
+		sim.step(data3D[cur].data(), data4D[cur].data(), data3D[next].data(), data4D[next].data(), nullptr, PHYS_TIME_DELTA);
+	}
+	if (!recorder.finish()) return 1;
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	double rawBytes = (double) steps * sim.numCubes() * (sizeof(PhysData3D) + sizeof(PhysData4D));
+	std::cout << sim.numCubes() << " cubes, " << steps << " steps in " << seconds << "s" << std::endl;
+	std::cout << recorder.bytesWritten() << " bytes, " << rawBytes / recorder.bytesWritten() << "x smaller than the raw state" << std::endl;
+	return 0;
+}
+
+// Runs the standard drop on the CPU, exporting the surface every interval steps, and prints how many frames the exporter kept up with
+int runExportMesh(int steps, const std::string& path, int interval, unsigned threads) {
+	CachedTopology body(genSphere(RADIUS));
+	CpuSim sim(body.view(), threads);
+	std::vector<PhysData3D> data3D[2];
+	std::vector<PhysData4D> data4D[2];
+	initPhysState(body.view(), data3D[0], data4D[0]);
+	data3D[1].resize(sim.numCubes());
+	data4D[1].resize(sim.numCubes());
+	
+	MeshSequenceWriter writer(path, body.view());
+	if (!writer.isOpen()) return 1;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; ++i) {
+		int cur = i % 2, next = 1 - cur;
+		if (i % interval == 0) writer.submit(sim.stepCount, data3D[cur].data(), data4D[cur].data());
+		sim.step(data3D[cur].data(), data4D[cur].data(), data3D[next].data(), data4D[next].data(), nullptr, PHYS_TIME_DELTA);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!writer.finish()) return 1;
+	
+	std::cout << steps << " steps in " << seconds << "s" << std::endl;
+	std::cout << writer.framesWritten() << " frames written, " << writer.framesSkipped() << " skipped, " << writer.bytesWritten() << " bytes" << std::endl;
+	return 0;
+}
+
+// Loads a model file, printing how far along it is
+bool importModel(const std::string& path, VoxelModel& model) {
+	bool loaded = loadVoxelModel(path, model, [&path](float done) {
+		std::cout << "\rLoading " << path << ": " << (int) (done * 100) << "%" << std::flush;
+	});
+	std::cout << std::endl;
+	return loaded;
+}
+
+// Loads a model file and builds its topology, and prints what's in it
+int runImport(const std::string& path) {
+	auto start = std::chrono::steady_clock::now();
+	VoxelModel model;
+	if (!importModel(path, model)) return 1;
+	auto loaded = std::chrono::steady_clock::now();
+	VoxelStorage voxels(std::move(model.occupancy), std::move(model.cubeMaterials));
+	auto built = std::chrono::steady_clock::now();
+	
+	size_t materialsUsed = 0;
+	bool used[256] = {};
+	for (uint8_t i : voxels.cubesMaterial) {
+		materialsUsed += !used[i];
+		used[i] = true;
+	}
+	std::cout << voxels.storage.sizes[0] << "x" << voxels.storage.sizes[1] << "x" << voxels.storage.sizes[2] << ", "
+	<< voxels.cubesData.size() << " cubes, " << voxels.faceCubes.size() << " faces, "
+	<< materialsUsed << " materials, " << model.palette.size() << " palette entries" << std::endl;
+	std::cout << "load " << std::chrono::duration<double>(loaded - start).count() << "s, topology "
+	<< std::chrono::duration<double>(built - loaded).count() << "s" << std::endl;
+	return 0;
+}
+
+// Builds a topology a slab at a time, straight to a file, and prints what's in it. source is a sphere's radius, or a model file.
+// Raw files are read a slab at a time, so they can be bigger than memory; their size is given as XxYxZ, or else taken from the name.
+// Other formats are loaded whole first.
+int runBuildTopology(const std::string& path, const std::string& source, const std::string& rawSize) {
+	OccupancyGrid::sizesT sizes;
+	SlabSource slabs;
+	VoxelModel model;
+	char* numberEnd;
+	float radius = strtof(source.c_str(), &numberEnd);
+	if (!source.empty() && *numberEnd == '\0') {
+		size_t size = (size_t) std::ceil(radius * 2);
+		sizes = { size, size, size };
+		slabs = shapeSlabs(sphere(glm::vec3(radius), radius + 0.1f), sizes);
+	}
+	else if (source.size() > 4 && source.compare(source.size() - 4, 4, ".raw") == 0) {
+		if (rawSize.empty()) {
+			if (!rawVoxelSizes(source, sizes)) return 1;
+		}
+		else if (sscanf(rawSize.c_str(), "%zux%zux%zu", &sizes[0], &sizes[1], &sizes[2]) != 3) {
+			std::cout << "Raw sizes go like 128x64x128" << std::endl;
+			return 1;
+		}
+		slabs = rawVoxelSlabs(source, sizes);
+		if (!slabs) return 1;
+	}
+	else {
+		if (!importModel(source, model)) return 1;
+		sizes = model.occupancy.sizes;
+		slabs = gridSlabs(model.occupancy);
+	}
+	
+	auto start = std::chrono::steady_clock::now();
+	bool built = buildTopologyFile(slabs, sizes, path, [](float done) {
+		std::cout << "\rBuilding: " << (int) (done * 100) << "%" << std::flush;
+	});
+	std::cout << std::endl;
+	if (!built) return 1;
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	MappedTopology topology;
+	if (!topology.open(path)) return 1;
+	std::cout << topology.numCubes() << " cubes, " << topology.numVerts() << " vertices, " << topology.numFaces() << " faces, "
+	<< topology.header().fileSize << " bytes in " << seconds << "s" << std::endl;
+	return 0;
+}
+
+// From making the window to the first frame on screen, and how much of that the shaders took. Delete the .program files from the
+// topology cache to see it cold.
+void printStartup(std::chrono::steady_clock::time_point windowStart) {
+	const ProgramStats& stats = programStats();
+	std::cout << "First frame " << std::chrono::duration<double>(std::chrono::steady_clock::now() - windowStart).count() << "s after making the window; "
+	<< stats.fromCache << " programs from cache, " << stats.compiled << " compiled, " << stats.issueSeconds * 1000 << "ms loading and "
+	<< stats.waitSeconds * 1000 << "ms waiting on them" << std::endl;
+}
+
+// Runs the bodies for some frames from distance further back than usual and says what each one drew on average, and whether any of it ended up on screen.
+// Meant for machines without a GPU: LIBGL_ALWAYS_SOFTWARE=1 under Xvfb gets Mesa's llvmpipe.
+int runRenderTest(HelloTriangle& renderer, GLFWwindow* window, int frames, float distance, std::chrono::steady_clock::time_point windowStart) {
+	renderer.voxels().setPaused(false);
+	renderer.backAway(distance);
+	uint64_t physicsDraws = 0, surfaceDraws = 0, facesDrawn = 0, trianglesDrawn = 0, stateRingStalls = 0;
+	uint64_t lodFacesDrawn[NUM_SURFACE_LODS] = {};
+	auto start = std::chrono::steady_clock::now();
+	std::vector<float> depth(windowData.width * windowData.height);
+	for (int i = 0; i < frames; ++i) {
+		renderer.render();
+		FrameStats stats = renderer.voxels().lastFrameStats();
+		physicsDraws += stats.physicsDraws;
+		surfaceDraws += stats.surfaceDraws;
+		facesDrawn += stats.facesDrawn;
+		trianglesDrawn += stats.trianglesDrawn;
+		stateRingStalls += stats.stateRingStalls;
+		for (unsigned level = 0; level < NUM_SURFACE_LODS; ++level) lodFacesDrawn[level] += stats.lodFacesDrawn[level];
+		// Nothing else writes depth, so everything nearer than the far plane is a body
+		if (i == frames - 1) glReadPixels(0, 0, windowData.width, windowData.height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+		if (i == 0) {
+			glFinish();
+			printStartup(windowStart);
+		}
+	}
+	glFinish();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	size_t covered = std::count_if(depth.begin(), depth.end(), [](float d) { return d < 1; });
+	
+	std::cout << glGetString(GL_RENDERER) << std::endl;
+	std::cout << frames << " frames in " << seconds << "s; per frame " << double(surfaceDraws) / frames << " surface draws, "
+	<< double(physicsDraws) / frames << " physics draws, " << double(facesDrawn) / frames << " faces" << std::endl;
+	std::cout << "Faces by level of detail:";
+	for (unsigned level = 0; level < NUM_SURFACE_LODS; ++level) std::cout << " " << double(lodFacesDrawn[level]) / frames;
+	// The GPU's count trails by a frame or two, so the first frames' are missing
+	std::cout << "; " << double(trianglesDrawn) / frames << " triangles per frame counted by the GPU" << std::endl;
+	if (stateRingStalls > 0) std::cout << "The CPU solver waited on the GPU for a state slot " << stateRingStalls << " times" << std::endl;
+	std::cout << covered << " of " << depth.size() << " pixels covered" << std::endl;
+	glfwTerminate();
+	return covered > 0 ? 0 : 1;
+}
+
 int main(int argc, char** argv) {
 	srand(time(0));
 	
+	if (argc > 1 && std::string(argv[1]) == "--compact-drift") {
+		return runCompactDrift(argc > 2 ? atoi(argv[2]) : 600);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--precision-compare") {
+		return runPrecisionCompare(argc > 2 ? atoi(argv[2]) : 600, argc > 3 ? atof(argv[3]) : 0);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--quat-batch") {
+		return runQuatBatchCheck(argc > 2 ? atol(argv[2]) : 1000000);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--vertex-cache") {
+		return runVertexCacheCheck(argc > 2 ? atof(argv[2]) : RADIUS);
+	}
+	if (argc > 2 && std::string(argv[1]) == "--import") {
+		return runImport(argv[2]);
+	}
+	if (argc > 2 && std::string(argv[1]) == "--build-topology") {
+		return runBuildTopology(argv[2], argc > 3 ? argv[3] : std::to_string(RADIUS), argc > 4 ? argv[4] : "");
+	}
+	if (argc > 3 && std::string(argv[1]) == "--checkpointed") {
+		return runCheckpointed(atoll(argv[2]), argv[3], argc > 4 ? atoll(argv[4]) : 100, argc > 5 ? atoi(argv[5]) : std::thread::hardware_concurrency());
+	}
+	if (argc > 3 && std::string(argv[1]) == "--record") {
+		return runRecord(atoi(argv[2]), argv[3], argc > 4 ? atoi(argv[4]) : std::thread::hardware_concurrency());
+	}
+	if (argc > 3 && std::string(argv[1]) == "--export-mesh") {
+		return runExportMesh(atoi(argv[2]), argv[3], argc > 4 ? std::max(atoi(argv[4]), 1) : 1, argc > 5 ? atoi(argv[5]) : std::thread::hardware_concurrency());
+	}
+	if (argc > 1 && std::string(argv[1]) == "--simulate") {
+		return runSimulate(argc > 2 ? atoi(argv[2]) : 600, argc > 3 ? argv[3] : "", argc > 4 ? atoi(argv[4]) : std::thread::hardware_concurrency());
+	}
+	
+	// These can go along with any of the ones below: --bodies <n> for copies of the body side by side, --cpu-physics [threads],
+	// --max-fps <n> to cap the frame rate, --swap-interval <n>, 0 to not wait for vsync, --rewind-mb <n> for how much memory rewinding can use,
+	// and --rewind-every <n> to keep every nth frame to rewind to
+	RendererSettings settings;
+	FramePolicy framePolicy;
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--max-fps" && i + 1 < argc) {
+			framePolicy.maxFps = std::max(atof(argv[i + 1]), 0.0);
+		}
+		if (std::string(argv[i]) == "--swap-interval" && i + 1 < argc) {
+			framePolicy.swapInterval = atoi(argv[i + 1]);
+		}
+		if (std::string(argv[i]) == "--rewind-mb" && i + 1 < argc) {
+			settings.rewindBytes = (size_t) (std::max(atof(argv[i + 1]), 0.0) * (1 << 20));
+		}
+		if (std::string(argv[i]) == "--rewind-every" && i + 1 < argc) {
+			settings.rewindInterval = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (std::string(argv[i]) == "--bodies" && i + 1 < argc) {
+			settings.numBodies = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (std::string(argv[i]) == "--cpu-physics") {
+			settings.cpuThreads = i + 1 < argc && atoi(argv[i + 1]) > 0 ? atoi(argv[i + 1]) : std::max(std::thread::hardware_concurrency(), 1u);
+		}
+	}
+	// Frames to run hidden for, and how far back to watch from
+	int testFrames = 0;
+	float testDistance = 0;
+	if (argc > 1 && std::string(argv[1]) == "--render-test") {
+		settings.numBodies = argc > 2 ? std::max(atoi(argv[2]), 1) : 1;
+		testFrames = argc > 3 ? std::max(atoi(argv[3]), 1) : 120;
+		testDistance = argc > 4 ? atof(argv[4]) : 0;
+	}
+	
+	// The body to drop: a saved run if one was given, a model file, or the default sphere
+	CheckpointSettings checkpoints;
+	std::unique_ptr<CachedTopology> body;
+	auto topologyStart = std::chrono::steady_clock::now();
+	if (argc > 2 && std::string(argv[1]) == "--restore") {
+		checkpoints.path = argv[2];
+		checkpoints.restoreFrom = std::make_shared<MappedCheckpoint>();
+		if (!checkpoints.restoreFrom->open(argv[2])) return 1;
+		const MappedCheckpoint& restored = *checkpoints.restoreFrom;
+		// The checkpoint only names its topology, which has to still be in the cache
+		body.reset(new CachedTopology(restored.header().occupancyHash));
+		if (!body->isOpen()) {
+			std::cout << "The body " << argv[2] << " was saved from isn't in the topology cache; run it again once to put it back" << std::endl;
+			return 1;
+		}
+		if (restored.cubesMaterial()) checkpoints.cubesMaterial.assign(restored.cubesMaterial(), restored.cubesMaterial() + restored.numCubes());
+		checkpoints.palette.assign(restored.palette(), restored.palette() + restored.header().paletteSize);
+	}
+	else {
+		VoxelModel model;
+		if (argc > 2 && std::string(argv[1]) == "--model") {
+			if (!importModel(argv[2], model)) return 1;
+		}
+		else {
+			model.occupancy = genSphere(RADIUS);
+		}
+		body.reset(new CachedTopology(model.occupancy));
+		checkpoints.cubesMaterial = std::move(model.cubeMaterials);
+		checkpoints.palette = std::move(model.palette);
+	}
+	std::cout << (body->wasCached() ? "Topology from cache in " : "Topology built in ")
+	<< std::chrono::duration<double>(std::chrono::steady_clock::now() - topologyStart).count() << "s" << std::endl;
+	
+	auto windowStart = std::chrono::steady_clock::now();
 	glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 #ifdef DEBUG_OUTPUT_SUPPORTED
@@ -317,6 +797,7 @@ int main(int argc, char** argv) {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, testFrames == 0);
 	
 	GLFWwindow* window = glfwCreateWindow(800, 600, "Boingboing", nullptr, nullptr);
 	if (window == nullptr)
@@ -332,6 +813,7 @@ int main(int argc, char** argv) {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	startParallelShaderCompile();
 	
 	GLint flags; glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
 	
@@ -348,6 +830,7 @@ int main(int argc, char** argv) {
 	
 	glfwSetFramebufferSizeCallback(window, [](GLFWwindow* windoww, int width, int height) {
 		windowData.width = width; windowData.height = height;
+		windowData.dirty = true;
 		glViewport(0, 0, width, height);
 	});
 		
@@ -358,21 +841,46 @@ int main(int argc, char** argv) {
 	});
 	
 	
-	HelloTriangle renderer;
+	HelloTriangle renderer(std::move(body), checkpoints, settings);
 	
 	
 	std::cout << glGetString(GL_VERSION) << std::endl;
+	if (testFrames > 0) return runRenderTest(renderer, window, testFrames, testDistance, windowStart);
 	
+	FrameScheduler scheduler(framePolicy);
+	auto startTime = std::chrono::steady_clock::now();
+	auto lastTitleTime = startTime;
+	// Counted since the title was last set, since a single frame almost never has any
+	unsigned stateRingStalls = 0;
+	bool cameraMoving = false;
 	// main loop
 	while(!glfwWindowShouldClose(window))
 	{
-		renderer.processInput(window);
+		// Nothing's drawn while nothing's changing, until some input comes
+		scheduler.waitForFrame(cameraMoving || renderer.voxels().animating());
+		if (glfwWindowShouldClose(window)) break;
+		cameraMoving = renderer.processInput(window);
 		renderer.render();
+		stateRingStalls += renderer.voxels().lastFrameStats().stateRingStalls;
+		
+		// What the frame drew, in the title since it changes too often to print
+		if (std::chrono::steady_clock::now() - lastTitleTime > std::chrono::seconds(1)) {
+			FrameStats stats = renderer.voxels().lastFrameStats();
+			std::string title = "Boingboing - " + std::to_string(stats.surfaceDraws + stats.physicsDraws) + " draws, " + std::to_string(stats.facesDrawn) + " faces";
+			if (stateRingStalls > 0) title += ", " + std::to_string(stateRingStalls) + " stalls";
+			stateRingStalls = 0;
+			glfwSetWindowTitle(window, title.c_str());
+			lastTitleTime = std::chrono::steady_clock::now();
+		}
 		
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		scheduler.frameDrawn();
+		if (scheduler.histogram().count() == 1) printStartup(windowStart);
 	}
 	
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	std::cout << "Ran " << seconds << "s, " << scheduler.idleSeconds() << "s of it idle" << std::endl;
+	scheduler.histogram().print(std::cout);
 	glfwTerminate();
 	return 0;
 }
@@ -0,0 +1,60 @@
+#include "mappedFile.hpp"
+#include <cstdio>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		std::swap(mapped, other.mapped);
+		std::swap(length, other.length);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd == -1) {
+		perror((std::string("Error opening ") + path).c_str());
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) == -1) {
+		perror((std::string("Error reading size of ") + path).c_str());
+		::close(fd);
+		return false;
+	}
+
+	length = info.st_size;
+	// mmap can't map nothing, but an empty file is still a file
+	static const uint8_t empty = 0;
+	void* result = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : (void*) &empty;
+	// The mapping keeps the file alive on its own
+	::close(fd);
+	if (result == MAP_FAILED) {
+		perror((std::string("Error mapping ") + path).c_str());
+		length = 0;
+		return false;
+	}
+	mapped = (const uint8_t*) result;
+	return true;
+}
+
+void MappedFile::close() {
+	if (mapped && length > 0) munmap((void*) mapped, length);
+	mapped = nullptr;
+	length = 0;
+}
+
+void MappedFile::adviseSequential() const {
+	if (mapped && length > 0) madvise((void*) mapped, length, MADV_SEQUENTIAL);
+}
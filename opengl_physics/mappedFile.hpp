@@ -0,0 +1,37 @@
+#ifndef mappedFile_hpp
+#define mappedFile_hpp
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+// A whole file mapped read-only into memory. Pages are read in by the OS as they're touched, so nothing is copied up front.
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& path) { open(path); }
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// Prints why and returns false if the file can't be opened
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return mapped != nullptr; }
+	const uint8_t* data() const { return mapped; }
+	size_t size() const { return length; }
+
+	// Hint that the file will be read front to back, so the OS reads ahead
+	void adviseSequential() const;
+
+private:
+	const uint8_t* mapped = nullptr;
+	size_t length = 0;
+};
+
+
+#endif /* mappedFile_hpp */
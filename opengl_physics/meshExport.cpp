@@ -0,0 +1,287 @@
+#include "meshExport.hpp"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+
+namespace {
+
+template<typename T>
+void append(std::vector<uint8_t>& buffer, const T& value) {
+	const uint8_t* bytes = (const uint8_t*) &value;
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+void appendText(std::vector<uint8_t>& buffer, const std::string& text) {
+	buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+// Just the name, for paths in the glTF file, which are relative to it
+std::string fileName(const std::string& path) {
+	size_t slash = path.rfind('/');
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+}
+
+
+MeshSequenceWriter::MeshSequenceWriter(const std::string& path, const TopologyView& topology) :
+topology(topology), skin(topology) {
+	size_t dot = path.rfind('.');
+	std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+	base = path.substr(0, dot);
+	if (extension == ".ply") format = MeshFormat::PLY;
+	else if (extension == ".obj") format = MeshFormat::OBJ;
+	else if (extension == ".gltf") format = MeshFormat::GLTF;
+	else {
+		std::cout << "Can only export .ply, .obj or .gltf, not " << path << std::endl;
+		return;
+	}
+
+	// Quads go the same way round, seen from outside
+	auto outwardQuad = [&](size_t f, uint32_t* quad) {
+		const uint32_t* in = topology.faceIndices + f * 4;
+		bool flipped = skin.isFaceFlipped(f);
+		for (int i = 0; i < 4; ++i) quad[i] = in[flipped ? (4 - i) % 4 : i];
+	};
+	uint32_t quad[4];
+	switch (format) {
+		case MeshFormat::PLY: {
+			std::ostringstream header;
+			header << "ply\nformat binary_little_endian 1.0\n"
+				<< "element vertex " << topology.numVerts << "\n"
+				<< "property float x\nproperty float y\nproperty float z\n"
+				<< "property float nx\nproperty float ny\nproperty float nz\n"
+				<< "property float strain\n"
+				<< "element face " << topology.numFaces << "\n"
+				<< "property list uchar uint vertex_indices\n"
+				<< "end_header\n";
+			appendText(sharedHeader, header.str());
+			sharedFaces.reserve(topology.numFaces * (1 + sizeof(quad)));
+			for (size_t f = 0; f < topology.numFaces; ++f) {
+				outwardQuad(f, quad);
+				append(sharedFaces, (uint8_t) 4);
+				append(sharedFaces, quad);
+			}
+			break;
+		}
+		case MeshFormat::OBJ: {
+			appendText(sharedHeader, "# Deformed surface of a bouncy cube body\n");
+			std::ostringstream faces;
+			for (size_t f = 0; f < topology.numFaces; ++f) {
+				outwardQuad(f, quad);
+				faces << "f";
+				for (uint32_t v : quad) faces << " " << v + 1 << "//" << v + 1;
+				faces << "\n";
+			}
+			appendText(sharedFaces, faces.str());
+			break;
+		}
+		case MeshFormat::GLTF: {
+			// Written once, and referenced by every frame
+			sharedFaces.reserve(topology.numFaces * 6 * sizeof(uint32_t));
+			for (size_t f = 0; f < topology.numFaces; ++f) {
+				outwardQuad(f, quad);
+				for (int i : {0, 1, 2, 0, 2, 3}) append(sharedFaces, quad[i]);
+			}
+			if (!writeFile(base + ".indices.bin", sharedFaces)) return;
+			break;
+		}
+	}
+	open = true;
+	thread = std::thread(&MeshSequenceWriter::run, this);
+}
+
+MeshSequenceWriter::~MeshSequenceWriter() {
+	finish();
+}
+
+bool MeshSequenceWriter::submit(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D) {
+	if (!open) return false;
+	std::unique_lock<std::mutex> lock(mutex);
+	if (pending.size() >= MAX_PENDING) {
+		++skipped;
+		return false;
+	}
+	PendingFrame frame;
+	if (!spare.empty()) {
+		frame = std::move(spare.back());
+		spare.pop_back();
+	}
+	lock.unlock();
+
+	frame.step = step;
+	frame.data3D.assign(data3D, data3D + topology.numCubes);
+	frame.data4D.assign(data4D, data4D + topology.numCubes);
+
+	lock.lock();
+	pending.push_back(std::move(frame));
+	changed.notify_all();
+	return true;
+}
+
+void MeshSequenceWriter::run() {
+	std::vector<uint8_t> buffer;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [this] { return !pending.empty() || stopping; });
+		if (pending.empty()) return;
+
+		// Stays at the front while it's written, so finish waits for it
+		PendingFrame& frame = pending.front();
+		lock.unlock();
+		writeFrame(frame, buffer);
+		lock.lock();
+		spare.push_back(std::move(pending.front()));
+		pending.pop_front();
+		changed.notify_all();
+	}
+}
+
+void MeshSequenceWriter::writeFrame(const PendingFrame& frame, std::vector<uint8_t>& buffer) {
+	skin.update(frame.data3D.data(), frame.data4D.data());
+	const std::vector<glm::vec3>& pos = skin.vertPositions();
+	const std::vector<glm::vec3>& normals = skin.vertNormals();
+	const std::vector<float>& strain = skin.vertStrain();
+	const size_t numVerts = skin.numVerts();
+
+	WrittenFrame done = { frame.step, glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+	for (const glm::vec3& p : pos) {
+		done.min = glm::min(done.min, p);
+		done.max = glm::max(done.max, p);
+	}
+
+	// Whole frames are put together in memory and written in one go
+	buffer.clear();
+	const char* extension = "";
+	switch (format) {
+		case MeshFormat::PLY: {
+			extension = ".ply";
+			buffer.insert(buffer.end(), sharedHeader.begin(), sharedHeader.end());
+			buffer.reserve(sharedHeader.size() + numVerts * 7 * sizeof(float) + sharedFaces.size());
+			for (size_t v = 0; v < numVerts; ++v) {
+				append(buffer, pos[v]);
+				append(buffer, normals[v]);
+				append(buffer, strain[v]);
+			}
+			buffer.insert(buffer.end(), sharedFaces.begin(), sharedFaces.end());
+			break;
+		}
+		case MeshFormat::OBJ: {
+			extension = ".obj";
+			buffer.insert(buffer.end(), sharedHeader.begin(), sharedHeader.end());
+			char line[128];
+			for (size_t v = 0; v < numVerts; ++v) {
+				int length = snprintf(line, sizeof(line), "v %.6g %.6g %.6g\n", pos[v].x, pos[v].y, pos[v].z);
+				buffer.insert(buffer.end(), line, line + length);
+			}
+			for (size_t v = 0; v < numVerts; ++v) {
+				int length = snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", normals[v].x, normals[v].y, normals[v].z);
+				buffer.insert(buffer.end(), line, line + length);
+			}
+			buffer.insert(buffer.end(), sharedFaces.begin(), sharedFaces.end());
+			break;
+		}
+		case MeshFormat::GLTF: {
+			extension = ".bin";
+			// Positions, then normals, then strain, each packed tight
+			buffer.resize(numVerts * 7 * sizeof(float));
+			memcpy(buffer.data(), pos.data(), numVerts * sizeof(glm::vec3));
+			memcpy(buffer.data() + numVerts * sizeof(glm::vec3), normals.data(), numVerts * sizeof(glm::vec3));
+			memcpy(buffer.data() + numVerts * 2 * sizeof(glm::vec3), strain.data(), numVerts * sizeof(float));
+			break;
+		}
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "_%08llu", (unsigned long long) frame.step);
+	if (!writeFile(base + name + extension, buffer)) {
+		failed = true;
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	written.push_back(done);
+	bytes += buffer.size();
+}
+
+bool MeshSequenceWriter::writeFile(const std::string& path, const std::vector<uint8_t>& buffer) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		perror((std::string("Error creating ") + path).c_str());
+		return false;
+	}
+	bool ok = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	if (fclose(file) != 0) ok = false;
+	if (!ok) perror((std::string("Error writing ") + path).c_str());
+	return ok;
+}
+
+bool MeshSequenceWriter::finish() {
+	if (!open) return false;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+		changed.notify_all();
+	}
+	thread.join();
+	open = false;
+	if (format == MeshFormat::GLTF && !writeGltf()) failed = true;
+	return !failed;
+}
+
+// A scene per frame. Buffer 0, buffer view 0 and accessor 0 are the triangles; frame i is buffer i + 1, and buffer views and accessors 3i + 1 to 3i + 3,
+// one each for positions, normals and strain. Accessors sharing a view would need a byteStride, which a VEC3 and a SCALAR can't agree on.
+bool MeshSequenceWriter::writeGltf() {
+	const size_t numVerts = skin.numVerts();
+	const size_t frameBytes = numVerts * 7 * sizeof(float);
+	std::ostringstream json;
+	json.precision(9);
+	json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"bouncy-cube\"},\"scene\":0,\n";
+
+	std::ostringstream scenes, nodes, meshes, accessors, views, buffers;
+	accessors << "{\"bufferView\":0,\"componentType\":5125,\"count\":" << topology.numFaces * 6 << ",\"type\":\"SCALAR\"}";
+	views << "{\"buffer\":0,\"byteLength\":" << sharedFaces.size() << ",\"target\":34963}";
+	buffers << "{\"uri\":\"" << fileName(base) << ".indices.bin\",\"byteLength\":" << sharedFaces.size() << "}";
+	for (size_t i = 0; i < written.size(); ++i) {
+		const WrittenFrame& frame = written[i];
+		char name[32];
+		snprintf(name, sizeof(name), "_%08llu", (unsigned long long) frame.step);
+		const char* separator = i == 0 ? "" : ",\n";
+		scenes << separator << "{\"name\":\"step " << frame.step << "\",\"nodes\":[" << i << "]}";
+		nodes << separator << "{\"mesh\":" << i << "}";
+		size_t first = i * 3 + 1;
+		meshes << separator << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << first << ",\"NORMAL\":" << first + 1
+			<< ",\"_STRAIN\":" << first + 2 << "},\"indices\":0}]}";
+		accessors << ",\n{\"bufferView\":" << first << ",\"componentType\":5126,\"count\":" << numVerts << ",\"type\":\"VEC3\""
+			<< ",\"min\":[" << frame.min.x << "," << frame.min.y << "," << frame.min.z << "]"
+			<< ",\"max\":[" << frame.max.x << "," << frame.max.y << "," << frame.max.z << "]}";
+		accessors << ",\n{\"bufferView\":" << first + 1 << ",\"componentType\":5126,\"count\":" << numVerts << ",\"type\":\"VEC3\"}";
+		accessors << ",\n{\"bufferView\":" << first + 2 << ",\"componentType\":5126,\"count\":" << numVerts << ",\"type\":\"SCALAR\"}";
+		const size_t vec3Bytes = numVerts * sizeof(glm::vec3);
+		views << ",\n{\"buffer\":" << i + 1 << ",\"byteLength\":" << vec3Bytes << ",\"target\":34962}";
+		views << ",\n{\"buffer\":" << i + 1 << ",\"byteOffset\":" << vec3Bytes << ",\"byteLength\":" << vec3Bytes << ",\"target\":34962}";
+		views << ",\n{\"buffer\":" << i + 1 << ",\"byteOffset\":" << vec3Bytes * 2 << ",\"byteLength\":" << numVerts * sizeof(float) << ",\"target\":34962}";
+		buffers << ",\n{\"uri\":\"" << fileName(base) << name << ".bin\",\"byteLength\":" << frameBytes << "}";
+	}
+	json << "\"scenes\":[" << scenes.str() << "],\n\"nodes\":[" << nodes.str() << "],\n\"meshes\":[" << meshes.str() << "],\n"
+		<< "\"accessors\":[" << accessors.str() << "],\n\"bufferViews\":[" << views.str() << "],\n\"buffers\":[" << buffers.str() << "]}\n";
+
+	std::string text = json.str();
+	return writeFile(base + ".gltf", std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+uint64_t MeshSequenceWriter::framesWritten() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return written.size();
+}
+
+uint64_t MeshSequenceWriter::framesSkipped() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return skipped;
+}
+
+uint64_t MeshSequenceWriter::bytesWritten() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return bytes;
+}
@@ -0,0 +1,80 @@
+#ifndef meshExport_hpp
+#define meshExport_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include "physState.hpp"
+#include "voxelStorage.hpp"
+#include "surfaceSkin.hpp"
+
+
+// Picked by the extension of the path given to MeshSequenceWriter
+enum class MeshFormat { PLY, OBJ, GLTF };
+
+// Writes the deformed surface as one mesh per frame, for offline renderers and anything else that reads meshes.
+// For path out.ply, frames go to out_<step>.ply. PLY is binary, with a strain value per vertex; OBJ is text, and slow to write.
+// glTF frames are out_<step>.bin with positions, normals and strain (as _STRAIN). The triangles are written once, to out.indices.bin,
+// and finish writes out.gltf, with a scene per frame that all share them.
+// Skinning and writing happen on a thread of their own. If it's too far behind to take another frame, the frame is skipped, so exporting never holds up the solver.
+class MeshSequenceWriter {
+public:
+	// Reads the topology in place, so whatever it points into has to outlive this. Prints why and leaves isOpen false on failure.
+	MeshSequenceWriter(const std::string& path, const TopologyView& topology);
+	// Finishes if finish wasn't called
+	~MeshSequenceWriter();
+
+	bool isOpen() const { return open; }
+	// Copies the state and goes back to the caller. Returns false if the frame was skipped.
+	bool submit(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D);
+	// Writes everything queued, and the glTF file. Returns false if anything failed to write.
+	bool finish();
+
+	uint64_t framesWritten() const;
+	uint64_t framesSkipped() const;
+	uint64_t bytesWritten() const;
+
+private:
+	struct PendingFrame {
+		uint64_t step;
+		std::vector<PhysData3D> data3D;
+		std::vector<PhysData4D> data4D;
+	};
+	// Bounds on each frame's positions, which glTF needs
+	struct WrittenFrame {
+		uint64_t step;
+		glm::vec3 min, max;
+	};
+	static constexpr size_t MAX_PENDING = 2;
+
+	MeshFormat format;
+	// path without its extension
+	std::string base;
+	TopologyView topology;
+	SurfaceSkin skin;
+	// The parts that are the same in every frame: the header and face list for PLY and OBJ, or the triangles for glTF
+	std::vector<uint8_t> sharedHeader, sharedFaces;
+	std::vector<WrittenFrame> written;
+	uint64_t skipped = 0, bytes = 0;
+	bool open = false, failed = false;
+
+	std::deque<PendingFrame> pending;
+	std::vector<PendingFrame> spare;
+	bool stopping = false;
+	mutable std::mutex mutex;
+	std::condition_variable changed;
+	std::thread thread;
+
+	void run();
+	void writeFrame(const PendingFrame& frame, std::vector<uint8_t>& buffer);
+	bool writeFile(const std::string& path, const std::vector<uint8_t>& buffer);
+	bool writeGltf();
+};
+
+
+#endif /* meshExport_hpp */
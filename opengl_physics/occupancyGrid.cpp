@@ -0,0 +1,124 @@
+#include "occupancyGrid.hpp"
+
+
+namespace {
+
+inline int popcount(uint64_t word) {
+	return __builtin_popcountll(word);
+}
+
+// Bit x of the result is bit x - 1 of the row, or bit x + 1, carrying across words
+inline uint64_t shiftedUp(const uint64_t* row, size_t i) {
+	return (row[i] << 1) | (i > 0 ? row[i - 1] >> 63 : 0);
+}
+inline uint64_t shiftedDown(const uint64_t* row, size_t i, size_t words) {
+	return (row[i] >> 1) | (i + 1 < words ? row[i + 1] << 63 : 0);
+}
+
+}
+
+
+OccupancyGrid::OccupancyGrid(sizesT sizes) :
+sizes(sizes),
+wordsPerRow((sizes[0] + 63) / 64),
+words(wordsPerRow * sizes[1] * sizes[2], 0),
+emptyRow(wordsPerRow + 1, 0) {}
+
+OccupancyGrid::OccupancyGrid(const arrayND<bool, 3>& grid) : OccupancyGrid(grid.sizes) {
+	size_t i = 0;
+	for (size_t z = 0; z < sizes[2]; ++z)
+	for (size_t y = 0; y < sizes[1]; ++y) {
+		uint64_t* bits = row(y, z);
+		for (size_t x = 0; x < sizes[0]; ++x, ++i) {
+			if (grid.linear()[i]) bits[x / 64] |= uint64_t(1) << (x % 64);
+		}
+	}
+}
+
+arrayND<bool, 3> OccupancyGrid::toArray() const {
+	arrayND<bool, 3> grid(sizes, false);
+	size_t i = 0;
+	for (size_t z = 0; z < sizes[2]; ++z)
+	for (size_t y = 0; y < sizes[1]; ++y) {
+		const uint64_t* bits = row(y, z);
+		for (size_t x = 0; x < sizes[0]; ++x, ++i) {
+			grid.linear()[i] = (bits[x / 64] >> (x % 64)) & 1;
+		}
+	}
+	return grid;
+}
+
+const uint64_t* OccupancyGrid::rowOrEmpty(ptrdiff_t y, ptrdiff_t z) const {
+	if (y < 0 || z < 0 || (size_t) y >= sizes[1] || (size_t) z >= sizes[2]) return emptyRow.data();
+	return row(y, z);
+}
+
+size_t OccupancyGrid::count() const {
+	size_t total = 0;
+	for (uint64_t word : words) total += popcount(word);
+	return total;
+}
+
+void OccupancyGrid::faceMaskRow(size_t y, size_t z, int dir, uint64_t* out) const {
+	const uint64_t* bits = row(y, z);
+	int axis = dir % 3;
+	int step = dir < 3 ? -1 : 1;
+	if (axis == 0) {
+		for (size_t i = 0; i < wordsPerRow; ++i) {
+			uint64_t neighbor = step < 0 ? shiftedUp(bits, i) : shiftedDown(bits, i, wordsPerRow);
+			out[i] = bits[i] & ~neighbor;
+		}
+	}
+	else {
+		const uint64_t* neighbor = axis == 1 ? rowOrEmpty((ptrdiff_t) y + step, z) : rowOrEmpty(y, (ptrdiff_t) z + step);
+		for (size_t i = 0; i < wordsPerRow; ++i) {
+			out[i] = bits[i] & ~neighbor[i];
+		}
+	}
+}
+
+size_t OccupancyGrid::countFaces() const {
+	size_t total = 0;
+	std::vector<uint64_t> mask(wordsPerRow);
+	for (size_t z = 0; z < sizes[2]; ++z)
+	for (size_t y = 0; y < sizes[1]; ++y) {
+		for (int dir = 0; dir < 6; ++dir) {
+			faceMaskRow(y, z, dir, mask.data());
+			for (uint64_t word : mask) total += popcount(word);
+		}
+	}
+	return total;
+}
+
+void OccupancyGrid::surfaceCornerRow(size_t y, size_t z, uint64_t* out) const {
+	// The four rows of voxels around this row of corners
+	const uint64_t* rows[4] = {
+		rowOrEmpty((ptrdiff_t) y - 1, (ptrdiff_t) z - 1), rowOrEmpty(y, (ptrdiff_t) z - 1),
+		rowOrEmpty((ptrdiff_t) y - 1, z), rowOrEmpty(y, z)
+	};
+	// Voxel x is in any/all of the four rows, then corner x is any/all of voxels x-1 and x
+	uint64_t prevAny = 0, prevAll = 0;
+	for (size_t i = 0; i < cornerWordsPerRow(); ++i) {
+		uint64_t any = 0, all = 0;
+		if (i < wordsPerRow) {
+			any = rows[0][i] | rows[1][i] | rows[2][i] | rows[3][i];
+			all = rows[0][i] & rows[1][i] & rows[2][i] & rows[3][i];
+		}
+		uint64_t cornerAny = any | (any << 1) | (prevAny >> 63);
+		uint64_t cornerAll = all & ((all << 1) | (prevAll >> 63));
+		out[i] = cornerAny & ~cornerAll;
+		prevAny = any;
+		prevAll = all;
+	}
+}
+
+size_t OccupancyGrid::countSurfaceCorners() const {
+	size_t total = 0;
+	std::vector<uint64_t> mask(cornerWordsPerRow());
+	for (size_t z = 0; z <= sizes[2]; ++z)
+	for (size_t y = 0; y <= sizes[1]; ++y) {
+		surfaceCornerRow(y, z, mask.data());
+		for (uint64_t word : mask) total += popcount(word);
+	}
+	return total;
+}
@@ -0,0 +1,63 @@
+#ifndef occupancyGrid_hpp
+#define occupancyGrid_hpp
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include "arrayND.hpp"
+
+
+// Which voxels are filled, one bit each, with each x row packed into 64-bit words so whole rows can be tested at once.
+// Bit x % 64 of word x / 64 is voxel x. Bits past the end of a row are always 0.
+class OccupancyGrid {
+public:
+	typedef std::array<size_t, 3> sizesT;
+
+	sizesT sizes;
+	size_t wordsPerRow;
+	std::vector<uint64_t> words;
+
+	explicit OccupancyGrid(sizesT sizes);
+	explicit OccupancyGrid(const arrayND<bool, 3>& grid);
+
+	arrayND<bool, 3> toArray() const;
+
+	bool get(size_t x, size_t y, size_t z) const {
+		return (row(y, z)[x / 64] >> (x % 64)) & 1;
+	}
+	void set(size_t x, size_t y, size_t z, bool filled) {
+		uint64_t bit = uint64_t(1) << (x % 64);
+		if (filled) row(y, z)[x / 64] |= bit;
+		else row(y, z)[x / 64] &= ~bit;
+	}
+
+	uint64_t* row(size_t y, size_t z) {
+		return &words[(z * sizes[1] + y) * wordsPerRow];
+	}
+	const uint64_t* row(size_t y, size_t z) const {
+		return &words[(z * sizes[1] + y) * wordsPerRow];
+	}
+	// Same, but all empty outside the grid, so callers don't have to check the edges
+	const uint64_t* rowOrEmpty(ptrdiff_t y, ptrdiff_t z) const;
+
+	// Filled voxels
+	size_t count() const;
+
+	// Voxels in the row that are filled but whose neighbor in direction dir isn't.
+	// dir is in the same order as VoxelStorage::CubeData: -x, -y, -z, +x, +y, +z. out has wordsPerRow words.
+	void faceMaskRow(size_t y, size_t z, int dir, uint64_t* out) const;
+	// Every face between a filled voxel and an empty one or the outside
+	size_t countFaces() const;
+
+	// Corners are on a grid one bigger than the voxels, and corner (x, y, z) touches voxels (x-1..x, y-1..y, z-1..z).
+	size_t cornerWordsPerRow() const { return (sizes[0] + 1 + 63) / 64; }
+	// Corners in the row that touch both filled and empty voxels (or the outside). out has cornerWordsPerRow() words.
+	void surfaceCornerRow(size_t y, size_t z, uint64_t* out) const;
+	size_t countSurfaceCorners() const;
+
+private:
+	std::vector<uint64_t> emptyRow;
+};
+
+
+#endif /* occupancyGrid_hpp */
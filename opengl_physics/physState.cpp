@@ -0,0 +1,102 @@
+#include "physState.hpp"
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
+
+
+// Smallest position step a brick will use. Bricks that span more than 32767 of these get a coarser step.
+constexpr float MIN_POS_SCALE = 1.0f / 8192;
+constexpr float QUAT_COMPONENT_RANGE = (float) M_SQRT1_2;
+
+uint32_t packQuat(glm::vec4 q) {
+	q = glm::normalize(q);
+	int largest = 0;
+	for (int i = 1; i < 4; ++i) {
+		if (std::abs(q[i]) > std::abs(q[largest])) largest = i;
+	}
+	// q and -q are the same rotation, so the dropped component can always be positive
+	if (q[largest] < 0) q = -q;
+
+	uint32_t packed = (uint32_t) largest << 30;
+	int shift = 20;
+	for (int i = 0; i < 4; ++i) {
+		if (i == largest) continue;
+		float normalized = (q[i] / QUAT_COMPONENT_RANGE) * 0.5f + 0.5f;
+		uint32_t bits = (uint32_t) std::round(std::min(std::max(normalized, 0.0f), 1.0f) * 1023);
+		packed |= bits << shift;
+		shift -= 10;
+	}
+	return packed;
+}
+
+glm::vec4 unpackQuat(uint32_t packed) {
+	int largest = packed >> 30;
+	glm::vec4 q;
+	float sumSquares = 0;
+	int shift = 20;
+	for (int i = 0; i < 4; ++i) {
+		if (i == largest) continue;
+		float normalized = ((packed >> shift) & 1023) / 1023.0f;
+		q[i] = (normalized * 2 - 1) * QUAT_COMPONENT_RANGE;
+		sumSquares += q[i] * q[i];
+		shift -= 10;
+	}
+	q[largest] = std::sqrt(std::max(1 - sumSquares, 0.0f));
+	return q;
+}
+
+CubeState decodeCube(const CompactPhysData& cube, const CompactBrick& brick) {
+	CubeState toReturn;
+	for (int i = 0; i < 3; ++i) {
+		toReturn.pos[i] = brick.origin[i] + cube.pos[i] * brick.posScale;
+		toReturn.vel[i] = glm::unpackHalf1x16(cube.vel[i]);
+		toReturn.angVel[i] = glm::unpackHalf1x16(cube.angVel[i]);
+	}
+	toReturn.turn = unpackQuat(cube.turn);
+	return toReturn;
+}
+
+void encodeBrick(const CubeState* cubes, size_t count, CompactBrick& brick, CompactPhysData* out) {
+	glm::vec3 lo = cubes[0].pos, hi = cubes[0].pos;
+	for (size_t i = 1; i < count; ++i) {
+		lo = glm::min(lo, cubes[i].pos);
+		hi = glm::max(hi, cubes[i].pos);
+	}
+	brick.origin = (lo + hi) * 0.5f;
+	glm::vec3 halfExtent = (hi - lo) * 0.5f;
+	float maxHalfExtent = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+	brick.posScale = std::max(maxHalfExtent / 32767, MIN_POS_SCALE);
+
+	for (size_t i = 0; i < count; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			float steps = std::round((cubes[i].pos[j] - brick.origin[j]) / brick.posScale);
+			out[i].pos[j] = (int16_t) std::min(std::max(steps, -32767.0f), 32767.0f);
+			out[i].vel[j] = glm::packHalf1x16(cubes[i].vel[j]);
+			out[i].angVel[j] = glm::packHalf1x16(cubes[i].angVel[j]);
+		}
+		out[i].turn = packQuat(cubes[i].turn);
+	}
+}
+
+void compactState(const PhysData3D* data3D, const PhysData4D* data4D, size_t numCubes, CompactPhysState& out) {
+	out.resize(numCubes);
+	CubeState brickCubes[COMPACT_BRICK_SIZE];
+	for (size_t brick = 0; brick < out.bricks.size(); ++brick) {
+		size_t start = brick * COMPACT_BRICK_SIZE;
+		size_t count = std::min(COMPACT_BRICK_SIZE, numCubes - start);
+		for (size_t i = 0; i < count; ++i) {
+			brickCubes[i] = { data3D[start + i].pos, data3D[start + i].vel, data3D[start + i].angVel, data4D[start + i].turn };
+		}
+		encodeBrick(brickCubes, count, out.bricks[brick], &out.cubes[start]);
+	}
+}
+
+void expandState(const CompactPhysState& in, PhysData3D* data3D, PhysData4D* data4D) {
+	for (size_t i = 0; i < in.cubes.size(); ++i) {
+		CubeState cube = decodeCube(in.cubes[i], in.bricks[i / COMPACT_BRICK_SIZE]);
+		data3D[i].pos = cube.pos;
+		data3D[i].vel = cube.vel;
+		data3D[i].angVel = cube.angVel;
+		data4D[i].turn = cube.turn;
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef physState_hpp
+#define physState_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+
+// Per-cube simulation state, laid out the same as the allVerts3D and allVerts4D GL buffers when T is float.
+// The CPU solver can also run in double, in which case the layout only matters to the CPU.
+template<typename T>
+struct PhysData3DT {
+	glm::vec<3, T> pos = glm::zero<glm::vec<3, T>>();
+	//glm::vec3 turn = glm::zero<glm::vec3>();
+	glm::vec<3, T> vel = glm::zero<glm::vec<3, T>>();
+	glm::vec<3, T> angVel = glm::zero<glm::vec<3, T>>();
+};
+template<typename T>
+struct PhysData4DT {
+	glm::vec<4, T> turn = glm::vec<4, T>(0, 0, 0, 1);
+};
+typedef PhysData3DT<float> PhysData3D;
+typedef PhysData4DT<float> PhysData4D;
+
+// The state of one cube after decoding, whatever layout it's stored in
+template<typename T>
+struct CubeStateT {
+	glm::vec<3, T> pos, vel, angVel;
+	glm::vec<4, T> turn;
+};
+typedef CubeStateT<float> CubeState;
+
+// Compiles down to a plain copy when T and U are the same
+template<typename T, typename U>
+inline CubeStateT<T> convertState(const CubeStateT<U>& in) {
+	return { glm::vec<3, T>(in.pos), glm::vec<3, T>(in.vel), glm::vec<3, T>(in.angVel), glm::vec<4, T>(in.turn) };
+}
+
+
+// Compact layout: 24 bytes per cube instead of 52.
+// Positions are 16 bit fixed point offsets from the origin of the brick the cube is in, where a brick is COMPACT_BRICK_SIZE consecutive cubes. Since cubes are numbered in x-y-z order, a brick is a few neighboring rows of the body, which keeps the offsets small.
+// Error bounds: position is within posScale / 2, which is 1/16384 for a brick spanning up to 8 units and grows linearly with the span past that; vel and angVel are half floats, so relative error 2^-11; each stored quaternion component is within 0.0007.
+constexpr size_t COMPACT_BRICK_SIZE = 256;
+
+struct CompactPhysData {
+	// Offset from CompactBrick::origin in units of CompactBrick::posScale
+	int16_t pos[3];
+	// Half floats
+	uint16_t vel[3];
+	uint16_t angVel[3];
+	// Smallest-three: the top 2 bits are which component was dropped, then 10 bits for each of the other three
+	uint32_t turn;
+};
+
+struct CompactBrick {
+	glm::vec3 origin;
+	float posScale;
+};
+
+struct CompactPhysState {
+	std::vector<CompactPhysData> cubes;
+	std::vector<CompactBrick> bricks;
+
+	void resize(size_t numCubes) {
+		cubes.resize(numCubes);
+		bricks.resize((numCubes + COMPACT_BRICK_SIZE - 1) / COMPACT_BRICK_SIZE);
+	}
+	size_t bytes() const {
+		return cubes.size() * sizeof(CompactPhysData) + bricks.size() * sizeof(CompactBrick);
+	}
+};
+
+uint32_t packQuat(glm::vec4 q);
+glm::vec4 unpackQuat(uint32_t packed);
+
+CubeState decodeCube(const CompactPhysData& cube, const CompactBrick& brick);
+// Picks the origin and scale of the brick to fit all the given cubes, then encodes them
+void encodeBrick(const CubeState* cubes, size_t count, CompactBrick& brick, CompactPhysData* out);
+
+void compactState(const PhysData3D* data3D, const PhysData4D* data4D, size_t numCubes, CompactPhysState& out);
+void expandState(const CompactPhysState& in, PhysData3D* data3D, PhysData4D* data4D);
+
+
+#endif /* physState_hpp */
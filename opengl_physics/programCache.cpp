@@ -0,0 +1,210 @@
+#include "programCache.hpp"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include <chrono>
+#include <iostream>
+#include <unistd.h>
+#include "topologyCache.hpp"
+
+
+namespace {
+
+ProgramStats stats;
+
+// Starts cached binaries, so a file of something else that happens to have the right name isn't handed to the driver
+constexpr char BINARY_MAGIC[4] = {'B', 'C', 'P', 'B'};
+
+struct BinaryHeader {
+	char magic[4];
+	uint32_t format;
+	uint64_t key;
+	uint64_t length;
+};
+
+// FNV-1a, over everything that could change what the driver makes of the sources
+struct KeyHasher {
+	uint64_t hash = 0xCBF29CE484222325;
+	void add(const void* data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= ((const unsigned char*) data)[i];
+			hash *= 0x100000001B3;
+		}
+	}
+	// With its length, so one string running into the next can't collide
+	void add(const std::string& str) {
+		uint64_t size = str.size();
+		add(&size, sizeof(size));
+		add(str.data(), str.size());
+	}
+};
+
+std::string driverString(GLenum name) {
+	const char* str = (const char*) glGetString(name);
+	return str ? str : "";
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Empty if binaries can't be cached, because the driver has no binary formats or there's no cache directory
+std::string cachedBinaryPath(uint64_t key) {
+	static bool checked = false, supported = false;
+	if (!checked) {
+		checked = true;
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		supported = numFormats > 0;
+	}
+	if (!supported) return "";
+	std::string dir = topologyCacheDir();
+	if (dir.empty()) return "";
+	char name[32];
+	snprintf(name, sizeof(name), "/%016" PRIx64 ".program", key);
+	return dir + name;
+}
+
+// Loads the cached binary into program. False if there isn't one, or the driver won't take it anymore.
+bool loadBinary(GLuint program, uint64_t key, const std::string& path) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+	BinaryHeader header;
+	std::vector<char> binary;
+	bool read = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0
+	&& header.key == key && header.length > 0 && header.length < (1 << 30);
+	if (read) {
+		binary.resize(header.length);
+		read = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+	fclose(file);
+	if (!read) return false;
+
+	glProgramBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success;
+}
+
+void saveBinary(GLuint program, uint64_t key, const std::string& path) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector<char> binary(length);
+	BinaryHeader header;
+	memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	header.format = format;
+	header.key = key;
+	header.length = length;
+
+	// Written under another name first, so another instance starting up never reads half of one
+	std::string partial = path + "." + std::to_string(getpid());
+	FILE* file = fopen(partial.c_str(), "wb");
+	if (!file) return;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, header.length, file) == header.length;
+	if (fclose(file) == 0 && written && rename(partial.c_str(), path.c_str()) == 0) return;
+	remove(partial.c_str());
+}
+
+}
+
+
+void startParallelShaderCompile() {
+#ifdef PARALLEL_SHADER_COMPILE_SUPPORTED
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; ++i) {
+		const char* name = (const char*) glGetStringi(GL_EXTENSIONS, i);
+		if (name && strcmp(name, "GL_KHR_parallel_shader_compile") == 0) {
+			// All the threads it wants
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+			return;
+		}
+	}
+#endif
+}
+
+
+Program::Program(const std::vector<ShaderSource>& sources, std::function<void(GLuint)> preLinkOptions, const std::string& optionsKey) {
+	auto start = std::chrono::steady_clock::now();
+
+	KeyHasher hasher;
+	for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) hasher.add(driverString(name));
+	for (const ShaderSource& source : sources) {
+		hasher.add(&source.type, sizeof(source.type));
+		hasher.add(source.text);
+	}
+	hasher.add(optionsKey);
+	key = hasher.hash;
+
+	program = glCreateProgram();
+	std::string path = cachedBinaryPath(key);
+	if (!path.empty() && loadBinary(program, key, path)) {
+		cached = linked = true;
+		++stats.fromCache;
+	}
+	else {
+		for (const ShaderSource& source : sources) {
+			GLuint shader = glCreateShader(source.type);
+			const char* text = source.text.c_str();
+			glShaderSource(shader, 1, &text, NULL);
+			glCompileShader(shader);
+			glAttachShader(program, shader);
+			shaders.push_back(shader);
+			shaderNames.push_back(source.name);
+		}
+		if (preLinkOptions != nullptr) preLinkOptions(program);
+		if (!path.empty()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		// Asking whether it worked would wait for it, so that's left for id()
+		glLinkProgram(program);
+		++stats.compiled;
+	}
+	stats.issueSeconds += secondsSince(start);
+}
+
+Program::~Program() {
+	for (GLuint shader : shaders) glDeleteShader(shader);
+	glDeleteProgram(program);
+}
+
+GLuint Program::id() const {
+	if (!linked) finishLinking();
+	return program;
+}
+
+void Program::finishLinking() const {
+	auto start = std::chrono::steady_clock::now();
+	linked = true;
+
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		char infoLog[512];
+		for (size_t i = 0; i < shaders.size(); ++i) {
+			glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &success);
+			if (success) continue;
+			glGetShaderInfoLog(shaders[i], 512, NULL, infoLog);
+			std::cout << "ERROR: SHADER " << shaderNames[i] << " COMPILATION FAILED\n" << infoLog << std::endl;
+		}
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		std::cout << "ERROR: SHADER LINKING FAILED\n" << infoLog << std::endl;
+		glfwTerminate();
+		exit(1);
+	}
+	for (GLuint shader : shaders) {
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	shaders.clear();
+
+	std::string path = cachedBinaryPath(key);
+	if (!path.empty()) saveBinary(program, key, path);
+	stats.waitSeconds += secondsSince(start);
+}
+
+const ProgramStats& programStats() {
+	return stats;
+}
@@ -0,0 +1,70 @@
+#ifndef programCache_hpp
+#define programCache_hpp
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+
+// Lets the driver compile and link on its own threads, so compiling every program at startup overlaps instead of happening one after another
+#ifdef GL_COMPLETION_STATUS_KHR
+#define PARALLEL_SHADER_COMPILE_SUPPORTED
+#endif
+
+// One stage of a program, with its includes already spliced in
+struct ShaderSource {
+	GLenum type;
+	// For error messages
+	std::string name;
+	std::string text;
+};
+
+// Asks for as many compiler threads as the driver will give, if it has KHR_parallel_shader_compile. Call once the context is current.
+void startParallelShaderCompile();
+
+// A linked program, either loaded from a binary cached by an earlier run or compiled from source.
+// Compiling only starts the driver off: nothing waits for it until the program's first used, so every program can be compiling at once.
+// Binaries are kept in topologyCacheDir(), named by a hash of the sources and the driver's strings, so editing a shader or updating the driver
+// never picks up a stale one.
+class Program {
+public:
+	// preLinkOptions is run before linking, for things like transform feedback varyings. Anything it sets that changes the binary
+	// has to go in optionsKey too, since it isn't part of the sources.
+	explicit Program(const std::vector<ShaderSource>& sources, std::function<void(GLuint)> preLinkOptions = nullptr, const std::string& optionsKey = "");
+	~Program();
+	Program(const Program&) = delete;
+	Program& operator=(const Program&) = delete;
+
+	// Waits for linking if it hasn't been waited for yet. Compile or link errors are fatal, like they've always been.
+	GLuint id() const;
+	operator GLuint() const { return id(); }
+
+	bool wasCached() const { return cached; }
+
+private:
+	void finishLinking() const;
+
+	GLuint program;
+	uint64_t key;
+	bool cached = false;
+	mutable bool linked = false;
+	// Kept until linking's done, for their logs if it fails
+	mutable std::vector<GLuint> shaders;
+	std::vector<std::string> shaderNames;
+};
+
+// How startup went
+struct ProgramStats {
+	unsigned fromCache = 0, compiled = 0;
+	// In the constructors, reading binaries and handing sources to the driver
+	double issueSeconds = 0;
+	// In id(), waiting for the driver to finish
+	double waitSeconds = 0;
+};
+
+const ProgramStats& programStats();
+
+
+#endif /* programCache_hpp */
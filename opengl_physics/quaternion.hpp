@@ -0,0 +1,66 @@
+#ifndef quaternion_hpp
+#define quaternion_hpp
+
+// C++ versions of the functions in shaders/quaternion.glsl, so the CPU can run the same math as sim.vert.
+// Quaternions are vec4s with the real part in w, same as on the GPU. Templated so the CPU solver can run in float or double.
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+
+template<typename T>
+inline glm::vec<4, T> quat_identity() {
+	return glm::vec<4, T>(0, 0, 0, 1);
+}
+
+template<typename T>
+inline glm::vec<3, T> quat_xyz(glm::vec<4, T> q) {
+	return glm::vec<3, T>(q.x, q.y, q.z);
+}
+
+// Quaternion multiplication
+template<typename T>
+inline glm::vec<4, T> quat_mul(glm::vec<4, T> q1, glm::vec<4, T> q2) {
+	glm::vec<3, T> v1 = quat_xyz(q1), v2 = quat_xyz(q2);
+	return glm::vec<4, T>(
+		v2 * q1.w + v1 * q2.w + glm::cross(v1, v2),
+		q1.w * q2.w - glm::dot(v1, v2)
+	);
+}
+
+// Vector rotation with a quaternion
+template<typename T>
+inline glm::vec<3, T> quat_rotate_vector(glm::vec<3, T> v, glm::vec<4, T> r) {
+	glm::vec<3, T> rv = quat_xyz(r);
+	return v + T(2) * glm::cross(rv, glm::cross(rv, v) + r.w * v);
+}
+
+// A given angle of rotation about a given axis
+template<typename T>
+inline glm::vec<4, T> quat_from_angle_axis(T angle, glm::vec<3, T> axis) {
+	T sn = std::sin(angle * T(0.5));
+	T cs = std::cos(angle * T(0.5));
+	return glm::vec<4, T>(axis * sn, cs);
+}
+
+template<typename T>
+inline glm::vec<4, T> quat_from_axisAngle(glm::vec<3, T> angleAxis) {
+	T angle = glm::length(angleAxis);
+	if (angle == 0) return quat_identity<T>();
+	return quat_from_angle_axis(angle, angleAxis / angle);
+}
+
+template<typename T>
+inline glm::vec<3, T> quat_to_axisAngle(glm::vec<4, T> quat) {
+	quat = glm::normalize(quat);
+	if (std::abs(quat.w) >= 1) return glm::vec<3, T>(0, 0, 0);
+	return glm::normalize(quat_xyz(quat)) * T(2) * std::acos(quat.w);
+}
+
+template<typename T>
+inline glm::vec<4, T> quat_conj(glm::vec<4, T> q) {
+	return glm::vec<4, T>(-q.x, -q.y, -q.z, q.w);
+}
+
+
+#endif /* quaternion_hpp */
@@ -0,0 +1,170 @@
+#include "quaternionBatch.hpp"
+#include <vector>
+#include <random>
+#include <chrono>
+#include "quaternion.hpp"
+
+
+namespace {
+
+struct QuatInputs {
+	std::vector<glm::vec4> q1, q2;
+	std::vector<glm::vec3> axisAngles, vectors;
+};
+struct QuatOutputs {
+	std::vector<glm::vec4> mul, fromAxisAngle;
+	std::vector<glm::vec3> toAxisAngle, rotated;
+
+	explicit QuatOutputs(size_t count) : mul(count), fromAxisAngle(count), toAxisAngle(count), rotated(count) {}
+};
+
+QuatInputs randomInputs(size_t count) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(-1, 1), angle(0, (float) M_PI);
+	auto randomQuat = [&]() {
+		return glm::normalize(glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng)));
+	};
+	auto randomDir = [&]() {
+		return glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)));
+	};
+
+	QuatInputs inputs;
+	for (size_t i = 0; i < count; ++i) {
+		inputs.q1.push_back(randomQuat());
+		inputs.q2.push_back(randomQuat());
+		inputs.axisAngles.push_back(randomDir() * angle(rng));
+		inputs.vectors.push_back(glm::vec3(unit(rng), unit(rng), unit(rng)));
+	}
+	// The edge cases the GLSL has special handling for
+	if (count >= 2) {
+		inputs.q1[0] = quat_identity<float>();
+		inputs.axisAngles[1] = glm::vec3(0);
+	}
+	return inputs;
+}
+
+// shaders/quaternion.glsl line for line, so the batches are checked against what the GPU runs rather than against another port of it
+namespace glsl {
+
+const glm::vec4 QUATERNION_IDENTITY(0, 0, 0, 1);
+
+glm::vec3 xyz(glm::vec4 q) { return glm::vec3(q.x, q.y, q.z); }
+
+glm::vec4 quat_mul(glm::vec4 q1, glm::vec4 q2) {
+	return glm::vec4(
+		xyz(q2) * q1.w + xyz(q1) * q2.w + glm::cross(xyz(q1), xyz(q2)),
+		q1.w * q2.w - glm::dot(xyz(q1), xyz(q2))
+	);
+}
+
+glm::vec3 quat_rotate_vector(glm::vec3 v, glm::vec4 r) {
+	return v + 2.0f * glm::cross(xyz(r), glm::cross(xyz(r), v) + r.w * v);
+}
+
+glm::vec4 quat_from_angle_axis(float angle, glm::vec3 axis) {
+	float sn = std::sin(angle * 0.5f);
+	float cs = std::cos(angle * 0.5f);
+	return glm::vec4(axis * sn, cs);
+}
+
+glm::vec4 quat_from_axisAngle(glm::vec3 angleAxis) {
+	float angle = glm::length(angleAxis);
+	if (angle == 0) return QUATERNION_IDENTITY;
+	return quat_from_angle_axis(angle, angleAxis / angle);
+}
+
+glm::vec3 quat_to_axisAngle(glm::vec4 quat) {
+	quat = glm::normalize(quat);
+	if (std::abs(quat.w) >= 1) return glm::vec3(0, 0, 0);
+	return glm::normalize(xyz(quat)) * 2.0f * std::acos(quat.w);
+}
+
+}
+
+void runGlsl(const QuatInputs& in, QuatOutputs& out) {
+	for (size_t i = 0; i < in.q1.size(); ++i) {
+		out.mul[i] = glsl::quat_mul(in.q1[i], in.q2[i]);
+		out.toAxisAngle[i] = glsl::quat_to_axisAngle(in.q1[i]);
+		out.fromAxisAngle[i] = glsl::quat_from_axisAngle(in.axisAngles[i]);
+		out.rotated[i] = glsl::quat_rotate_vector(in.vectors[i], in.q1[i]);
+	}
+}
+
+double runScalar(const QuatInputs& in, QuatOutputs& out) {
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < in.q1.size(); ++i) {
+		out.mul[i] = quat_mul(in.q1[i], in.q2[i]);
+		out.toAxisAngle[i] = quat_to_axisAngle(in.q1[i]);
+		out.fromAxisAngle[i] = quat_from_axisAngle(in.axisAngles[i]);
+		out.rotated[i] = quat_rotate_vector(in.vectors[i], in.q1[i]);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / in.q1.size();
+}
+
+template<int W, typename Math>
+double runBatch(const QuatInputs& in, QuatOutputs& out) {
+	QuatBatch<W> q1, q2, quatOut;
+	Vec3Batch<W> axisAngles, vectors, vecOut;
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < in.q1.size(); i += W) {
+		size_t count = std::min((size_t) W, in.q1.size() - i);
+		q1.load(&in.q1[i], count);
+		q2.load(&in.q2[i], count);
+		axisAngles.load(&in.axisAngles[i], count);
+		vectors.load(&in.vectors[i], count);
+
+		quat_mul(q1, q2, quatOut);
+		quatOut.store(&out.mul[i], count);
+		quat_to_axisAngle<W, Math>(q1, vecOut);
+		vecOut.store(&out.toAxisAngle[i], count);
+		quat_from_axisAngle<W, Math>(axisAngles, quatOut);
+		quatOut.store(&out.fromAxisAngle[i], count);
+		quat_rotate_vector(vectors, q1, vecOut);
+		vecOut.store(&out.rotated[i], count);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / in.q1.size();
+}
+
+template<int L>
+float maxError(const std::vector<glm::vec<L, float>>& a, const std::vector<glm::vec<L, float>>& b) {
+	float error = 0;
+	for (size_t i = 0; i < a.size(); ++i) {
+		for (int j = 0; j < L; ++j) {
+			error = std::max(error, std::abs(a[i][j] - b[i][j]));
+		}
+	}
+	return error;
+}
+
+}
+
+
+QuatBatchReport checkQuatBatch(size_t count) {
+	QuatInputs inputs = randomInputs(count);
+	QuatOutputs reference(count), scalar(count), exact(count), fast(count);
+	runGlsl(inputs, reference);
+
+	QuatBatchReport report;
+	report.count = count;
+	report.scalarNs = runScalar(inputs, scalar);
+
+	report.exactNs[0] = runBatch<4, ExactMath>(inputs, exact);
+	report.exactNs[1] = runBatch<8, ExactMath>(inputs, exact);
+	report.exactNs[2] = runBatch<16, ExactMath>(inputs, exact);
+	report.exactMaxError = std::max(
+		std::max(maxError(exact.mul, reference.mul), maxError(exact.toAxisAngle, reference.toAxisAngle)),
+		std::max(maxError(exact.fromAxisAngle, reference.fromAxisAngle), maxError(exact.rotated, reference.rotated)));
+
+	report.fastNs[0] = runBatch<4, FastMath>(inputs, fast);
+	report.fastNs[1] = runBatch<8, FastMath>(inputs, fast);
+	report.fastNs[2] = runBatch<16, FastMath>(inputs, fast);
+	report.fastToAxisAngleError = maxError(fast.toAxisAngle, reference.toAxisAngle);
+	report.fastFromAxisAngleError = maxError(fast.fromAxisAngle, reference.fromAxisAngle);
+	report.fastRotateError = maxError(fast.rotated, reference.rotated);
+
+	report.withinBounds = report.exactMaxError <= EXACT_BATCH_MAX_ERROR && report.fastToAxisAngleError <= FAST_TO_AXIS_ANGLE_MAX_ERROR
+	&& report.fastFromAxisAngleError <= FAST_FROM_AXIS_ANGLE_MAX_ERROR && report.fastRotateError <= EXACT_BATCH_MAX_ERROR;
+
+	return report;
+}
@@ -0,0 +1,203 @@
+#ifndef quaternionBatch_hpp
+#define quaternionBatch_hpp
+
+// The functions from shaders/quaternion.glsl (and quaternion.hpp), working on W quaternions at a time.
+// Batches are structure-of-arrays with fixed W, and every function is a straight loop over the lanes with no branches, so the compiler turns each one into SIMD instructions of whatever width the target has. W is meant to be 4, 8 or 16.
+// sqrt only vectorizes without errno, which is the default for clang on macOS; elsewhere build with -fno-math-errno.
+//
+// The Math parameter picks how acos, sin, cos and 1/sqrt are done:
+// ExactMath uses the standard library, same as the scalar versions.
+// FastMath uses polynomial approximations that vectorize. Their error bounds, for the inputs quaternions produce:
+//   fastAcos: absolute error <= 7e-5 radians on [-1, 1]
+//   fastSin, fastCos: absolute error <= 4e-6 on [-pi, pi], growing by float rounding of the range reduction past that
+//   fastRsqrt: relative error <= 5e-6 (bit trick plus two Newton steps), so normalized vectors have length within 5e-6 of 1
+// Put together, quat_to_axisAngle with FastMath is within 3e-4 radians of the exact version, and quat_from_axisAngle within 1e-5.
+// checkQuatBatch holds them to the bounds below, which leave room for rounding on top of that.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+
+struct ExactMath {
+	static float acos(float x) { return std::acos(x); }
+	static float sin(float x) { return std::sin(x); }
+	static float cos(float x) { return std::cos(x); }
+	static float rsqrt(float x) { return 1 / std::sqrt(x); }
+};
+
+struct FastMath {
+	// Abramowitz and Stegun 4.4.45
+	static float acos(float x) {
+		float ax = std::abs(x);
+		float poly = 1.5707288f + ax * (-0.2121144f + ax * (0.0742610f + ax * -0.0187293f));
+		float result = std::sqrt(1 - ax) * poly;
+		return x < 0 ? (float) M_PI - result : result;
+	}
+	// Reduced to [-pi/2, pi/2], then the Taylor series up to x^9
+	static float sin(float x) {
+		const float pi = (float) M_PI;
+		x -= 2 * pi * std::floor(x * (float) (0.5 / M_PI) + 0.5f);
+		x = x > pi / 2 ? pi - x : x;
+		x = x < -pi / 2 ? -pi - x : x;
+		float x2 = x * x;
+		return x * (1 + x2 * (-1.0f / 6 + x2 * (1.0f / 120 + x2 * (-1.0f / 5040 + x2 * (1.0f / 362880)))));
+	}
+	static float cos(float x) {
+		return sin(x + (float) M_PI_2);
+	}
+	static float rsqrt(float x) {
+		uint32_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		bits = 0x5f375a86 - (bits >> 1);
+		float y;
+		std::memcpy(&y, &bits, sizeof(y));
+		y = y * (1.5f - 0.5f * x * y * y);
+		y = y * (1.5f - 0.5f * x * y * y);
+		return y;
+	}
+};
+
+
+template<int W>
+struct alignas(W * sizeof(float)) Vec3Batch {
+	float x[W], y[W], z[W];
+
+	// Lanes past count are filled with zeros
+	void load(const glm::vec3* aos, size_t count = W) {
+		for (int i = 0; i < W; ++i) {
+			glm::vec3 v = i < (int) count ? aos[i] : glm::vec3(0);
+			x[i] = v.x; y[i] = v.y; z[i] = v.z;
+		}
+	}
+	void store(glm::vec3* aos, size_t count = W) const {
+		for (int i = 0; i < W && i < (int) count; ++i) {
+			aos[i] = glm::vec3(x[i], y[i], z[i]);
+		}
+	}
+};
+
+// xyzw, with the real part in w, same as the GPU
+template<int W>
+struct alignas(W * sizeof(float)) QuatBatch {
+	float x[W], y[W], z[W], w[W];
+
+	// Lanes past count are filled with the identity
+	void load(const glm::vec4* aos, size_t count = W) {
+		for (int i = 0; i < W; ++i) {
+			glm::vec4 q = i < (int) count ? aos[i] : glm::vec4(0, 0, 0, 1);
+			x[i] = q.x; y[i] = q.y; z[i] = q.z; w[i] = q.w;
+		}
+	}
+	void store(glm::vec4* aos, size_t count = W) const {
+		for (int i = 0; i < W && i < (int) count; ++i) {
+			aos[i] = glm::vec4(x[i], y[i], z[i], w[i]);
+		}
+	}
+};
+
+
+// Quaternion multiplication
+template<int W>
+inline void quat_mul(const QuatBatch<W>& q1, const QuatBatch<W>& q2, QuatBatch<W>& out) {
+	for (int i = 0; i < W; ++i) {
+		float x = q2.x[i] * q1.w[i] + q1.x[i] * q2.w[i] + (q1.y[i] * q2.z[i] - q1.z[i] * q2.y[i]);
+		float y = q2.y[i] * q1.w[i] + q1.y[i] * q2.w[i] + (q1.z[i] * q2.x[i] - q1.x[i] * q2.z[i]);
+		float z = q2.z[i] * q1.w[i] + q1.z[i] * q2.w[i] + (q1.x[i] * q2.y[i] - q1.y[i] * q2.x[i]);
+		float w = q1.w[i] * q2.w[i] - (q1.x[i] * q2.x[i] + q1.y[i] * q2.y[i] + q1.z[i] * q2.z[i]);
+		out.x[i] = x; out.y[i] = y; out.z[i] = z; out.w[i] = w;
+	}
+}
+
+// Vector rotation with a quaternion
+template<int W>
+inline void quat_rotate_vector(const Vec3Batch<W>& v, const QuatBatch<W>& r, Vec3Batch<W>& out) {
+	for (int i = 0; i < W; ++i) {
+		// inner = cross(r.xyz, v) + r.w * v
+		float ix = r.y[i] * v.z[i] - r.z[i] * v.y[i] + r.w[i] * v.x[i];
+		float iy = r.z[i] * v.x[i] - r.x[i] * v.z[i] + r.w[i] * v.y[i];
+		float iz = r.x[i] * v.y[i] - r.y[i] * v.x[i] + r.w[i] * v.z[i];
+		float x = v.x[i] + 2 * (r.y[i] * iz - r.z[i] * iy);
+		float y = v.y[i] + 2 * (r.z[i] * ix - r.x[i] * iz);
+		float z = v.z[i] + 2 * (r.x[i] * iy - r.y[i] * ix);
+		out.x[i] = x; out.y[i] = y; out.z[i] = z;
+	}
+}
+
+template<int W, typename Math = ExactMath>
+inline void quat_from_axisAngle(const Vec3Batch<W>& angleAxis, QuatBatch<W>& out) {
+	for (int i = 0; i < W; ++i) {
+		float lengthSquared = angleAxis.x[i] * angleAxis.x[i] + angleAxis.y[i] * angleAxis.y[i] + angleAxis.z[i] * angleAxis.z[i];
+		float invAngle = lengthSquared > 0 ? Math::rsqrt(lengthSquared) : 0;
+		float halfAngle = lengthSquared * invAngle * 0.5f;
+		float sn = Math::sin(halfAngle) * invAngle;
+		float cs = Math::cos(halfAngle);
+		out.x[i] = angleAxis.x[i] * sn;
+		out.y[i] = angleAxis.y[i] * sn;
+		out.z[i] = angleAxis.z[i] * sn;
+		// A zero angle comes out as the identity, same as the early return in the GLSL
+		out.w[i] = lengthSquared > 0 ? cs : 1;
+	}
+}
+
+template<int W, typename Math = ExactMath>
+inline void quat_to_axisAngle(const QuatBatch<W>& quat, Vec3Batch<W>& out) {
+	for (int i = 0; i < W; ++i) {
+		float invLength = Math::rsqrt(quat.x[i] * quat.x[i] + quat.y[i] * quat.y[i] + quat.z[i] * quat.z[i] + quat.w[i] * quat.w[i]);
+		float x = quat.x[i] * invLength, y = quat.y[i] * invLength, z = quat.z[i] * invLength, w = quat.w[i] * invLength;
+		float xyzLengthSquared = x * x + y * y + z * z;
+		bool rotates = std::abs(w) < 1 && xyzLengthSquared > 0;
+		float clampedW = std::min(std::max(w, -1.0f), 1.0f);
+		float scale = rotates ? 2 * Math::acos(clampedW) * Math::rsqrt(xyzLengthSquared) : 0;
+		out.x[i] = x * scale;
+		out.y[i] = y * scale;
+		out.z[i] = z * scale;
+	}
+}
+
+template<int W>
+inline void quat_conj(const QuatBatch<W>& q, QuatBatch<W>& out) {
+	for (int i = 0; i < W; ++i) {
+		out.x[i] = -q.x[i];
+		out.y[i] = -q.y[i];
+		out.z[i] = -q.z[i];
+		out.w[i] = q.w[i];
+	}
+}
+
+template<int W, typename Math = ExactMath>
+inline void quat_normalize(const QuatBatch<W>& q, QuatBatch<W>& out) {
+	for (int i = 0; i < W; ++i) {
+		float invLength = Math::rsqrt(q.x[i] * q.x[i] + q.y[i] * q.y[i] + q.z[i] * q.z[i] + q.w[i] * q.w[i]);
+		out.x[i] = q.x[i] * invLength;
+		out.y[i] = q.y[i] * invLength;
+		out.z[i] = q.z[i] * invLength;
+		out.w[i] = q.w[i] * invLength;
+	}
+}
+
+
+// How far the batches can be from shaders/quaternion.glsl, as the largest absolute difference in any component.
+// Exact differs only by float rounding, mostly quat_to_axisAngle's acos near w = ±1; fast adds the approximations' errors above.
+constexpr float EXACT_BATCH_MAX_ERROR = 2e-5f;
+constexpr float FAST_TO_AXIS_ANGLE_MAX_ERROR = 4e-4f;
+constexpr float FAST_FROM_AXIS_ANGLE_MAX_ERROR = 2e-5f;
+
+// Runs each function over random quaternions in every batch width, against a transcription of quaternion.glsl.
+// Timings are against the scalar versions in quaternion.hpp.
+struct QuatBatchReport {
+	size_t count;
+	// Nanoseconds per quaternion for quat_mul + quat_to_axisAngle + quat_from_axisAngle + quat_rotate_vector
+	double scalarNs, exactNs[3], fastNs[3];
+	// Largest absolute difference from the scalar version, over all inputs and components
+	float exactMaxError, fastToAxisAngleError, fastFromAxisAngleError, fastRotateError;
+	// Whether every error is within the bounds above
+	bool withinBounds;
+};
+QuatBatchReport checkQuatBatch(size_t count);
+
+
+#endif /* quaternionBatch_hpp */
@@ -0,0 +1,381 @@
+#include "replay.hpp"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <climits>
+
+
+namespace {
+
+struct ReplayHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t numCubes;
+	uint64_t occupancyHash;
+	float posQuantum, turnQuantum;
+	uint32_t keyframeInterval;
+	uint32_t padding;
+};
+struct FrameHeader {
+	// Of the coded frame after this header
+	uint32_t size;
+	uint32_t keyframe;
+	uint64_t step;
+};
+// After the index, at the very end. Missing if the recording was cut off.
+struct ReplayFooter {
+	uint64_t indexOffset;
+	uint64_t frameCount;
+	char magic[8];
+};
+constexpr uint32_t REPLAY_VERSION = 1;
+
+// Residuals are coded in blocks of this many, each with its own Rice parameter
+constexpr size_t RICE_BLOCK = 64;
+// Quotients this big or bigger are written out in full instead of in unary
+constexpr unsigned RICE_ESCAPE = 24;
+
+uint64_t zigzag(int64_t value) {
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+int64_t unzigzag(uint64_t value) {
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+class BitWriter {
+	std::vector<uint8_t>& out;
+	uint64_t buffer = 0;
+	int count = 0;
+public:
+	explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+	// Up to 56 bits at a time
+	void write(uint64_t value, int bits) {
+		buffer |= value << count;
+		count += bits;
+		while (count >= 8) {
+			out.push_back(buffer & 0xFF);
+			buffer >>= 8;
+			count -= 8;
+		}
+	}
+	void writeRice(uint64_t value, unsigned k) {
+		uint64_t quotient = value >> k;
+		if (quotient < RICE_ESCAPE) {
+			write(((uint64_t) 1 << quotient) - 1, quotient + 1);
+			write(value & (((uint64_t) 1 << k) - 1), k);
+		}
+		else {
+			write(((uint64_t) 1 << RICE_ESCAPE) - 1, RICE_ESCAPE);
+			write(value & 0xFFFFFFFF, 32);
+			write(value >> 32, 32);
+		}
+	}
+	void flush() {
+		if (count > 0) out.push_back(buffer & 0xFF);
+		buffer = 0;
+		count = 0;
+	}
+};
+
+class BitReader {
+	const uint8_t* next;
+	const uint8_t* end;
+	uint64_t buffer = 0;
+	int count = 0;
+	void refill() {
+		// Past the end reads as zeros, so bad data can't read out of bounds
+		while (count <= 56) {
+			buffer |= (uint64_t) (next < end ? *next++ : 0) << count;
+			count += 8;
+		}
+	}
+public:
+	BitReader(const uint8_t* data, size_t size) : next(data), end(data + size) {}
+	uint64_t read(int bits) {
+		refill();
+		uint64_t value = buffer & (((uint64_t) 1 << bits) - 1);
+		buffer >>= bits;
+		count -= bits;
+		return value;
+	}
+	uint64_t readRice(unsigned k) {
+		refill();
+		unsigned quotient = std::min((unsigned) __builtin_ctzll(~buffer), RICE_ESCAPE);
+		if (quotient < RICE_ESCAPE) {
+			buffer >>= quotient + 1;
+			count -= quotient + 1;
+			return ((uint64_t) quotient << k) | read(k);
+		}
+		buffer >>= RICE_ESCAPE;
+		count -= RICE_ESCAPE;
+		uint64_t low = read(32);
+		return low | (read(32) << 32);
+	}
+};
+
+// Non-finite values, from a blown-up sim, are kept as this and come back as NaN
+constexpr int32_t QUANTIZED_NAN = INT32_MIN;
+
+int32_t quantizeValue(float value, float quantum) {
+	float scaled = std::round(value / quantum);
+	if (!std::isfinite(scaled)) return QUANTIZED_NAN;
+	return (int32_t) std::max(std::min(scaled, 2147483520.0f), -2147483520.0f);
+}
+float dequantizeValue(int32_t value, float quantum) {
+	return value == QUANTIZED_NAN ? NAN : value * quantum;
+}
+
+// The Rice parameter that suits a block with this mean about best
+unsigned riceParameter(uint64_t sum, size_t count) {
+	uint64_t mean = sum / count;
+	unsigned k = 0;
+	while (k < 56 && (mean >> k) > 0) ++k;
+	return k;
+}
+
+}
+
+
+void ReplayCodec::quantize(const glm::vec3* pos, const glm::vec4* turn, int32_t* out) const {
+	for (size_t i = 0; i < numCubes; ++i) {
+		for (int c = 0; c < 3; ++c) out[c * numCubes + i] = quantizeValue(pos[i][c], settings.posQuantum);
+		for (int c = 0; c < 4; ++c) out[(3 + c) * numCubes + i] = quantizeValue(turn[i][c], settings.turnQuantum);
+	}
+}
+
+void ReplayCodec::dequantize(const int32_t* in, glm::vec3* pos, glm::vec4* turn) const {
+	for (size_t i = 0; i < numCubes; ++i) {
+		for (int c = 0; c < 3; ++c) pos[i][c] = dequantizeValue(in[c * numCubes + i], settings.posQuantum);
+		for (int c = 0; c < 4; ++c) turn[i][c] = dequantizeValue(in[(3 + c) * numCubes + i], settings.turnQuantum);
+	}
+}
+
+int64_t ReplayCodec::predict(size_t i, const int32_t* current) const {
+	// Keyframes: like the cube before, which is usually its neighbor. After: where it was, then where it was going.
+	if (history == 0) return i % numCubes == 0 ? 0 : current[i - 1];
+	if (history == 1) return prev1[i];
+	return 2 * (int64_t) prev1[i] - prev2[i];
+}
+
+void ReplayCodec::remember(const int32_t* quantized, bool keyframe) {
+	std::swap(prev1, prev2);
+	prev1.assign(quantized, quantized + CHANNELS * numCubes);
+	history = keyframe ? 1 : history + 1;
+}
+
+void ReplayCodec::encode(const int32_t* quantized, bool keyframe, std::vector<uint8_t>& out) {
+	if (keyframe) history = 0;
+	BitWriter writer(out);
+	uint64_t residuals[RICE_BLOCK];
+	for (int c = 0; c < CHANNELS; ++c)
+	for (size_t start = 0; start < numCubes; start += RICE_BLOCK) {
+		size_t count = std::min(RICE_BLOCK, numCubes - start);
+		uint64_t sum = 0;
+		for (size_t j = 0; j < count; ++j) {
+			size_t i = c * numCubes + start + j;
+			residuals[j] = zigzag(quantized[i] - predict(i, quantized));
+			sum += std::min(residuals[j], (uint64_t) 1 << 40);
+		}
+		unsigned k = riceParameter(sum, count);
+		writer.write(k, 6);
+		for (size_t j = 0; j < count; ++j) writer.writeRice(residuals[j], k);
+	}
+	writer.flush();
+	remember(quantized, keyframe);
+}
+
+void ReplayCodec::decode(const uint8_t* data, size_t size, bool keyframe, int32_t* quantized) {
+	if (keyframe) history = 0;
+	BitReader reader(data, size);
+	for (int c = 0; c < CHANNELS; ++c)
+	for (size_t start = 0; start < numCubes; start += RICE_BLOCK) {
+		size_t count = std::min(RICE_BLOCK, numCubes - start);
+		unsigned k = reader.read(6);
+		for (size_t j = 0; j < count; ++j) {
+			size_t i = c * numCubes + start + j;
+			quantized[i] = (int32_t) (predict(i, quantized) + unzigzag(reader.readRice(k)));
+		}
+	}
+	remember(quantized, keyframe);
+}
+
+
+ReplayRecorder::ReplayRecorder(const std::string& path, size_t numCubes, uint64_t occupancyHash, ReplaySettings settings) :
+numCubes(numCubes), settings(settings), codec(numCubes, settings) {
+	file = fopen(path.c_str(), "wb");
+	if (!file) {
+		perror((std::string("Error creating ") + path).c_str());
+		return;
+	}
+	ReplayHeader header = {};
+	memcpy(header.magic, "BCRP", 4);
+	header.version = REPLAY_VERSION;
+	header.numCubes = numCubes;
+	header.occupancyHash = occupancyHash;
+	header.posQuantum = settings.posQuantum;
+	header.turnQuantum = settings.turnQuantum;
+	header.keyframeInterval = settings.keyframeInterval;
+	failed = fwrite(&header, sizeof(header), 1, file) != 1;
+	offset = sizeof(header);
+	thread = std::thread(&ReplayRecorder::run, this);
+}
+
+ReplayRecorder::~ReplayRecorder() {
+	finish();
+}
+
+void ReplayRecorder::record(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D) {
+	if (!file) return;
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return pending.size() < MAX_PENDING; });
+	PendingFrame frame;
+	if (!spare.empty()) {
+		frame = std::move(spare.back());
+		spare.pop_back();
+	}
+	lock.unlock();
+
+	frame.step = step;
+	frame.pos.resize(numCubes);
+	frame.turn.resize(numCubes);
+	for (size_t i = 0; i < numCubes; ++i) {
+		frame.pos[i] = data3D[i].pos;
+		frame.turn[i] = data4D[i].turn;
+	}
+
+	lock.lock();
+	pending.push_back(std::move(frame));
+	changed.notify_all();
+}
+
+void ReplayRecorder::run() {
+	std::vector<int32_t> quantized(ReplayCodec::CHANNELS * numCubes);
+	std::vector<uint8_t> encoded;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [this] { return !pending.empty() || stopping; });
+		if (pending.empty()) return;
+
+		// Stays at the front while it's written, so finish waits for it
+		PendingFrame& frame = pending.front();
+		lock.unlock();
+		writeFrame(frame, quantized, encoded);
+		lock.lock();
+		spare.push_back(std::move(pending.front()));
+		pending.pop_front();
+		changed.notify_all();
+	}
+}
+
+void ReplayRecorder::writeFrame(PendingFrame& frame, std::vector<int32_t>& quantized, std::vector<uint8_t>& encoded) {
+	bool keyframe = frameCount % settings.keyframeInterval == 0;
+	codec.quantize(frame.pos.data(), frame.turn.data(), quantized.data());
+	encoded.clear();
+	codec.encode(quantized.data(), keyframe, encoded);
+
+	FrameHeader header = { (uint32_t) encoded.size(), keyframe, frame.step };
+	if (fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size()) failed = true;
+	index.push_back(frame.step);
+	index.push_back(offset.load());
+	offset += sizeof(header) + encoded.size();
+	++frameCount;
+}
+
+bool ReplayRecorder::finish() {
+	if (!file) return false;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+		changed.notify_all();
+	}
+	thread.join();
+
+	ReplayFooter footer = { offset.load(), frameCount, { 'B', 'C', 'R', 'P', 'I', 'N', 'D', 'X' } };
+	if (fwrite(index.data(), sizeof(uint64_t), index.size(), file) != index.size() || fwrite(&footer, sizeof(footer), 1, file) != 1) failed = true;
+	if (fclose(file) != 0) failed = true;
+	file = nullptr;
+	if (failed) perror("Error writing replay");
+	return !failed;
+}
+
+uint64_t ReplayRecorder::bytesWritten() const {
+	return offset;
+}
+
+
+bool ReplayReader::open(const std::string& path) {
+	frames.clear();
+	codec.reset();
+	decoded = -1;
+	if (!file.open(path)) return false;
+	const uint8_t* data = file.data();
+	const size_t size = file.size();
+
+	ReplayHeader header;
+	if (size < sizeof(header) || memcmp(data, "BCRP", 4) != 0) {
+		std::cout << path << " is not a replay" << std::endl;
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.version != REPLAY_VERSION || header.keyframeInterval == 0) {
+		std::cout << path << " is from a different version" << std::endl;
+		return false;
+	}
+	// Every cube takes at least a bit in each channel of a frame, so a file can't hold a frame of more cubes than this.
+	// Checked before anything is sized by numCubes, so a bad header can't ask for more memory than the file could use.
+	if (header.numCubes > (size - sizeof(header)) * 8 / ReplayCodec::CHANNELS) {
+		std::cout << path << " is too small to have any frames of " << header.numCubes << " cubes" << std::endl;
+		return false;
+	}
+	settings.posQuantum = header.posQuantum;
+	settings.turnQuantum = header.turnQuantum;
+	settings.keyframeInterval = header.keyframeInterval;
+	codec.reset(new ReplayCodec(header.numCubes, settings));
+	quantized.resize(ReplayCodec::CHANNELS * header.numCubes);
+
+	// Every frame has a header, so the frames can be found by walking them. The index only saves the walk.
+	ReplayFooter footer;
+	bool indexed = false;
+	if (size >= sizeof(header) + sizeof(footer)) {
+		memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+		indexed = memcmp(footer.magic, "BCRPINDX", 8) == 0 && footer.indexOffset + footer.frameCount * 16 + sizeof(footer) == size;
+	}
+	uint64_t end = indexed ? footer.indexOffset : size;
+	for (uint64_t offset = sizeof(header); offset + sizeof(FrameHeader) <= end;) {
+		FrameHeader frameHeader;
+		memcpy(&frameHeader, data + offset, sizeof(frameHeader));
+		if (offset + sizeof(frameHeader) + frameHeader.size > end || (uint64_t) frameHeader.size * 8 < header.numCubes * ReplayCodec::CHANNELS) break;
+		frames.push_back({ frameHeader.step, offset, frameHeader.size });
+		offset += sizeof(frameHeader) + frameHeader.size;
+	}
+	if (!indexed) std::cout << path << " was cut off; " << frames.size() << " frames are readable" << std::endl;
+	return true;
+}
+
+size_t ReplayReader::numCubes() const {
+	return ((const ReplayHeader*) file.data())->numCubes;
+}
+
+uint64_t ReplayReader::occupancyHash() const {
+	return ((const ReplayHeader*) file.data())->occupancyHash;
+}
+
+bool ReplayReader::readFrame(size_t frame, std::vector<glm::vec3>& pos, std::vector<glm::vec4>& turn) {
+	if (frame >= frames.size()) return false;
+	size_t keyframe = frame - frame % settings.keyframeInterval;
+	size_t start = decoded >= (ptrdiff_t) keyframe && decoded < (ptrdiff_t) frame ? decoded + 1 : keyframe;
+	if (decoded == (ptrdiff_t) frame) start = frame + 1;
+
+	for (size_t i = start; i <= frame; ++i) {
+		const uint8_t* frameData = file.data() + frames[i].offset;
+		FrameHeader header;
+		memcpy(&header, frameData, sizeof(header));
+		codec->decode(frameData + sizeof(header), header.size, header.keyframe, quantized.data());
+		decoded = i;
+	}
+	pos.resize(numCubes());
+	turn.resize(numCubes());
+	codec->dequantize(quantized.data(), pos.data(), turn.data());
+	return true;
+}
@@ -0,0 +1,130 @@
+#ifndef replay_hpp
+#define replay_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "physState.hpp"
+#include "mappedFile.hpp"
+
+
+// A recording of where every cube was and how it was turned at each recorded step. Velocities aren't kept.
+// Positions and quaternion components are rounded to multiples of the quanta, so they're off by at most half of one; the error doesn't build up over a recording.
+// Every keyframeInterval frames is a keyframe, which is coded on its own. The frames between are coded as how far each cube is from where it would be if it kept going the way it was.
+struct ReplaySettings {
+	float posQuantum = 1.0f / 1024;
+	float turnQuantum = 1.0f / 8192;
+	uint32_t keyframeInterval = 60;
+};
+
+// Keeps the previous two frames, for predicting the next one. Encoding and decoding go through the same one, so they always agree.
+class ReplayCodec {
+public:
+	static constexpr int CHANNELS = 7;
+
+	ReplayCodec(size_t numCubes, ReplaySettings settings) : numCubes(numCubes), settings(settings) {}
+	void quantize(const glm::vec3* pos, const glm::vec4* turn, int32_t* out) const;
+	void dequantize(const int32_t* in, glm::vec3* pos, glm::vec4* turn) const;
+
+	// quantized has CHANNELS * numCubes values, channel by channel
+	void encode(const int32_t* quantized, bool keyframe, std::vector<uint8_t>& out);
+	void decode(const uint8_t* data, size_t size, bool keyframe, int32_t* quantized);
+
+private:
+	size_t numCubes;
+	ReplaySettings settings;
+	std::vector<int32_t> prev1, prev2;
+	// Frames since the last keyframe, counting it
+	int history = 0;
+
+	int64_t predict(size_t i, const int32_t* current) const;
+	void remember(const int32_t* quantized, bool keyframe);
+};
+
+
+// Codes and writes frames on its own thread. Each frame has its own header, so a recording that was cut off can still be read up to where it stopped.
+class ReplayRecorder {
+public:
+	// Prints why and leaves isOpen false on failure
+	ReplayRecorder(const std::string& path, size_t numCubes, uint64_t occupancyHash, ReplaySettings settings = ReplaySettings());
+	// Finishes if finish wasn't called
+	~ReplayRecorder();
+
+	bool isOpen() const { return file != nullptr; }
+	// Copies the positions and turns and goes back to the caller. Waits if the writer thread is a few frames behind.
+	void record(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D);
+	// Writes everything left and the index. Returns false if anything failed to write.
+	bool finish();
+
+	uint64_t bytesWritten() const;
+
+private:
+	struct PendingFrame {
+		uint64_t step;
+		std::vector<glm::vec3> pos;
+		std::vector<glm::vec4> turn;
+	};
+	static constexpr size_t MAX_PENDING = 4;
+
+	FILE* file = nullptr;
+	size_t numCubes;
+	ReplaySettings settings;
+	ReplayCodec codec;
+	// Step and file offset of each frame written
+	std::vector<uint64_t> index;
+	// Written by the writer thread and read by bytesWritten from any other
+	std::atomic<uint64_t> offset{0};
+	uint64_t frameCount = 0;
+	bool failed = false;
+
+	std::deque<PendingFrame> pending;
+	// Reused by record, so a steady recording doesn't allocate
+	std::vector<PendingFrame> spare;
+	bool stopping = false;
+	mutable std::mutex mutex;
+	std::condition_variable changed;
+	std::thread thread;
+
+	void run();
+	void writeFrame(PendingFrame& frame, std::vector<int32_t>& quantized, std::vector<uint8_t>& encoded);
+};
+
+
+class ReplayReader {
+public:
+	// Prints why and returns false on failure
+	bool open(const std::string& path);
+
+	size_t numFrames() const { return frames.size(); }
+	size_t numCubes() const;
+	uint64_t occupancyHash() const;
+	// The simulation step frame was recorded at
+	uint64_t frameStep(size_t frame) const { return frames[frame].step; }
+
+	// Any frame, in any order. Decodes forward from the keyframe before it, or from the last frame read if that's on the way.
+	bool readFrame(size_t frame, std::vector<glm::vec3>& pos, std::vector<glm::vec4>& turn);
+
+private:
+	struct FrameEntry {
+		uint64_t step, offset;
+		uint32_t size;
+	};
+	MappedFile file;
+	std::vector<FrameEntry> frames;
+	ReplaySettings settings;
+	std::unique_ptr<ReplayCodec> codec;
+	std::vector<int32_t> quantized;
+	// The frame codec last decoded, or -1
+	ptrdiff_t decoded = -1;
+};
+
+
+#endif /* replay_hpp */
@@ -0,0 +1,188 @@
+#include "rewind.hpp"
+#include <cstring>
+#include <algorithm>
+
+
+namespace {
+
+constexpr size_t WORDS_3D = sizeof(PhysData3D) / sizeof(uint32_t);
+constexpr size_t WORDS_4D = sizeof(PhysData4D) / sizeof(uint32_t);
+static_assert(sizeof(PhysData3D) % 4 == 0 && sizeof(PhysData4D) % 4 == 0, "State has to be whole words");
+
+// Each word is predicted to change by as much as it did last frame, reading the float bits as an integer, which for nearby floats of the same sign
+// is how many representable values apart they are. What's left is usually small, so only its low bytes are stored, after a nibble per word giving how many.
+// Exact, since it's all integer math. out needs room for encodedBound(count) bytes; returns how many were used.
+size_t encodedBound(size_t count) {
+	return (count + 1) / 2 + count * 4 + 4;
+}
+
+// How many low bytes of the residual have to be kept, and the residual zigzagged so small negative ones are small too
+inline uint32_t zigzagResidual(uint32_t before, uint32_t previous, uint32_t current, uint32_t& bytes) {
+	uint32_t residual = current - (2 * previous - before);
+	uint32_t zigzagged = (residual << 1) ^ (uint32_t) ((int32_t) residual >> 31);
+	bytes = zigzagged ? (39 - __builtin_clz(zigzagged)) / 8 : 0;
+	return zigzagged;
+}
+
+// Reads current straight out of the caller's arrays, and overwrites before with it as it goes, so the frame is never copied anywhere first.
+// Two words make a nibble byte, so each is written once.
+size_t encodeChanges(uint32_t* before, const uint32_t* previous, const uint32_t* current, size_t count, uint8_t* out) {
+	uint8_t* nibbles = out;
+	uint8_t* data = out + (count + 1) / 2;
+	size_t i = 0;
+	for (; i + 1 < count; i += 2) {
+		uint32_t bytes0, bytes1;
+		uint32_t zigzagged0 = zigzagResidual(before[i], previous[i], current[i], bytes0);
+		uint32_t zigzagged1 = zigzagResidual(before[i + 1], previous[i + 1], current[i + 1], bytes1);
+		before[i] = current[i];
+		before[i + 1] = current[i + 1];
+		// Always writes all 4 and only keeps the ones it needs, which is faster than a branch on each byte
+		memcpy(data, &zigzagged0, 4);
+		data += bytes0;
+		memcpy(data, &zigzagged1, 4);
+		data += bytes1;
+		*nibbles++ = (uint8_t) (bytes0 | bytes1 << 4);
+	}
+	if (i < count) {
+		uint32_t bytes0;
+		uint32_t zigzagged0 = zigzagResidual(before[i], previous[i], current[i], bytes0);
+		before[i] = current[i];
+		memcpy(data, &zigzagged0, 4);
+		data += bytes0;
+		*nibbles = (uint8_t) bytes0;
+	}
+	return data - out;
+}
+
+// Turns before and previous into the frame after them, leaving it in before. Returns how many bytes of in it read.
+size_t applyChanges(const uint8_t* in, size_t count, const uint32_t* previous, uint32_t* before) {
+	const uint8_t* data = in + (count + 1) / 2;
+	for (size_t i = 0; i < count; ++i) {
+		uint32_t bytes = (in[i / 2] >> (i % 2 * 4)) & 0xF;
+		uint32_t zigzagged = 0;
+		for (uint32_t b = 0; b < bytes; ++b) zigzagged |= (uint32_t) *data++ << (b * 8);
+		uint32_t residual = (zigzagged >> 1) ^ -(zigzagged & 1);
+		before[i] = 2 * previous[i] - before[i] + residual;
+	}
+	return data - in;
+}
+
+}
+
+
+RewindBuffer::RewindBuffer(size_t numCubes, size_t maxBytes, unsigned fullInterval) :
+numCubes(numCubes), budget(maxBytes), fullInterval(std::max(fullInterval, 1u)),
+latest(numCubes * (WORDS_3D + WORDS_4D)), previous(latest.size()),
+scratch(encodedBound(numCubes * WORDS_3D) + encodedBound(numCubes * WORDS_4D)) {}
+
+size_t RewindBuffer::Segment::bytes() const {
+	return full.capacity() * sizeof(uint32_t) + changes.capacity() + (steps.capacity() + changeStarts.capacity()) * sizeof(uint64_t);
+}
+
+size_t RewindBuffer::numFrames() const {
+	size_t frames = 0;
+	for (auto& i : segments) frames += i.steps.size();
+	return frames;
+}
+
+void RewindBuffer::gather(const PhysData3D* data3D, const PhysData4D* data4D, uint32_t* words) const {
+	memcpy(words, data3D, numCubes * sizeof(PhysData3D));
+	memcpy(words + numCubes * WORDS_3D, data4D, numCubes * sizeof(PhysData4D));
+}
+
+void RewindBuffer::scatter(const uint32_t* words, PhysData3D* data3D, PhysData4D* data4D) const {
+	memcpy((void*) data3D, words, numCubes * sizeof(PhysData3D));
+	memcpy((void*) data4D, words + numCubes * WORDS_3D, numCubes * sizeof(PhysData4D));
+}
+
+void RewindBuffer::record(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D) {
+	if (segments.empty() || segments.back().steps.size() >= fullInterval) {
+		// The last segment's changes are about how much room this one's will need, so it doesn't have to grow and copy them as it goes
+		size_t expected = 0;
+		if (!segments.empty()) {
+			// Done growing
+			usedBytes -= segments.back().bytes();
+			segments.back().changes.shrink_to_fit();
+			usedBytes += segments.back().bytes();
+			expected = segments.back().changes.size();
+		}
+		segments.emplace_back();
+		Segment& segment = segments.back();
+		segment.changes.reserve(expected);
+		segment.steps.reserve(fullInterval);
+		segment.changeStarts.reserve(fullInterval);
+		segment.full.resize(latest.size());
+		gather(data3D, data4D, segment.full.data());
+		// The first change after a full frame is predicted as no change
+		latest = segment.full;
+		previous = segment.full;
+		segment.steps.push_back(step);
+		segment.changeStarts.push_back(0);
+		usedBytes += segment.bytes();
+	}
+	else {
+		Segment& segment = segments.back();
+		usedBytes -= segment.bytes();
+		// Coded into scratch and appended from there, since growing changes by the bound would zero all of it first.
+		// The 3D and 4D arrays are coded one after the other, as if gathered.
+		const size_t words3D = numCubes * WORDS_3D, words4D = numCubes * WORDS_4D;
+		size_t used3D = encodeChanges(previous.data(), latest.data(), (const uint32_t*) data3D, words3D, scratch.data());
+		size_t used4D = encodeChanges(previous.data() + words3D, latest.data() + words3D, (const uint32_t*) data4D, words4D, scratch.data() + used3D);
+		size_t start = segment.changes.size();
+		segment.changeStarts.push_back(start);
+		segment.changes.insert(segment.changes.end(), scratch.begin(), scratch.begin() + used3D + used4D);
+		segment.steps.push_back(step);
+		// previous now holds this frame, and latest the one before it
+		std::swap(previous, latest);
+		usedBytes += segment.bytes();
+	}
+	trim();
+}
+
+void RewindBuffer::trim() {
+	// The newest segment is never dropped, so there's always something to go back to
+	while (usedBytes > budget && segments.size() > 1) {
+		usedBytes -= segments.front().bytes();
+		segments.pop_front();
+	}
+}
+
+int64_t RewindBuffer::rewind(uint64_t step, PhysData3D* data3D, PhysData4D* data4D) {
+	// The last segment starting at or before step
+	auto segment = std::upper_bound(segments.begin(), segments.end(), step, [](uint64_t step, const Segment& s) {
+		return step < s.steps.front();
+	});
+	if (segment == segments.begin()) return -1;
+	--segment;
+
+	size_t frame = std::upper_bound(segment->steps.begin(), segment->steps.end(), step) - segment->steps.begin() - 1;
+	latest = segment->full;
+	previous = segment->full;
+	for (size_t i = 1; i <= frame; ++i) {
+		// previous holds the frame before latest, and gets overwritten with the one after
+		const uint8_t* changes = segment->changes.data() + segment->changeStarts[i];
+		const size_t words3D = numCubes * WORDS_3D;
+		changes += applyChanges(changes, words3D, latest.data(), previous.data());
+		applyChanges(changes, latest.size() - words3D, latest.data() + words3D, previous.data() + words3D);
+		std::swap(latest, previous);
+	}
+	scatter(latest.data(), data3D, data4D);
+
+	// Everything after is forgotten
+	int64_t found = segment->steps[frame];
+	for (auto later = segment + 1; later != segments.end(); ++later) usedBytes -= later->bytes();
+	segments.erase(segment + 1, segments.end());
+	usedBytes -= segment->bytes();
+	if (frame + 1 < segment->steps.size()) {
+		segment->changes.resize(segment->changeStarts[frame + 1]);
+		segment->changeStarts.resize(frame + 1);
+		segment->steps.resize(frame + 1);
+	}
+	usedBytes += segment->bytes();
+	return found;
+}
+
+void RewindBuffer::clear() {
+	segments.clear();
+	usedBytes = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef rewind_hpp
+#define rewind_hpp
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+#include "physState.hpp"
+
+
+// The last however many frames of full state that fit in a memory budget, for stepping backwards and running again from there.
+// Every fullInterval frames is kept whole; the ones between are kept as exact, compressed changes from the frames before.
+// When the budget is used up, the oldest full frame goes, along with the frames after it.
+class RewindBuffer {
+public:
+	RewindBuffer(size_t numCubes, size_t maxBytes, unsigned fullInterval = 30);
+
+	// Frames have to come in increasing step order
+	void record(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D);
+	// Puts the latest recorded frame at or before step in data3D and data4D (numCubes each), and forgets every frame after it,
+	// since those are about to be simulated again. Returns the step it went back to, or -1 if nothing that old is left.
+	int64_t rewind(uint64_t step, PhysData3D* data3D, PhysData4D* data4D);
+	void clear();
+
+	bool empty() const { return segments.empty(); }
+	uint64_t oldestStep() const { return segments.front().steps.front(); }
+	uint64_t newestStep() const { return segments.back().steps.back(); }
+	size_t numFrames() const;
+	size_t bytesUsed() const { return usedBytes; }
+	size_t maxBytes() const { return budget; }
+
+private:
+	// A full frame and the changes after it
+	struct Segment {
+		std::vector<uint64_t> steps;
+		std::vector<uint32_t> full;
+		// Where each change starts in changes. The first is the full frame, which has none.
+		std::vector<size_t> changeStarts;
+		std::vector<uint8_t> changes;
+		size_t bytes() const;
+	};
+
+	size_t numCubes, budget, usedBytes = 0;
+	unsigned fullInterval;
+	std::deque<Segment> segments;
+	// The last two frames recorded, bit for bit, to predict the next from
+	std::vector<uint32_t> latest, previous;
+	// Where a frame's changes are coded before they're appended
+	std::vector<uint8_t> scratch;
+
+	void gather(const PhysData3D* data3D, const PhysData4D* data4D, uint32_t* words) const;
+	void scatter(const uint32_t* words, PhysData3D* data3D, PhysData4D* data4D) const;
+	void trim();
+};
+
+
+#endif /* rewind_hpp */
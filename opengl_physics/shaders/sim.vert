@@ -9,6 +9,8 @@ layout (location = 3) in vec3 inAngVel;
 
 layout (location = 4) in ivec3 neighborsM;
 layout (location = 5) in ivec3 neighborsP;
+// Index into constraints, or -1
+layout (location = 6) in int constraintIdx;
 
 out vec3 outPos;
 out vec4 outTurn;
@@ -20,6 +22,10 @@ uniform float timeDelta;
 
 uniform samplerBuffer allVerts3D;
 uniform samplerBuffer allVerts4D;
+// Three texels per constraint: target and stiffness, force and damping, impulse and pinned. Same as CubeConstraint.
+uniform samplerBuffer constraints;
+// 1 for the step impulses are applied in, 0 for the rest
+uniform float impulseScale;
 
 
 //const float groundY = 0;
@@ -131,10 +137,24 @@ void main() {
 	outAngVel = dampedInAngVel + (spring(angOffsets) + materialTwistiness * twists) / cubeMass * timeDelta;
 	//outAngVel = vec3(0, 0, 0);
 	
+	bool pinned = false;
+	vec3 pinTarget;
+	if (constraintIdx != -1) {
+		vec4 targetStiffness = texelFetch(constraints, constraintIdx * 3);
+		vec4 forceDamping = texelFetch(constraints, constraintIdx * 3 + 1);
+		vec4 impulsePinned = texelFetch(constraints, constraintIdx * 3 + 2);
+		outVel += ((targetStiffness.xyz - inPos) * targetStiffness.w - inVel * forceDamping.w + forceDamping.xyz) / cubeMass * timeDelta
+			+ impulsePinned.xyz * impulseScale / cubeMass;
+		pinned = impulsePinned.w != 0;
+		pinTarget = targetStiffness.xyz;
+		if (pinned) outVel = vec3(0);
+	}
+	
 	// basic ass collision checking
 	//if (inPos.y < floorY) outVel.y = max(outVel.y, 0);
 	
 	outPos = inPos + outVel * timeDelta;
+	if (pinned) outPos = pinTarget;
 	//outTurn = vec3(0, 0, 0);
 	//outTurn = inTurn + outAngVel * timeDelta;
 	outTurn = quat_mul(quat_from_axisAngle(outAngVel * timeDelta), inTurn);
@@ -0,0 +1,299 @@
+#include "shapes.hpp"
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <thread>
+
+
+void Shape::distanceRow(glm::vec3 start, size_t count, float* out) const {
+	for (size_t i = 0; i < count; ++i) {
+		out[i] = distance(start + glm::vec3(i, 0, 0));
+	}
+}
+
+
+namespace {
+
+// Stands in for the distance outside a child's bounds, where the child can't change the result of a CSG operation
+constexpr float FAR_AWAY = 1e30f;
+
+// The x range of the row through start that can be inside the box, clamped to [0, count). One voxel of slack on each side.
+void boundsSpan(const Shape& shape, glm::vec3 start, size_t count, size_t& begin, size_t& end) {
+	if (start.y < shape.boundsMin.y - 1 || start.y > shape.boundsMax.y + 1
+		|| start.z < shape.boundsMin.z - 1 || start.z > shape.boundsMax.z + 1) {
+		begin = end = 0;
+		return;
+	}
+	float first = std::floor(shape.boundsMin.x - start.x) - 1;
+	float last = std::ceil(shape.boundsMax.x - start.x) + 2;
+	begin = (size_t) std::min(std::max(first, 0.0f), (float) count);
+	end = (size_t) std::min(std::max(last, 0.0f), (float) count);
+	if (end < begin) end = begin;
+}
+
+// Sets bits [begin, end) of a row
+void fillBits(uint64_t* bits, size_t begin, size_t end) {
+	for (size_t word = begin / 64; word * 64 < end; ++word) {
+		size_t first = std::max(begin, word * 64) - word * 64;
+		size_t last = std::min(end, word * 64 + 64) - word * 64;
+		uint64_t mask = last == 64 ? ~uint64_t(0) : (uint64_t(1) << last) - 1;
+		bits[word] |= mask & ~((uint64_t(1) << first) - 1);
+	}
+}
+
+// Voxels evaluated at once near a surface
+constexpr size_t RASTER_BLOCK = 32;
+// Runs shorter than this aren't worth skipping
+constexpr size_t MIN_SKIP = 4;
+
+// The child's distances where they can matter, FAR_AWAY everywhere else
+void childRow(const Shape& child, glm::vec3 start, size_t count, float* out) {
+	size_t begin, end;
+	boundsSpan(child, start, count, begin, end);
+	std::fill(out, out + begin, FAR_AWAY);
+	if (end > begin) child.distanceRow(start + glm::vec3(begin, 0, 0), end - begin, out + begin);
+	std::fill(out + end, out + count, FAR_AWAY);
+}
+
+
+class Sphere : public Shape {
+	glm::vec3 center;
+	float radius;
+public:
+	Sphere(glm::vec3 center, float radius) : Shape(center - radius, center + radius), center(center), radius(radius) {}
+
+	float distance(glm::vec3 p) const override {
+		return glm::length(p - center) - radius;
+	}
+	void distanceRow(glm::vec3 start, size_t count, float* out) const override {
+		float dy = start.y - center.y, dz = start.z - center.z;
+		float dyz2 = dy * dy + dz * dz;
+		float x0 = start.x - center.x;
+		for (size_t i = 0; i < count; ++i) {
+			float dx = x0 + i;
+			out[i] = std::sqrt(dx * dx + dyz2) - radius;
+		}
+	}
+};
+
+class Box : public Shape {
+	glm::vec3 center, halfExtents;
+public:
+	Box(glm::vec3 center, glm::vec3 halfExtents) : Shape(center - halfExtents, center + halfExtents), center(center), halfExtents(halfExtents) {}
+
+	float distance(glm::vec3 p) const override {
+		glm::vec3 q = glm::abs(p - center) - halfExtents;
+		return glm::length(glm::max(q, glm::vec3(0))) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+	}
+	void distanceRow(glm::vec3 start, size_t count, float* out) const override {
+		float qy = std::abs(start.y - center.y) - halfExtents.y;
+		float qz = std::abs(start.z - center.z) - halfExtents.z;
+		float outsideYZ = std::max(qy, 0.0f) * std::max(qy, 0.0f) + std::max(qz, 0.0f) * std::max(qz, 0.0f);
+		float insideYZ = std::max(qy, qz);
+		float x0 = start.x - center.x;
+		for (size_t i = 0; i < count; ++i) {
+			float qx = std::abs(x0 + i) - halfExtents.x;
+			float outside = std::max(qx, 0.0f);
+			out[i] = std::sqrt(outside * outside + outsideYZ) + std::min(std::max(qx, insideYZ), 0.0f);
+		}
+	}
+};
+
+class Capsule : public Shape {
+	glm::vec3 a;
+	float radius;
+	glm::vec3 axis;
+	float invLength2;
+public:
+	Capsule(glm::vec3 a, glm::vec3 b, float radius) :
+	Shape(glm::min(a, b) - radius, glm::max(a, b) + radius), a(a), radius(radius), axis(b - a) {
+		float length2 = glm::dot(axis, axis);
+		invLength2 = length2 > 0 ? 1 / length2 : 0;
+	}
+
+	float distance(glm::vec3 p) const override {
+		glm::vec3 pa = p - a;
+		float h = glm::clamp(glm::dot(pa, axis) * invLength2, 0.0f, 1.0f);
+		return glm::length(pa - axis * h) - radius;
+	}
+	void distanceRow(glm::vec3 start, size_t count, float* out) const override {
+		glm::vec3 pa0 = start - a;
+		for (size_t i = 0; i < count; ++i) {
+			float px = pa0.x + i, py = pa0.y, pz = pa0.z;
+			float h = std::min(std::max((px * axis.x + py * axis.y + pz * axis.z) * invLength2, 0.0f), 1.0f);
+			float dx = px - axis.x * h, dy = py - axis.y * h, dz = pz - axis.z * h;
+			out[i] = std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+		}
+	}
+};
+
+class Torus : public Shape {
+	glm::vec3 center;
+	float majorRadius, minorRadius;
+public:
+	Torus(glm::vec3 center, float majorRadius, float minorRadius) :
+	Shape(center - glm::vec3(majorRadius + minorRadius, minorRadius, majorRadius + minorRadius),
+		  center + glm::vec3(majorRadius + minorRadius, minorRadius, majorRadius + minorRadius)),
+	center(center), majorRadius(majorRadius), minorRadius(minorRadius) {}
+
+	float distance(glm::vec3 p) const override {
+		glm::vec3 d = p - center;
+		float ring = std::sqrt(d.x * d.x + d.z * d.z) - majorRadius;
+		return std::sqrt(ring * ring + d.y * d.y) - minorRadius;
+	}
+	void distanceRow(glm::vec3 start, size_t count, float* out) const override {
+		float dy = start.y - center.y, dz = start.z - center.z;
+		float x0 = start.x - center.x;
+		for (size_t i = 0; i < count; ++i) {
+			float dx = x0 + i;
+			float ring = std::sqrt(dx * dx + dz * dz) - majorRadius;
+			out[i] = std::sqrt(ring * ring + dy * dy) - minorRadius;
+		}
+	}
+};
+
+
+enum class CsgOp { Union, Subtract, Intersect };
+constexpr size_t CSG_CHUNK = 256;
+
+class Csg : public Shape {
+	ShapePtr a, b;
+	CsgOp op;
+
+	static glm::vec3 opBoundsMin(const Shape& a, const Shape& b, CsgOp op) {
+		switch (op) {
+			case CsgOp::Union: return glm::min(a.boundsMin, b.boundsMin);
+			case CsgOp::Subtract: return a.boundsMin;
+			case CsgOp::Intersect: return glm::max(a.boundsMin, b.boundsMin);
+		}
+		return a.boundsMin;
+	}
+	static glm::vec3 opBoundsMax(const Shape& a, const Shape& b, CsgOp op) {
+		switch (op) {
+			case CsgOp::Union: return glm::max(a.boundsMax, b.boundsMax);
+			case CsgOp::Subtract: return a.boundsMax;
+			case CsgOp::Intersect: return glm::min(a.boundsMax, b.boundsMax);
+		}
+		return a.boundsMax;
+	}
+	static float combine(float da, float db, CsgOp op) {
+		switch (op) {
+			case CsgOp::Union: return std::min(da, db);
+			case CsgOp::Subtract: return std::max(da, -db);
+			case CsgOp::Intersect: return std::max(da, db);
+		}
+		return da;
+	}
+
+public:
+	Csg(ShapePtr a, ShapePtr b, CsgOp op) :
+	Shape(opBoundsMin(*a, *b, op), opBoundsMax(*a, *b, op)), a(std::move(a)), b(std::move(b)), op(op) {}
+
+	float distance(glm::vec3 p) const override {
+		return combine(a->distance(p), b->distance(p), op);
+	}
+	void distanceRow(glm::vec3 start, size_t count, float* out) const override {
+		// In chunks, so b's distances fit on the stack
+		float other[CSG_CHUNK];
+		for (size_t chunk = 0; chunk < count; chunk += CSG_CHUNK) {
+			size_t n = std::min(CSG_CHUNK, count - chunk);
+			glm::vec3 chunkStart = start + glm::vec3(chunk, 0, 0);
+			float* chunkOut = out + chunk;
+			childRow(*a, chunkStart, n, chunkOut);
+			childRow(*b, chunkStart, n, other);
+			// Separate loops, so each one is a plain min or max
+			switch (op) {
+				case CsgOp::Union:
+					for (size_t i = 0; i < n; ++i) chunkOut[i] = std::min(chunkOut[i], other[i]);
+					break;
+				case CsgOp::Subtract:
+					for (size_t i = 0; i < n; ++i) chunkOut[i] = std::max(chunkOut[i], -other[i]);
+					break;
+				case CsgOp::Intersect:
+					for (size_t i = 0; i < n; ++i) chunkOut[i] = std::max(chunkOut[i], other[i]);
+					break;
+			}
+		}
+	}
+};
+
+}
+
+
+ShapePtr sphere(glm::vec3 center, float radius) {
+	return std::make_shared<Sphere>(center, radius);
+}
+ShapePtr box(glm::vec3 center, glm::vec3 halfExtents) {
+	return std::make_shared<Box>(center, halfExtents);
+}
+ShapePtr capsule(glm::vec3 a, glm::vec3 b, float radius) {
+	return std::make_shared<Capsule>(a, b, radius);
+}
+ShapePtr torus(glm::vec3 center, float majorRadius, float minorRadius) {
+	return std::make_shared<Torus>(center, majorRadius, minorRadius);
+}
+ShapePtr shapeUnion(ShapePtr a, ShapePtr b) {
+	return std::make_shared<Csg>(std::move(a), std::move(b), CsgOp::Union);
+}
+ShapePtr shapeSubtract(ShapePtr a, ShapePtr b) {
+	return std::make_shared<Csg>(std::move(a), std::move(b), CsgOp::Subtract);
+}
+ShapePtr shapeIntersect(ShapePtr a, ShapePtr b) {
+	return std::make_shared<Csg>(std::move(a), std::move(b), CsgOp::Intersect);
+}
+
+
+void rasterizeRow(const Shape& shape, size_t sizeX, size_t y, size_t z, uint64_t* bits) {
+	std::fill(bits, bits + (sizeX + 63) / 64, 0);
+
+	glm::vec3 start(0.5f, y + 0.5f, z + 0.5f);
+	size_t spanBegin, spanEnd;
+	boundsSpan(shape, start, sizeX, spanBegin, spanEnd);
+
+	float blockDistances[RASTER_BLOCK];
+	size_t x = spanBegin;
+	while (x < spanEnd) {
+		// Every shape's distance changes by at most 1 per voxel, so nothing closer than it can be on the other side of the surface.
+		// Far from the surface, that lets whole runs be filled at once.
+		float d = shape.distance(start + glm::vec3(x, 0, 0));
+		size_t run = (size_t) std::max(std::abs(d) - 0.01f, 0.0f);
+		if (run >= MIN_SKIP) {
+			run = std::min(run, spanEnd - x);
+			if (d <= 0) fillBits(bits, x, x + run);
+			x += run;
+		}
+		// Near it, every voxel gets checked, a block at a time
+		else {
+			size_t count = std::min(RASTER_BLOCK, spanEnd - x);
+			shape.distanceRow(start + glm::vec3(x, 0, 0), count, blockDistances);
+			for (size_t i = 0; i < count; ++i) {
+				bits[(x + i) / 64] |= uint64_t(blockDistances[i] <= 0) << ((x + i) % 64);
+			}
+			x += count;
+		}
+	}
+}
+
+WorkerPool& rasterWorkers() {
+	static WorkerPool workers(std::max(std::thread::hardware_concurrency(), 1u));
+	return workers;
+}
+
+void rasterize(const Shape& shape, OccupancyGrid& grid, WorkerPool& workers) {
+	const size_t sizeY = grid.sizes[1];
+
+	// A row is whole words, so threads never write to the same word
+	workers.parallelFor(sizeY * grid.sizes[2], 16, [&](size_t begin, size_t end, unsigned) {
+		for (size_t r = begin; r < end; ++r) {
+			size_t y = r % sizeY, z = r / sizeY;
+			rasterizeRow(shape, grid.sizes[0], y, z, grid.row(y, z));
+		}
+	});
+}
+
+OccupancyGrid genSphere(float radius) {
+	size_t arrSiz = (size_t) std::ceil(radius * 2);
+	OccupancyGrid sphereGrid({arrSiz, arrSiz, arrSiz});
+	rasterize(*sphere(glm::vec3(radius), radius + 0.1f), sphereGrid);
+	return sphereGrid;
+}
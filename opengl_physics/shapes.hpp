@@ -0,0 +1,55 @@
+#ifndef shapes_hpp
+#define shapes_hpp
+
+#include <memory>
+#include <glm/glm.hpp>
+#include "occupancyGrid.hpp"
+#include "workerPool.hpp"
+
+
+// A solid given by its signed distance: negative inside, positive outside. Coordinates are in voxels.
+class Shape {
+public:
+	virtual ~Shape() = default;
+
+	virtual float distance(glm::vec3 p) const = 0;
+	// Distances at start, start + (1, 0, 0), ... for count points. Primitives override this with a loop that vectorizes.
+	virtual void distanceRow(glm::vec3 start, size_t count, float* out) const;
+
+	// Nothing inside the shape is outside this box
+	glm::vec3 boundsMin, boundsMax;
+
+protected:
+	Shape(glm::vec3 boundsMin, glm::vec3 boundsMax) : boundsMin(boundsMin), boundsMax(boundsMax) {}
+};
+typedef std::shared_ptr<const Shape> ShapePtr;
+
+
+ShapePtr sphere(glm::vec3 center, float radius);
+ShapePtr box(glm::vec3 center, glm::vec3 halfExtents);
+// Every point within radius of the segment from a to b
+ShapePtr capsule(glm::vec3 a, glm::vec3 b, float radius);
+// Lying flat, with the hole along y
+ShapePtr torus(glm::vec3 center, float majorRadius, float minorRadius);
+
+// Only the sign of the combined distance is exact; far from the surface it can be an overestimate
+ShapePtr shapeUnion(ShapePtr a, ShapePtr b);
+// a with b cut out of it
+ShapePtr shapeSubtract(ShapePtr a, ShapePtr b);
+ShapePtr shapeIntersect(ShapePtr a, ShapePtr b);
+
+
+// One thread per core, made the first time it's asked for and kept until exit, so rasterizing doesn't start threads every time
+WorkerPool& rasterWorkers();
+
+// Sets every voxel whose center (coord + 0.5) is inside shape, and clears every other one. Rows are split between workers.
+void rasterize(const Shape& shape, OccupancyGrid& grid, WorkerPool& workers = rasterWorkers());
+
+// Same, for just the row at (y, z) of a grid sizeX wide. For building a grid a piece at a time.
+void rasterizeRow(const Shape& shape, size_t sizeX, size_t y, size_t z, uint64_t* bits);
+
+// The default body: a ball just big enough to fill a grid of 2 * radius
+OccupancyGrid genSphere(float radius);
+
+
+#endif /* shapes_hpp */
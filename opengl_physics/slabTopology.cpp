@@ -0,0 +1,263 @@
+#include "slabTopology.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include "topologyFile.hpp"
+#include "mappedFile.hpp"
+#include "faceOrder.hpp"
+
+
+SlabSource gridSlabs(const OccupancyGrid& grid) {
+	return [&grid](size_t z, uint64_t* slab) {
+		const uint64_t* start = grid.row(0, z);
+		std::copy(start, start + grid.sizes[1] * grid.wordsPerRow, slab);
+	};
+}
+
+SlabSource shapeSlabs(ShapePtr shape, OccupancyGrid::sizesT sizes) {
+	return [shape, sizes](size_t z, uint64_t* slab) {
+		size_t wordsPerRow = (sizes[0] + 63) / 64;
+		for (size_t y = 0; y < sizes[1]; ++y) {
+			rasterizeRow(*shape, sizes[0], y, z, slab + y * wordsPerRow);
+		}
+	};
+}
+
+SlabSource rawVoxelSlabs(const std::string& path, OccupancyGrid::sizesT sizes) {
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+	if (!file->isOpen()) return nullptr;
+	if (file->size() < sizes[0] * sizes[1] * sizes[2]) {
+		std::cout << path << " is smaller than " << sizes[0] << "x" << sizes[1] << "x" << sizes[2] << std::endl;
+		return nullptr;
+	}
+	file->adviseSequential();
+	return [file, sizes](size_t z, uint64_t* slab) {
+		size_t wordsPerRow = (sizes[0] + 63) / 64;
+		const uint8_t* voxel = file->data() + z * sizes[0] * sizes[1];
+		std::fill(slab, slab + sizes[1] * wordsPerRow, 0);
+		for (size_t y = 0; y < sizes[1]; ++y)
+		for (size_t x = 0; x < sizes[0]; ++x, ++voxel) {
+			slab[y * wordsPerRow + x / 64] |= uint64_t(*voxel != 0) << (x % 64);
+		}
+	};
+}
+
+
+namespace {
+
+// Appends to one table of the file, wherever it starts
+class TableWriter {
+	FILE* file;
+	uint64_t offset;
+public:
+	TableWriter(FILE* file, uint64_t offset) : file(file), offset(offset) {}
+	template<typename T>
+	bool write(const std::vector<T>& items) {
+		if (items.empty()) return true;
+		size_t bytes = items.size() * sizeof(T);
+		if (fseek(file, offset, SEEK_SET) != 0 || fwrite(items.data(), 1, bytes, file) != bytes) return false;
+		offset += bytes;
+		return true;
+	}
+};
+
+// Mask of the bits set in row whose neighbor in direction dir is also set
+void hasNeighborRow(const OccupancyGrid& window, size_t y, size_t z, int dir, uint64_t* out) {
+	window.faceMaskRow(y, z, dir, out);
+	const uint64_t* bits = window.row(y, z);
+	for (size_t w = 0; w < window.wordsPerRow; ++w) out[w] = bits[w] & ~out[w];
+}
+
+size_t popcount(const std::vector<uint64_t>& words) {
+	size_t count = 0;
+	for (uint64_t word : words) count += __builtin_popcountll(word);
+	return count;
+}
+
+}
+
+
+bool buildTopologyFile(const SlabSource& source, OccupancyGrid::sizesT sizes, const std::string& path, const ImportProgress& progress, uint64_t occupancyHash) {
+	const size_t sizeX = sizes[0], sizeY = sizes[1], sizeZ = sizes[2];
+
+	// Two slabs of the body: slab k - 1 at z = 0 and slab k at z = 1. Past either end, a slab is empty.
+	// Corner layer k touches exactly these two, and so does every face between them.
+	OccupancyGrid window({ sizeX, sizeY, 2 });
+	const size_t slabWords = sizeY * window.wordsPerRow;
+	auto advance = [&](size_t k) {
+		std::copy(window.row(0, 1), window.row(0, 1) + slabWords, window.row(0, 0));
+		if (k < sizeZ) source(k, window.row(0, 1));
+		else std::fill(window.row(0, 1), window.row(0, 1) + slabWords, 0);
+	};
+	auto report = [&](size_t done) {
+		if (progress) progress((float) done / (2 * (sizeZ + 1)));
+	};
+	std::vector<uint64_t> mask(window.wordsPerRow), corners(window.cornerWordsPerRow());
+
+	// First pass only counts, so every table's place in the file is known before anything is written
+	TopologyHeader header = {};
+	for (int i = 0; i < 3; ++i) header.sizes[i] = sizes[i];
+	header.occupancyHash = occupancyHash;
+	std::fill(window.words.begin(), window.words.end(), 0);
+	for (size_t k = 0; k <= sizeZ; ++k) {
+		advance(k);
+		for (size_t y = 0; y < sizeY; ++y) {
+			for (size_t w = 0; w < window.wordsPerRow; ++w) header.numCubes += __builtin_popcountll(window.row(y, 1)[w]);
+			// Slab k's faces except its +z ones, which aren't known until the next slab, and slab k - 1's +z ones
+			for (int dir : { 0, 1, 2, 3, 4 }) {
+				window.faceMaskRow(y, 1, dir, mask.data());
+				header.numFaces += popcount(mask);
+			}
+			window.faceMaskRow(y, 0, 5, mask.data());
+			header.numFaces += popcount(mask);
+		}
+		for (size_t y = 0; y <= sizeY; ++y) {
+			window.surfaceCornerRow(y, 1, corners.data());
+			header.numVerts += popcount(corners);
+		}
+		report(k);
+	}
+	if (header.numCubes > INT32_MAX || header.numVerts > INT32_MAX) {
+		std::cout << "Too many cubes for 32-bit indices" << std::endl;
+		return false;
+	}
+	layoutTopology(header);
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		perror((std::string("Error creating ") + path).c_str());
+		return false;
+	}
+	const uint8_t zero = 0;
+	bool ok = fseek(file, header.fileSize - 1, SEEK_SET) == 0 && fwrite(&zero, 1, 1, file) == 1
+		&& fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+	TableWriter cubesPosOut(file, header.cubesPosOffset), cubesDataOut(file, header.cubesDataOffset),
+		vertsOut(file, header.vertsNeighborsOffset), faceIndicesOut(file, header.faceIndicesOffset), faceCubesOut(file, header.faceCubesOffset);
+
+	// Index maps for slabs k - 1 and k, and corner index maps for layers k - 1 and k
+	std::vector<int32_t> indexPrev(sizeX * sizeY, -1), indexCur(sizeX * sizeY);
+	std::vector<int32_t> cornerPrev((sizeX + 1) * (sizeY + 1), -1), cornerCur(cornerPrev.size());
+	// Cubes of slab k - 1 are held until slab k has filled in their +z neighbors
+	std::vector<glm::vec3> posPrev, posCur;
+	std::vector<VoxelStorage::CubeData> dataPrev, dataCur;
+	int32_t firstPrev = 0, firstCur = 0;
+	int32_t nextCube = 0, nextVert = 0;
+	size_t facesWritten = 0;
+	std::vector<VoxelStorage::VertNeighbors> verts;
+	std::vector<uint32_t> faceIndices, faceCubes;
+	std::vector<uint64_t> hasBelow[3];
+	for (auto& i : hasBelow) i.resize(window.wordsPerRow);
+
+	std::fill(window.words.begin(), window.words.end(), 0);
+	for (size_t k = 0; k <= sizeZ && ok; ++k) {
+		advance(k);
+
+		// Cubes of slab k, linked to the ones below them, the same as VoxelStorage::setCubes
+		std::fill(indexCur.begin(), indexCur.end(), -1);
+		posCur.clear();
+		dataCur.clear();
+		firstCur = nextCube;
+		for (size_t y = 0; y < sizeY; ++y) {
+			const uint64_t* bits = window.row(y, 1);
+			for (int j = 0; j < 3; ++j) hasNeighborRow(window, y, 1, j, hasBelow[j].data());
+			for (size_t w = 0; w < window.wordsPerRow; ++w)
+			for (uint64_t left = bits[w]; left != 0; left &= left - 1) {
+				int bit = __builtin_ctzll(left);
+				size_t x = w * 64 + bit;
+				int32_t index = nextCube++;
+				posCur.push_back(glm::vec3(x, y, k));
+				dataCur.emplace_back();
+				indexCur[y * sizeX + x] = index;
+
+				if ((hasBelow[0][w] >> bit) & 1) {
+					int32_t neighbor = indexCur[y * sizeX + x - 1];
+					dataCur.back().neighbors[0] = neighbor;
+					dataCur[neighbor - firstCur].neighbors[3] = index;
+				}
+				if ((hasBelow[1][w] >> bit) & 1) {
+					int32_t neighbor = indexCur[(y - 1) * sizeX + x];
+					dataCur.back().neighbors[1] = neighbor;
+					dataCur[neighbor - firstCur].neighbors[4] = index;
+				}
+				if ((hasBelow[2][w] >> bit) & 1) {
+					int32_t neighbor = indexPrev[y * sizeX + x];
+					dataCur.back().neighbors[2] = neighbor;
+					dataPrev[neighbor - firstPrev].neighbors[5] = index;
+				}
+			}
+		}
+
+		// Corner layer k, between slabs k - 1 and k
+		std::fill(cornerCur.begin(), cornerCur.end(), -1);
+		verts.clear();
+		for (size_t y = 0; y <= sizeY; ++y) {
+			window.surfaceCornerRow(y, 1, corners.data());
+			for (size_t w = 0; w < corners.size(); ++w)
+			for (uint64_t left = corners[w]; left != 0; left &= left - 1) {
+				size_t x = w * 64 + __builtin_ctzll(left);
+				VoxelStorage::VertNeighbors vert;
+				for (unsigned int i = 0; i < 8; ++i) {
+					int cubeX = (int) x - !(i & 1);
+					int cubeY = (int) y - !(i & 2);
+					if (cubeX >= 0 && cubeY >= 0 && cubeX < (int) sizeX && cubeY < (int) sizeY) {
+						vert.neighbors[i] = (i & 4 ? indexCur : indexPrev)[cubeY * sizeX + cubeX];
+					}
+				}
+				verts.push_back(vert);
+				cornerCur[y * (sizeX + 1) + x] = nextVert++;
+			}
+		}
+		ok = ok && vertsOut.write(verts);
+
+		// Slab k - 1 is finished now, and both corner layers its faces use are known
+		faceIndices.clear();
+		faceCubes.clear();
+		for (size_t i = 0; i < dataPrev.size(); ++i) {
+			size_t cubePos[3] = { (size_t) posPrev[i].x, (size_t) posPrev[i].y, 0 };
+			auto corner = [&](const size_t* pos) {
+				return (uint32_t) (pos[2] ? cornerCur : cornerPrev)[pos[1] * (sizeX + 1) + pos[0]];
+			};
+			for (int j = 0; j < 6; ++j) {
+				if (dataPrev[i].neighbors[j] == -1) {
+					// z is relative to layer k - 1
+					size_t cornerPos[3] = { cubePos[0], cubePos[1], cubePos[2] };
+					cornerPos[j % 3] += j / 3;
+					faceIndices.push_back(corner(cornerPos));
+					cornerPos[(j + 1) % 3] += 1;
+					faceIndices.push_back(corner(cornerPos));
+					cornerPos[(j + 2) % 3] += 1;
+					faceIndices.push_back(corner(cornerPos));
+					cornerPos[(j + 1) % 3] -= 1;
+					faceIndices.push_back(corner(cornerPos));
+
+					faceCubes.push_back(firstPrev + i);
+				}
+			}
+		}
+		if (REORDER_FACES) reorderFaces(faceIndices.data(), faceCubes.data(), faceCubes.size());
+		facesWritten += faceCubes.size();
+		ok = ok && cubesPosOut.write(posPrev) && cubesDataOut.write(dataPrev)
+			&& faceIndicesOut.write(faceIndices) && faceCubesOut.write(faceCubes);
+
+		std::swap(indexPrev, indexCur);
+		std::swap(cornerPrev, cornerCur);
+		std::swap(posPrev, posCur);
+		std::swap(dataPrev, dataCur);
+		firstPrev = firstCur;
+		report(sizeZ + 1 + k);
+	}
+	if (fclose(file) != 0) ok = false;
+	if (!ok) {
+		perror((std::string("Error writing ") + path).c_str());
+		return false;
+	}
+	// The source gave something different the second time
+	if ((size_t) nextCube != header.numCubes || (size_t) nextVert != header.numVerts || facesWritten != header.numFaces) {
+		std::cout << "Slabs changed while building " << path << std::endl;
+		return false;
+	}
+	if (progress) progress(1);
+	return true;
+}
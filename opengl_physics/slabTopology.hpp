@@ -0,0 +1,26 @@
+#ifndef slabTopology_hpp
+#define slabTopology_hpp
+
+#include <string>
+#include <functional>
+#include "occupancyGrid.hpp"
+#include "shapes.hpp"
+#include "voxelImport.hpp"
+
+
+// Fills in one z slab of a grid: sizes[1] rows of OccupancyGrid::wordsPerRow words, y = 0 first.
+// Gets called for each slab in order, twice over, so it has to give the same slab the same way each time.
+typedef std::function<void(size_t z, uint64_t* slab)> SlabSource;
+
+SlabSource gridSlabs(const OccupancyGrid& grid);
+SlabSource shapeSlabs(ShapePtr shape, OccupancyGrid::sizesT sizes);
+// A raw voxel file, as loadRawVoxels reads it, but a slab at a time. Prints why and returns an empty function on failure.
+SlabSource rawVoxelSlabs(const std::string& path, OccupancyGrid::sizesT sizes);
+
+// Builds the same tables VoxelStorage does, in the same order, faces reordered or not, and writes them to a topology file for MappedTopology.
+// Only two slabs of anything are in memory at once, so the body can be much bigger than memory, as long as it fits on disk.
+// Cube and corner indices are 32-bit, the same as on the GPU. occupancyHash goes in the header as is. Prints why and returns false on failure.
+bool buildTopologyFile(const SlabSource& source, OccupancyGrid::sizesT sizes, const std::string& path, const ImportProgress& progress = nullptr, uint64_t occupancyHash = 0);
+
+
+#endif /* slabTopology_hpp */
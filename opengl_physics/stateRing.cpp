@@ -0,0 +1,91 @@
+#include "stateRing.hpp"
+#include <cstring>
+#include <cstdint>
+
+
+StateRing::StateRing(size_t numCubes) : numCubes(numCubes), persistent(supportsBufferStorage()) {
+	for (Slot& slot : slots) {
+		glGenBuffers(1, &slot.buf3D);
+		glGenBuffers(1, &slot.buf4D);
+#ifdef PERSISTENT_MAPPING_SUPPORTED
+		if (persistent) {
+			// Readable too, since the solver reads each state back in as the next one's input. Client storage asks for it to be in cached memory
+			// so those reads aren't slow.
+			GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBindBuffer(GL_ARRAY_BUFFER, slot.buf3D);
+			glBufferStorage(GL_ARRAY_BUFFER, numCubes * sizeof(PhysData3D), nullptr, flags | GL_CLIENT_STORAGE_BIT);
+			slot.data3D = (PhysData3D*) glMapBufferRange(GL_ARRAY_BUFFER, 0, numCubes * sizeof(PhysData3D), flags);
+			glBindBuffer(GL_ARRAY_BUFFER, slot.buf4D);
+			glBufferStorage(GL_ARRAY_BUFFER, numCubes * sizeof(PhysData4D), nullptr, flags | GL_CLIENT_STORAGE_BIT);
+			slot.data4D = (PhysData4D*) glMapBufferRange(GL_ARRAY_BUFFER, 0, numCubes * sizeof(PhysData4D), flags);
+			continue;
+		}
+#endif
+		slot.copy3D.resize(numCubes);
+		slot.copy4D.resize(numCubes);
+		slot.data3D = slot.copy3D.data();
+		slot.data4D = slot.copy4D.data();
+		glBindBuffer(GL_ARRAY_BUFFER, slot.buf3D);
+		glBufferData(GL_ARRAY_BUFFER, numCubes * sizeof(PhysData3D), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, slot.buf4D);
+		glBufferData(GL_ARRAY_BUFFER, numCubes * sizeof(PhysData4D), nullptr, GL_STREAM_DRAW);
+	}
+}
+
+StateRing::~StateRing() {
+	for (Slot& slot : slots) {
+		if (slot.fence) glDeleteSync(slot.fence);
+		// Deleting a buffer unmaps it
+		glDeleteBuffers(1, &slot.buf3D);
+		glDeleteBuffers(1, &slot.buf4D);
+	}
+}
+
+void StateRing::beginWrite(PhysData3D*& data3D, PhysData4D*& data4D) {
+	Slot& slot = slots[(current + 1) % NUM_SLOTS];
+	if (slot.fence) {
+		if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			++stalls;
+			while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+	}
+	data3D = slot.data3D;
+	data4D = slot.data4D;
+}
+
+void StateRing::endWrite() {
+	current = (current + 1) % NUM_SLOTS;
+	if (persistent) return;
+	// Replaces the buffer's storage, so it doesn't wait on draws still reading the old contents
+	Slot& slot = slots[current];
+	glBindBuffer(GL_ARRAY_BUFFER, slot.buf3D);
+	glBufferData(GL_ARRAY_BUFFER, numCubes * sizeof(PhysData3D), slot.data3D, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, slot.buf4D);
+	glBufferData(GL_ARRAY_BUFFER, numCubes * sizeof(PhysData4D), slot.data4D, GL_STREAM_DRAW);
+}
+
+void StateRing::fenceCurrent() {
+	// Without persistent mapping, nothing the GPU reads is ever written over
+	if (!persistent) return;
+	Slot& slot = slots[current];
+	if (slot.fence) glDeleteSync(slot.fence);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool supportsBufferStorage() {
+#ifdef PERSISTENT_MAPPING_SUPPORTED
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4)) return true;
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; ++i) {
+		const char* name = (const char*) glGetStringi(GL_EXTENSIONS, i);
+		if (name && strcmp(name, "GL_ARB_buffer_storage") == 0) return true;
+	}
+#endif
+	return false;
+}
@@ -0,0 +1,65 @@
+#ifndef stateRing_hpp
+#define stateRing_hpp
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+#include "physState.hpp"
+
+// Persistent mapping needs ARB_buffer_storage, which macOS's GL 4.1 doesn't have
+#if defined(GL_MAP_PERSISTENT_BIT) && !defined(__APPLE__)
+#define PERSISTENT_MAPPING_SUPPORTED
+#endif
+
+
+// Gets state the CPU solver works out into the GL buffers the renderer draws from, without waiting on the GPU or copying it on the way.
+// Each of the three slots is fenced after the frames that draw it, so the one being written was last drawn a couple of frames ago and is
+// almost always free. With buffer storage, the slots stay mapped and the solver writes straight into them. Without it, each slot has a copy in
+// ordinary memory that goes up with glBufferData once it's written.
+class StateRing {
+public:
+	static constexpr unsigned NUM_SLOTS = 3;
+
+	explicit StateRing(size_t numCubes);
+	~StateRing();
+	StateRing(const StateRing&) = delete;
+	StateRing& operator=(const StateRing&) = delete;
+
+	bool isPersistent() const { return persistent; }
+
+	// Where to put the next whole state. Waits for the GPU to be done with that slot first.
+	void beginWrite(PhysData3D*& data3D, PhysData4D*& data4D);
+	// Makes what was written the current state
+	void endWrite();
+
+	// The current state, for reading on the CPU, including as the solver's input
+	const PhysData3D* current3D() const { return slots[current].data3D; }
+	const PhysData4D* current4D() const { return slots[current].data4D; }
+	GLuint currentBuf3D() const { return slots[current].buf3D; }
+	GLuint currentBuf4D() const { return slots[current].buf4D; }
+	// Called once the draws that read the current state have been issued
+	void fenceCurrent();
+
+	// Times beginWrite had to wait on the GPU
+	size_t stalls = 0;
+
+private:
+	struct Slot {
+		GLuint buf3D, buf4D;
+		PhysData3D* data3D;
+		PhysData4D* data4D;
+		GLsync fence = nullptr;
+		// Only without persistent mapping
+		std::vector<PhysData3D> copy3D;
+		std::vector<PhysData4D> copy4D;
+	} slots[NUM_SLOTS];
+	size_t numCubes;
+	unsigned current = 0;
+	bool persistent;
+};
+
+// GL 4.4, or ARB_buffer_storage, and built with a loader that has it
+bool supportsBufferStorage();
+
+
+#endif /* stateRing_hpp */
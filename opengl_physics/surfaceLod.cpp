@@ -0,0 +1,95 @@
+#include "surfaceLod.hpp"
+#include <cmath>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "occupancyGrid.hpp"
+#include "physState.hpp"
+
+
+namespace {
+
+uint64_t positionKey(glm::ivec3 p) {
+	return (uint64_t(uint32_t(p.x) & 0x1fffff) << 42) | (uint64_t(uint32_t(p.y) & 0x1fffff) << 21) | (uint32_t(p.z) & 0x1fffff);
+}
+
+// The cubes with a corner at point, which is on the lattice of the full body's vertices
+bool vertexAt(glm::vec3 point, const std::unordered_map<uint64_t, uint32_t>& cubeAt, VoxelStorage::VertNeighbors& vert) {
+	bool any = false;
+	for (int k = 0; k < 8; ++k) {
+		auto found = cubeAt.find(positionKey(glm::ivec3(glm::round(point - cornerDirection(k)))));
+		vert.neighbors[k] = found != cubeAt.end() ? found->second : -1;
+		any |= found != cubeAt.end();
+	}
+	return any;
+}
+
+}
+
+
+SurfaceLod buildSurfaceLod(const TopologyView& topology, unsigned blockSize, const BrickLayout& bricks) {
+	SurfaceLod lod;
+	lod.blockSize = blockSize;
+	
+	OccupancyGrid::sizesT coarseSizes;
+	for (int i = 0; i < 3; ++i) coarseSizes[i] = (topology.sizes[i] + blockSize - 1) / blockSize;
+	std::vector<uint16_t> counts(coarseSizes[0] * coarseSizes[1] * coarseSizes[2]);
+	// A cube in each cell, for which brick its faces go with
+	std::vector<uint32_t> cellCubes(counts.size());
+	std::unordered_map<uint64_t, uint32_t> cubeAt(topology.numCubes);
+	for (size_t i = 0; i < topology.numCubes; ++i) {
+		glm::ivec3 pos(glm::round(topology.cubesPos[i]));
+		cubeAt[positionKey(pos)] = i;
+		glm::ivec3 cell = pos / int(blockSize);
+		size_t idx = (cell.z * coarseSizes[1] + cell.y) * coarseSizes[0] + cell.x;
+		++counts[idx];
+		cellCubes[idx] = i;
+	}
+	OccupancyGrid coarse(coarseSizes);
+	for (size_t z = 0; z < coarseSizes[2]; ++z) {
+		for (size_t y = 0; y < coarseSizes[1]; ++y) {
+			for (size_t x = 0; x < coarseSizes[0]; ++x) {
+				coarse.set(x, y, z, counts[(z * coarseSizes[1] + y) * coarseSizes[0] + x] * 2 >= blockSize * blockSize * blockSize);
+			}
+		}
+	}
+	VoxelStorage coarseVoxels(std::move(coarse));
+	
+	// Corners where the full body has no cube move in toward the middle of their cell until they reach one
+	std::vector<uint8_t> usable(coarseVoxels.vertsNeighbors.size());
+	lod.vertsNeighbors.resize(coarseVoxels.vertsNeighbors.size());
+	float center = (blockSize - 1) * 0.5f;
+	for (size_t v = 0; v < coarseVoxels.vertsNeighbors.size(); ++v) {
+		for (int k = 0; k < 8 && !usable[v]; ++k) {
+			int32_t cell = coarseVoxels.vertsNeighbors[v].neighbors[k];
+			if (cell < 0) continue;
+			glm::vec3 corner = coarseVoxels.cubesPos[cell] * float(blockSize) + glm::vec3(center) + cornerDirection(k) * float(blockSize);
+			glm::vec3 inward = cornerDirection(k) * -2.0f;
+			for (unsigned step = 0; step <= blockSize / 2 && !usable[v]; ++step) {
+				usable[v] = vertexAt(corner + inward * float(step), cubeAt, lod.vertsNeighbors[v]);
+			}
+		}
+	}
+	
+	// Counting sort of the faces by brick
+	size_t numBricks = bricks.numBricks();
+	lod.brickFaceStarts.assign(numBricks + 1, 0);
+	std::vector<uint32_t> faceBricks;
+	std::vector<uint32_t> faces;
+	for (size_t f = 0; f < coarseVoxels.faceCubes.size(); ++f) {
+		const uint32_t* quad = &coarseVoxels.faceIndices[f * 4];
+		if (!usable[quad[0]] || !usable[quad[1]] || !usable[quad[2]] || !usable[quad[3]]) continue;
+		glm::ivec3 cell(glm::round(coarseVoxels.cubesPos[coarseVoxels.faceCubes[f]]));
+		uint32_t brick = bricks.brickOf(cellCubes[(cell.z * coarseSizes[1] + cell.y) * coarseSizes[0] + cell.x]);
+		faces.push_back(f);
+		faceBricks.push_back(brick);
+		++lod.brickFaceStarts[brick + 1];
+	}
+	for (size_t b = 0; b < numBricks; ++b) lod.brickFaceStarts[b + 1] += lod.brickFaceStarts[b];
+	lod.faceIndices.resize(faces.size() * 4);
+	std::vector<uint32_t> filled(lod.brickFaceStarts.begin(), lod.brickFaceStarts.end() - 1);
+	for (size_t i = 0; i < faces.size(); ++i) {
+		uint32_t to = filled[faceBricks[i]]++;
+		std::copy(&coarseVoxels.faceIndices[faces[i] * 4], &coarseVoxels.faceIndices[faces[i] * 4] + 4, &lod.faceIndices[to * 4]);
+	}
+	return lod;
+}
@@ -0,0 +1,31 @@
+#ifndef surfaceLod_hpp
+#define surfaceLod_hpp
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "voxelStorage.hpp"
+#include "bounds.hpp"
+
+
+// A coarser surface for drawing bodies from far away: the surface of a grid whose cells are blockSize voxels wide, each filled if at least half its
+// voxels are. Its corners are on the coarse lattice, and each is made from the full body's cubes around that point, so it moves with the body
+// the way the full surface does and is drawn by the same shaders.
+struct SurfaceLod {
+	unsigned blockSize;
+	// Like TopologyView's, and indexed the same way by the full body's cubes
+	std::vector<VoxelStorage::VertNeighbors> vertsNeighbors;
+	// 4 per face, into vertsNeighbors
+	std::vector<uint32_t> faceIndices;
+	// Where each of the layout's bricks' faces start, plus one past the last. A face goes with the brick of a cube in the cell it's on.
+	std::vector<uint32_t> brickFaceStarts;
+
+	size_t numVerts() const { return vertsNeighbors.size(); }
+	size_t numFaces() const { return faceIndices.size() / 4; }
+};
+
+// Bodies packed together have to be at least 2 * blockSize apart, or their cells can end up next to each other
+SurfaceLod buildSurfaceLod(const TopologyView& topology, unsigned blockSize, const BrickLayout& bricks);
+
+
+#endif /* surfaceLod_hpp */
@@ -0,0 +1,161 @@
+#include "surfacePicker.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+// Möller-Trumbore. Returns the distance along dir, or infinity for a miss.
+float rayTriangle(glm::vec3 origin, glm::vec3 dir, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+	glm::vec3 ab = b - a, ac = c - a;
+	glm::vec3 p = glm::cross(dir, ac);
+	float det = glm::dot(ab, p);
+	if (std::abs(det) < 1e-12f) return INFINITY;
+	float inv = 1 / det;
+	glm::vec3 toOrigin = origin - a;
+	float u = glm::dot(toOrigin, p) * inv;
+	if (u < 0 || u > 1) return INFINITY;
+	glm::vec3 q = glm::cross(toOrigin, ab);
+	float v = glm::dot(dir, q) * inv;
+	if (v < 0 || u + v > 1) return INFINITY;
+	float t = glm::dot(ac, q) * inv;
+	return t >= 0 ? t : INFINITY;
+}
+
+// Distance along the ray to where it enters the box, or infinity if it doesn't
+float rayBox(glm::vec3 origin, glm::vec3 invDir, glm::vec3 min, glm::vec3 max, float closest) {
+	float enter = 0, exit = closest;
+	for (int i = 0; i < 3; ++i) {
+		// A ray parallel to the slabs is between them all along or not at all. Working it out would be 0 * inf, NaN, with the origin on one.
+		if (std::isinf(invDir[i])) {
+			if (origin[i] < min[i] || origin[i] > max[i]) return INFINITY;
+			continue;
+		}
+		float t0 = (min[i] - origin[i]) * invDir[i], t1 = (max[i] - origin[i]) * invDir[i];
+		enter = std::max(enter, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+	return enter <= exit ? enter : INFINITY;
+}
+
+}
+
+
+SurfacePicker::SurfacePicker(const TopologyView& topology) :
+faceIndices(topology.faceIndices), numFaces(topology.numFaces), cubeFaceStarts(topology.numCubes + 1, 0), cubeFaces(topology.numFaces) {
+	// Counting sort of faces by cube
+	for (size_t f = 0; f < numFaces; ++f) ++cubeFaceStarts[topology.faceCubes[f] + 1];
+	for (size_t c = 0; c < topology.numCubes; ++c) cubeFaceStarts[c + 1] += cubeFaceStarts[c];
+	std::vector<uint32_t> filled(cubeFaceStarts.begin(), cubeFaceStarts.end() - 1);
+	for (size_t f = 0; f < numFaces; ++f) cubeFaces[filled[topology.faceCubes[f]]++] = f;
+}
+
+void SurfacePicker::refit(const std::vector<glm::vec3>& vertPositions) {
+	positions = vertPositions.data();
+	if (numFaces == 0) return;
+
+	if (nodes.empty()) {
+		std::vector<glm::vec3> centers(numFaces);
+		leafFaces.resize(numFaces);
+		for (uint32_t f = 0; f < numFaces; ++f) {
+			const uint32_t* quad = faceIndices + f * 4;
+			centers[f] = (positions[quad[0]] + positions[quad[1]] + positions[quad[2]] + positions[quad[3]]) * 0.25f;
+			leafFaces[f] = f;
+		}
+		nodes.reserve(numFaces / LEAF_SIZE * 2 + 1);
+		build(0, numFaces, centers);
+		leafQuads.resize(numFaces * 4);
+		for (size_t i = 0; i < numFaces; ++i) std::copy(faceIndices + leafFaces[i] * 4, faceIndices + leafFaces[i] * 4 + 4, leafQuads.begin() + i * 4);
+	}
+
+	// Children come after their parents, so going backwards does every child first
+	for (size_t n = nodes.size(); n-- > 0;) {
+		Node& node = nodes[n];
+		if (node.count) {
+			glm::vec3 min(INFINITY), max(-INFINITY);
+			for (size_t i = node.rightOrFirst * 4; i < (node.rightOrFirst + node.count) * 4; ++i) {
+				min = glm::min(min, positions[leafQuads[i]]);
+				max = glm::max(max, positions[leafQuads[i]]);
+			}
+			node.min = min;
+			node.max = max;
+		}
+		else {
+			const Node& left = nodes[n + 1];
+			const Node& right = nodes[node.rightOrFirst];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+}
+
+// Splits at the median along whichever axis the centers are most spread out on
+void SurfacePicker::build(uint32_t first, uint32_t count, const std::vector<glm::vec3>& centers) {
+	size_t index = nodes.size();
+	nodes.push_back(Node());
+	if (count <= LEAF_SIZE) {
+		nodes[index].rightOrFirst = first;
+		nodes[index].count = count;
+		return;
+	}
+
+	glm::vec3 min(INFINITY), max(-INFINITY);
+	for (uint32_t i = first; i < first + count; ++i) {
+		min = glm::min(min, centers[leafFaces[i]]);
+		max = glm::max(max, centers[leafFaces[i]]);
+	}
+	glm::vec3 extent = max - min;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	uint32_t half = count / 2;
+	std::nth_element(leafFaces.begin() + first, leafFaces.begin() + first + half, leafFaces.begin() + first + count, [&](uint32_t a, uint32_t b) {
+		return centers[a][axis] < centers[b][axis];
+	});
+
+	build(first, half, centers);
+	nodes[index].rightOrFirst = nodes.size();
+	nodes[index].count = 0;
+	build(first + half, count - half, centers);
+}
+
+bool SurfacePicker::raycast(glm::vec3 origin, glm::vec3 dir, Hit& hit) const {
+	if (nodes.empty() || !positions) return false;
+	glm::vec3 invDir = 1.0f / dir;
+	float closest = INFINITY;
+	uint32_t closestFace = 0;
+
+	// Deep enough for any tree over 2^32 faces, since the splits are even
+	uint32_t stack[64];
+	int depth = 0;
+	if (rayBox(origin, invDir, nodes[0].min, nodes[0].max, closest) == INFINITY) return false;
+	stack[depth++] = 0;
+	while (depth > 0) {
+		const Node& node = nodes[stack[--depth]];
+		if (node.count) {
+			for (uint32_t i = node.rightOrFirst; i < node.rightOrFirst + node.count; ++i) {
+				const uint32_t* quad = leafQuads.data() + i * 4;
+				glm::vec3 a = positions[quad[0]], b = positions[quad[1]], c = positions[quad[2]], d = positions[quad[3]];
+				float t = std::min(rayTriangle(origin, dir, a, b, c), rayTriangle(origin, dir, a, c, d));
+				if (t < closest) {
+					closest = t;
+					closestFace = leafFaces[i];
+				}
+			}
+			continue;
+		}
+		// The nearer child goes on top, so it's searched first and can rule out the other
+		uint32_t leftIndex = &node - nodes.data() + 1, rightIndex = node.rightOrFirst;
+		float leftT = rayBox(origin, invDir, nodes[leftIndex].min, nodes[leftIndex].max, closest);
+		float rightT = rayBox(origin, invDir, nodes[rightIndex].min, nodes[rightIndex].max, closest);
+		if (leftT > rightT) {
+			std::swap(leftT, rightT);
+			std::swap(leftIndex, rightIndex);
+		}
+		if (rightT != INFINITY) stack[depth++] = rightIndex;
+		if (leftT != INFINITY) stack[depth++] = leftIndex;
+	}
+	if (closest == INFINITY) return false;
+	hit.face = closestFace;
+	hit.distance = closest;
+	hit.point = origin + dir * closest;
+	return true;
+}
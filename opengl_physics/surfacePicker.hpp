@@ -0,0 +1,61 @@
+#ifndef surfacePicker_hpp
+#define surfacePicker_hpp
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "voxelStorage.hpp"
+
+
+// Finds which face of the deformed surface a ray hits first, on the CPU, with a bounding volume hierarchy over the faces.
+// The tree's shape is picked once, from the first positions it's given. After that only its boxes move, which is much cheaper than rebuilding and
+// fine for a body that bends but keeps its faces next to the same neighbors.
+class SurfacePicker {
+public:
+	struct Hit {
+		uint32_t face;
+		// In lengths of the ray's direction
+		float distance;
+		glm::vec3 point;
+	};
+
+	// Reads the topology in place, so whatever it points into has to outlive this
+	explicit SurfacePicker(const TopologyView& topology);
+
+	// vertPositions is one per surface vertex, like SurfaceSkin::vertPositions. raycast reads it in place, so it has to stay where it is.
+	void refit(const std::vector<glm::vec3>& vertPositions);
+	// Quads are hit from either side. False if the ray misses, or refit hasn't been called.
+	bool raycast(glm::vec3 origin, glm::vec3 dir, Hit& hit) const;
+
+	// Every face of cube. Once faces are reordered for the vertex cache, a cube's are anywhere among its brick's.
+	const uint32_t* cubeFacesBegin(size_t cube) const { return cubeFaces.data() + cubeFaceStarts[cube]; }
+	const uint32_t* cubeFacesEnd(size_t cube) const { return cubeFaces.data() + cubeFaceStarts[cube + 1]; }
+
+private:
+	// Preorder, so a node's children come after it: the left one right after, the right one at right
+	struct Node {
+		glm::vec3 min;
+		// The right child, or for a leaf, where its faces start in leafFaces
+		uint32_t rightOrFirst;
+		glm::vec3 max;
+		// 0 for an inner node
+		uint32_t count;
+	};
+	static constexpr uint32_t LEAF_SIZE = 4;
+
+	const uint32_t* faceIndices;
+	size_t numFaces;
+	std::vector<Node> nodes;
+	// Faces in the order the leaves have them
+	std::vector<uint32_t> leafFaces;
+	// Copy of the faces' vertex indices in leafFaces order, so a leaf's are together
+	std::vector<uint32_t> leafQuads;
+	const glm::vec3* positions = nullptr;
+
+	std::vector<uint32_t> cubeFaceStarts, cubeFaces;
+
+	void build(uint32_t first, uint32_t count, const std::vector<glm::vec3>& centers);
+};
+
+
+#endif /* surfacePicker_hpp */
@@ -0,0 +1,125 @@
+#include "surfaceSkin.hpp"
+#include <cstring>
+#include <cmath>
+#include "quaternion.hpp"
+
+
+namespace {
+
+constexpr size_t SKIN_GRAIN = 256;
+
+// Missing neighbors are skipped, like in stretchyVoxels.vert, rather than read and weighted by 0, since a cube far enough gone would make that NaN
+void skinVertex(const VoxelStorage::VertNeighbors& vert, const PhysData3D* data3D, const PhysData4D* data4D, glm::vec3& pos, float& strain) {
+	glm::vec3 corners[8];
+	int numCorners = 0;
+	glm::vec3 total(0);
+	for (int k = 0; k < 8; ++k) {
+		int32_t idx = vert.neighbors[k];
+		if (idx < 0) continue;
+		corners[numCorners] = data3D[idx].pos + quat_rotate_vector(cornerDirection(k), data4D[idx].turn);
+		total += corners[numCorners++];
+	}
+	pos = total / (float) numCorners;
+	float spread = 0;
+	for (int k = 0; k < numCorners; ++k) {
+		glm::vec3 off = corners[k] - pos;
+		spread += glm::dot(off, off);
+	}
+	strain = std::sqrt(spread / numCorners);
+}
+
+glm::vec3 quadAreaNormal(const glm::vec3* positions, const uint32_t* quad) {
+	// The cross product of the diagonals is twice the area, even when the quad isn't flat
+	return glm::cross(positions[quad[2]] - positions[quad[0]], positions[quad[3]] - positions[quad[1]]);
+}
+
+}
+
+
+SurfaceSkin::SurfaceSkin(const TopologyView& topology, unsigned threads) :
+vertsNeighbors(topology.vertsNeighbors), faceIndices(topology.faceIndices), numCubes(topology.numCubes), numFaces(topology.numFaces), workers(threads),
+positions(topology.numVerts), normals(topology.numVerts), faceAreaNormals(topology.numFaces), strain(topology.numVerts),
+vertFaceStarts(topology.numVerts + 1, 0), faceFlipped(topology.numFaces),
+lastPos(topology.numCubes), lastTurn(topology.numCubes), cubeDirty(topology.numCubes), vertDirty(topology.numVerts), faceDirty(topology.numFaces) {
+
+	// Counting sort of faces by vertex
+	for (size_t i = 0; i < numFaces * 4; ++i) ++vertFaceStarts[faceIndices[i] + 1];
+	for (size_t v = 0; v < numVerts(); ++v) vertFaceStarts[v + 1] += vertFaceStarts[v];
+	vertFaces.resize(numFaces * 4);
+	std::vector<uint32_t> filled(vertFaceStarts.begin(), vertFaceStarts.end() - 1);
+	for (size_t i = 0; i < numFaces * 4; ++i) vertFaces[filled[faceIndices[i]]++] = i / 4;
+
+	// At rest every neighbor agrees on where a vertex is, so any one of them will do
+	std::vector<glm::vec3> restPositions(numVerts());
+	for (size_t v = 0; v < numVerts(); ++v) {
+		for (int k = 0; k < 8; ++k) {
+			int32_t idx = vertsNeighbors[v].neighbors[k];
+			if (idx >= 0) {
+				restPositions[v] = topology.cubesPos[idx] + cornerDirection(k);
+				break;
+			}
+		}
+	}
+	for (size_t f = 0; f < numFaces; ++f) {
+		const uint32_t* quad = faceIndices + f * 4;
+		glm::vec3 center = (restPositions[quad[0]] + restPositions[quad[1]] + restPositions[quad[2]] + restPositions[quad[3]]) * 0.25f;
+		faceFlipped[f] = glm::dot(quadAreaNormal(restPositions.data(), quad), center - topology.cubesPos[topology.faceCubes[f]]) < 0;
+	}
+}
+
+size_t SurfaceSkin::update(const PhysData3D* data3D, const PhysData4D* data4D) {
+	const bool all = first;
+	first = false;
+
+	// Which cubes moved. Compared bit for bit, so a cube only counts as still once the solver leaves it exactly where it was.
+	workers.parallelFor(numCubes, SKIN_GRAIN, [&](size_t begin, size_t end, unsigned) {
+		for (size_t i = begin; i < end; ++i) {
+			bool moved = all || memcmp(&lastPos[i], &data3D[i].pos, sizeof(glm::vec3)) != 0 || memcmp(&lastTurn[i], &data4D[i].turn, sizeof(glm::vec4)) != 0;
+			cubeDirty[i] = moved;
+			lastPos[i] = data3D[i].pos;
+			lastTurn[i] = data4D[i].turn;
+		}
+	});
+
+	std::vector<size_t> recomputed(workers.size(), 0);
+	workers.parallelFor(numVerts(), SKIN_GRAIN, [&](size_t begin, size_t end, unsigned worker) {
+		size_t count = 0;
+		for (size_t v = begin; v < end; ++v) {
+			uint8_t dirty = 0;
+			for (int32_t idx : vertsNeighbors[v].neighbors) dirty |= idx >= 0 && cubeDirty[idx];
+			vertDirty[v] = dirty;
+			if (!dirty) continue;
+			skinVertex(vertsNeighbors[v], data3D, data4D, positions[v], strain[v]);
+			++count;
+		}
+		recomputed[worker] = count;
+	});
+
+	workers.parallelFor(numFaces, SKIN_GRAIN, [&](size_t begin, size_t end, unsigned) {
+		for (size_t f = begin; f < end; ++f) {
+			const uint32_t* quad = faceIndices + f * 4;
+			uint8_t dirty = vertDirty[quad[0]] | vertDirty[quad[1]] | vertDirty[quad[2]] | vertDirty[quad[3]];
+			faceDirty[f] = dirty;
+			if (!dirty) continue;
+			glm::vec3 normal = quadAreaNormal(positions.data(), quad);
+			faceAreaNormals[f] = faceFlipped[f] ? -normal : normal;
+		}
+	});
+
+	// Area weighted, so small, squashed faces count for less
+	workers.parallelFor(numVerts(), SKIN_GRAIN, [&](size_t begin, size_t end, unsigned) {
+		for (size_t v = begin; v < end; ++v) {
+			uint8_t dirty = 0;
+			for (uint32_t i = vertFaceStarts[v]; i < vertFaceStarts[v + 1]; ++i) dirty |= faceDirty[vertFaces[i]];
+			if (!dirty) continue;
+			glm::vec3 total(0);
+			for (uint32_t i = vertFaceStarts[v]; i < vertFaceStarts[v + 1]; ++i) total += faceAreaNormals[vertFaces[i]];
+			float length = glm::length(total);
+			normals[v] = length > 0 ? total / length : glm::vec3(0, 1, 0);
+		}
+	});
+
+	size_t total = 0;
+	for (size_t count : recomputed) total += count;
+	return total;
+}
@@ -0,0 +1,60 @@
+#ifndef surfaceSkin_hpp
+#define surfaceSkin_hpp
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "physState.hpp"
+#include "voxelStorage.hpp"
+#include "workerPool.hpp"
+
+
+// The deformed surface on the CPU, the same as stretchyVoxels.vert draws it: each surface vertex is the average of the matching corners of
+// the up to 8 cubes around it. Also works out smooth normals and how stretched each vertex is, for exporting and picking.
+// Only vertices next to a cube that moved since the last update are recomputed, along with the normals around them.
+class SurfaceSkin {
+public:
+	// Reads the topology in place, so whatever it points into has to outlive this
+	explicit SurfaceSkin(const TopologyView& topology, unsigned threads = 1);
+
+	// Returns how many vertices were recomputed. The first update does all of them.
+	size_t update(const PhysData3D* data3D, const PhysData4D* data4D);
+	// Makes the next update recompute everything, for when the state jumped somewhere unrelated
+	void invalidate() { first = true; }
+
+	size_t numVerts() const { return positions.size(); }
+	// One per surface vertex, in sim space
+	const std::vector<glm::vec3>& vertPositions() const { return positions; }
+	// Unit length, pointing out of the body
+	const std::vector<glm::vec3>& vertNormals() const { return normals; }
+	// RMS distance of the neighboring cubes' corners from where the vertex ended up. 0 when they all agree, which is when nothing is stretched.
+	const std::vector<float>& vertStrain() const { return strain; }
+	// Per face, pointing out, with length twice the face's area. Faces are quads in faceIndices order.
+	const std::vector<glm::vec3>& faceNormals() const { return faceAreaNormals; }
+	// Where each cube was at the last update
+	const std::vector<glm::vec3>& cubePositions() const { return lastPos; }
+	// Whether the face's vertices in faceIndices go clockwise seen from outside. Reverse them for anything that goes by winding.
+	bool isFaceFlipped(size_t face) const { return faceFlipped[face]; }
+
+private:
+	const VoxelStorage::VertNeighbors* vertsNeighbors;
+	const uint32_t* faceIndices;
+	size_t numCubes, numFaces;
+	WorkerPool workers;
+
+	std::vector<glm::vec3> positions, normals, faceAreaNormals;
+	std::vector<float> strain;
+	// The faces each vertex is part of: vertFaces[vertFaceStarts[v]] up to vertFaceStarts[v + 1]
+	std::vector<uint32_t> vertFaceStarts, vertFaces;
+	// Whether each face's vertices go clockwise seen from outside, since which way round they go depends on which side of the cube it's on
+	std::vector<uint8_t> faceFlipped;
+
+	// What each cube was at the last update, to tell which moved
+	std::vector<glm::vec3> lastPos;
+	std::vector<glm::vec4> lastTurn;
+	std::vector<uint8_t> cubeDirty, vertDirty, faceDirty;
+	bool first = true;
+};
+
+
+#endif /* surfaceSkin_hpp */
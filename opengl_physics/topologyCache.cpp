@@ -0,0 +1,96 @@
+#include "topologyCache.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "slabTopology.hpp"
+
+
+uint64_t hashOccupancy(const OccupancyGrid& grid) {
+	uint64_t hash = 0x9E3779B97F4A7C15;
+	auto mix = [&hash](uint64_t value) {
+		hash ^= value * 0xBF58476D1CE4E5B9;
+		hash = ((hash << 27) | (hash >> 37)) * 0x94D049BB133111EB;
+	};
+	for (size_t size : grid.sizes) mix(size);
+	for (uint64_t word : grid.words) mix(word);
+	return hash ^ (hash >> 31);
+}
+
+std::string topologyCacheDir() {
+	std::string dir;
+	const char* cacheHome = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	if (cacheHome && *cacheHome) dir = cacheHome;
+	else if (home && *home) dir = std::string(home) + "/.cache";
+	else return "";
+
+	dir += "/bouncy-cube";
+	// Either of these can already be there
+	mkdir(dir.substr(0, dir.rfind('/')).c_str(), 0755);
+	mkdir(dir.c_str(), 0755);
+	if (access(dir.c_str(), W_OK) != 0) return "";
+	return dir;
+}
+
+
+namespace {
+
+std::string cachedTopologyPath(const std::string& dir, uint64_t hash) {
+	char name[32];
+	snprintf(name, sizeof(name), "/%016" PRIx64 ".topology", hash);
+	return dir + name;
+}
+
+}
+
+
+CachedTopology::CachedTopology(const OccupancyGrid& grid) : hash(hashOccupancy(grid)) {
+	std::string dir = topologyCacheDir();
+	if (!dir.empty()) {
+		std::string path = cachedTopologyPath(dir, hash);
+
+		auto matches = [&]() {
+			const TopologyHeader& header = mapped.header();
+			return header.occupancyHash == hash && header.builderVersion == TOPOLOGY_BUILDER_VERSION
+				&& header.sizes[0] == grid.sizes[0] && header.sizes[1] == grid.sizes[1] && header.sizes[2] == grid.sizes[2];
+		};
+		// Not being there is the usual way to miss, and isn't worth printing about
+		if (access(path.c_str(), R_OK) == 0 && mapped.open(path) && matches()) {
+			cached = true;
+		}
+		else {
+			mapped.close();
+			// Built under another name and moved into place, so nobody ever maps half a file
+			std::string partial = path + "." + std::to_string(getpid());
+			if (buildTopologyFile(gridSlabs(grid), grid.sizes, partial, nullptr, hash) && rename(partial.c_str(), path.c_str()) == 0) {
+				mapped.open(path);
+			}
+			else {
+				unlink(partial.c_str());
+			}
+		}
+	}
+
+	if (mapped.isOpen()) {
+		topologyView = mapped.view();
+	}
+	else {
+		built.reset(new VoxelStorage(grid));
+		topologyView = *built;
+	}
+}
+
+CachedTopology::CachedTopology(uint64_t occupancyHash) : hash(occupancyHash) {
+	std::string dir = topologyCacheDir();
+	if (dir.empty()) return;
+	std::string path = cachedTopologyPath(dir, hash);
+	if (mapped.open(path) && mapped.header().occupancyHash == hash && mapped.header().builderVersion == TOPOLOGY_BUILDER_VERSION) {
+		cached = true;
+		topologyView = mapped.view();
+	}
+	else {
+		mapped.close();
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef topologyCache_hpp
+#define topologyCache_hpp
+
+#include <string>
+#include <memory>
+#include "occupancyGrid.hpp"
+#include "voxelStorage.hpp"
+#include "topologyFile.hpp"
+
+
+// Identifies a grid by its size and every voxel in it
+uint64_t hashOccupancy(const OccupancyGrid& grid);
+
+// Where built topologies are kept: $XDG_CACHE_HOME/bouncy-cube, or ~/.cache/bouncy-cube. Made if it isn't there.
+// Empty if there's nowhere to put it.
+std::string topologyCacheDir();
+
+// The topology of a grid, mapped from the cache if it's been built before.
+// Cached files are named by the grid's hash and checked against the builder version, so a changed body or builder never uses a stale one.
+class CachedTopology {
+public:
+	// Builds straight into the cache if it isn't there. If the cache can't be written, builds in memory instead.
+	explicit CachedTopology(const OccupancyGrid& grid);
+	// Only looks in the cache, for when all that's known is the hash, like when restoring a checkpoint. Check isOpen after.
+	explicit CachedTopology(uint64_t occupancyHash);
+
+	bool isOpen() const { return mapped.isOpen() || built; }
+
+	// Only good as long as this is
+	const TopologyView& view() const { return topologyView; }
+	// Whether it came out of the cache already built
+	bool wasCached() const { return cached; }
+	uint64_t occupancyHash() const { return hash; }
+
+private:
+	MappedTopology mapped;
+	std::unique_ptr<VoxelStorage> built;
+	TopologyView topologyView;
+	uint64_t hash;
+	bool cached = false;
+};
+
+
+#endif /* topologyCache_hpp */
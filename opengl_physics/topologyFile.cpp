@@ -0,0 +1,114 @@
+#include "topologyFile.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+
+namespace {
+
+const uint64_t PAGE_SIZE = 4096;
+
+uint64_t pageAlign(uint64_t offset) {
+	return (offset + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+bool writeAt(FILE* file, uint64_t offset, const void* data, size_t bytes) {
+	return fseek(file, offset, SEEK_SET) == 0 && fwrite(data, 1, bytes, file) == bytes;
+}
+
+// Whether count items of itemSize starting at offset are all inside the file, and start aligned for them
+bool tableFits(uint64_t offset, uint64_t count, size_t itemSize, size_t alignment, uint64_t fileSize) {
+	return offset % alignment == 0 && offset <= fileSize && count <= (fileSize - offset) / itemSize;
+}
+
+}
+
+
+void layoutTopology(TopologyHeader& header) {
+	memcpy(header.magic, "BCTP", 4);
+	header.version = TOPOLOGY_FILE_VERSION;
+	header.builderVersion = TOPOLOGY_BUILDER_VERSION;
+
+	uint64_t offset = pageAlign(sizeof(TopologyHeader));
+	auto place = [&offset](uint64_t& tableOffset, uint64_t bytes) {
+		tableOffset = offset;
+		offset = pageAlign(offset + bytes);
+	};
+	place(header.cubesPosOffset, header.numCubes * sizeof(glm::vec3));
+	place(header.cubesDataOffset, header.numCubes * sizeof(VoxelStorage::CubeData));
+	place(header.vertsNeighborsOffset, header.numVerts * sizeof(VoxelStorage::VertNeighbors));
+	place(header.faceIndicesOffset, header.numFaces * 4 * sizeof(uint32_t));
+	place(header.faceCubesOffset, header.numFaces * sizeof(uint32_t));
+	header.fileSize = offset;
+}
+
+bool writeTopology(const VoxelStorage& voxels, const std::string& path, uint64_t occupancyHash) {
+	TopologyHeader header = {};
+	for (int i = 0; i < 3; ++i) header.sizes[i] = voxels.storage.sizes[i];
+	header.numCubes = voxels.cubesPos.size();
+	header.numVerts = voxels.vertsNeighbors.size();
+	header.numFaces = voxels.faceCubes.size();
+	header.occupancyHash = occupancyHash;
+	layoutTopology(header);
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		perror((std::string("Error creating ") + path).c_str());
+		return false;
+	}
+	// Writing the last byte first sizes the file, so the padding between tables reads as zeros
+	const uint8_t zero = 0;
+	bool ok = writeAt(file, header.fileSize - 1, &zero, 1)
+		&& writeAt(file, 0, &header, sizeof(header))
+		&& writeAt(file, header.cubesPosOffset, voxels.cubesPos.data(), header.numCubes * sizeof(glm::vec3))
+		&& writeAt(file, header.cubesDataOffset, voxels.cubesData.data(), header.numCubes * sizeof(VoxelStorage::CubeData))
+		&& writeAt(file, header.vertsNeighborsOffset, voxels.vertsNeighbors.data(), header.numVerts * sizeof(VoxelStorage::VertNeighbors))
+		&& writeAt(file, header.faceIndicesOffset, voxels.faceIndices.data(), voxels.faceIndices.size() * sizeof(uint32_t))
+		&& writeAt(file, header.faceCubesOffset, voxels.faceCubes.data(), header.numFaces * sizeof(uint32_t));
+	if (fclose(file) != 0) ok = false;
+	if (!ok) perror((std::string("Error writing ") + path).c_str());
+	return ok;
+}
+
+
+bool MappedTopology::open(const std::string& path) {
+	if (!file.open(path)) return false;
+	if (file.size() < sizeof(TopologyHeader) || memcmp(header().magic, "BCTP", 4) != 0) {
+		std::cout << path << " is not a topology file" << std::endl;
+		file.close();
+		return false;
+	}
+	if (header().version != TOPOLOGY_FILE_VERSION || header().fileSize != file.size()) {
+		std::cout << path << " is from a different version, or was cut short" << std::endl;
+		file.close();
+		return false;
+	}
+	// The header's own counts and offsets are all that's trusted from here on, so they have to stay inside the mapping
+	const TopologyHeader& h = header();
+	uint64_t size = file.size();
+	bool fits = tableFits(h.cubesPosOffset, h.numCubes, sizeof(glm::vec3), alignof(glm::vec3), size)
+		&& tableFits(h.cubesDataOffset, h.numCubes, sizeof(VoxelStorage::CubeData), alignof(VoxelStorage::CubeData), size)
+		&& tableFits(h.vertsNeighborsOffset, h.numVerts, sizeof(VoxelStorage::VertNeighbors), alignof(VoxelStorage::VertNeighbors), size)
+		&& h.numFaces <= UINT64_MAX / 4 && tableFits(h.faceIndicesOffset, h.numFaces * 4, sizeof(uint32_t), alignof(uint32_t), size)
+		&& tableFits(h.faceCubesOffset, h.numFaces, sizeof(uint32_t), alignof(uint32_t), size);
+	if (!fits) {
+		std::cout << path << " has tables that run past its end" << std::endl;
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+TopologyView MappedTopology::view() const {
+	TopologyView view;
+	for (int i = 0; i < 3; ++i) view.sizes[i] = header().sizes[i];
+	view.numCubes = numCubes();
+	view.numVerts = numVerts();
+	view.numFaces = numFaces();
+	view.cubesPos = cubesPos();
+	view.cubesData = cubesData();
+	view.vertsNeighbors = vertsNeighbors();
+	view.faceIndices = faceIndices();
+	view.faceCubes = faceCubes();
+	return view;
+}
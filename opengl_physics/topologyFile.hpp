@@ -0,0 +1,67 @@
+#ifndef topologyFile_hpp
+#define topologyFile_hpp
+
+#include <string>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "voxelStorage.hpp"
+#include "mappedFile.hpp"
+
+
+// VoxelStorage's tables as one file, laid out so it can be mapped and used in place.
+// Each table starts on a page boundary, so it's as aligned as an allocation would be and can be handed to GL or the solver as is.
+struct TopologyHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sizes[3];
+	uint64_t numCubes, numVerts, numFaces;
+	// What it was built from, for telling whether a cached copy is still good. 0 if nobody said.
+	uint64_t occupancyHash;
+	uint32_t builderVersion;
+	// Where each table starts, in bytes from the start of the file
+	uint64_t cubesPosOffset, cubesDataOffset, vertsNeighborsOffset, faceIndicesOffset, faceCubesOffset;
+	uint64_t fileSize;
+};
+
+constexpr uint32_t TOPOLOGY_FILE_VERSION = 2;
+// Changes whenever setCubes or buildTopologyFile would make different tables from the same grid, so old cached ones aren't used
+constexpr uint32_t TOPOLOGY_BUILDER_VERSION = REORDER_FACES ? 2 : 1;
+
+// Fills in the magic, the versions, and where everything goes from the sizes and counts already in header
+void layoutTopology(TopologyHeader& header);
+
+// Writes a topology that's already built. Prints why and returns false on failure.
+bool writeTopology(const VoxelStorage& voxels, const std::string& path, uint64_t occupancyHash = 0);
+
+
+class MappedTopology {
+public:
+	// Prints why and returns false if the file can't be opened or isn't a topology this version can read
+	bool open(const std::string& path);
+	void close() { file.close(); }
+	bool isOpen() const { return file.isOpen(); }
+
+	const TopologyHeader& header() const { return *(const TopologyHeader*) file.data(); }
+	size_t numCubes() const { return header().numCubes; }
+	size_t numVerts() const { return header().numVerts; }
+	size_t numFaces() const { return header().numFaces; }
+
+	const glm::vec3* cubesPos() const { return table<glm::vec3>(header().cubesPosOffset); }
+	const VoxelStorage::CubeData* cubesData() const { return table<VoxelStorage::CubeData>(header().cubesDataOffset); }
+	const VoxelStorage::VertNeighbors* vertsNeighbors() const { return table<VoxelStorage::VertNeighbors>(header().vertsNeighborsOffset); }
+	// 4 per face
+	const uint32_t* faceIndices() const { return table<uint32_t>(header().faceIndicesOffset); }
+	const uint32_t* faceCubes() const { return table<uint32_t>(header().faceCubesOffset); }
+
+	// Points into the mapping, so it's only good while this is open
+	TopologyView view() const;
+
+private:
+	MappedFile file;
+
+	template<typename T>
+	const T* table(uint64_t offset) const { return (const T*) (file.data() + offset); }
+};
+
+
+#endif /* topologyFile_hpp */
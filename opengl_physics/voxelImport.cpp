@@ -0,0 +1,245 @@
+#include "voxelImport.hpp"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include "mappedFile.hpp"
+
+
+namespace {
+
+// Calls progress every 1/64th of the way through the file
+class ProgressReporter {
+	const ImportProgress& progress;
+	size_t total, next = 0, step;
+public:
+	ProgressReporter(const ImportProgress& progress, size_t total) : progress(progress), total(total), step(total / 64 + 1) {}
+	void update(size_t done) {
+		if (progress && done >= next) {
+			progress((float) done / total);
+			next = done + step;
+		}
+	}
+	void finish() {
+		if (progress) progress(1);
+	}
+};
+
+uint32_t readU32(const uint8_t* p) {
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+// Index of each filled voxel among all the filled voxels, in memory order.
+// rowStarts[r] is the number of filled voxels before row r.
+std::vector<size_t> countRowStarts(const OccupancyGrid& grid) {
+	size_t rows = grid.sizes[1] * grid.sizes[2];
+	std::vector<size_t> rowStarts(rows + 1);
+	size_t filled = 0;
+	for (size_t r = 0; r < rows; ++r) {
+		rowStarts[r] = filled;
+		for (size_t w = 0; w < grid.wordsPerRow; ++w) {
+			filled += __builtin_popcountll(grid.words[r * grid.wordsPerRow + w]);
+		}
+	}
+	rowStarts[rows] = filled;
+	return rowStarts;
+}
+size_t cubeIndex(const OccupancyGrid& grid, const std::vector<size_t>& rowStarts, size_t x, size_t y, size_t z) {
+	const uint64_t* row = grid.row(y, z);
+	size_t index = rowStarts[z * grid.sizes[1] + y];
+	for (size_t w = 0; w < x / 64; ++w) index += __builtin_popcountll(row[w]);
+	uint64_t below = (uint64_t(1) << (x % 64)) - 1;
+	return index + __builtin_popcountll(row[x / 64] & below);
+}
+
+}
+
+
+bool loadVox(const std::string& path, VoxelModel& model, const ImportProgress& progress) {
+	MappedFile file(path);
+	if (!file.isOpen()) return false;
+	const uint8_t* data = file.data();
+	const size_t size = file.size();
+
+	if (size < 8 || memcmp(data, "VOX ", 4) != 0) {
+		std::cout << path << " is not a MagicaVoxel file" << std::endl;
+		return false;
+	}
+
+	// Chunks are id, content size, children size, content, children. MAIN's children are every other chunk, one after another.
+	const uint8_t* sizeChunk = nullptr;
+	const uint8_t* voxels = nullptr;
+	size_t numVoxels = 0;
+	const uint8_t* rgba = nullptr;
+	for (size_t pos = 8; pos + 12 <= size;) {
+		const uint8_t* chunk = data + pos;
+		size_t contentSize = readU32(chunk + 4), childrenSize = readU32(chunk + 8);
+		const uint8_t* content = chunk + 12;
+		if (pos + 12 + contentSize > size) break;
+
+		if (memcmp(chunk, "MAIN", 4) == 0) {
+			// Step into the children
+			pos += 12 + contentSize;
+			continue;
+		}
+		if (memcmp(chunk, "SIZE", 4) == 0 && !sizeChunk && contentSize >= 12) {
+			sizeChunk = content;
+		}
+		else if (memcmp(chunk, "XYZI", 4) == 0 && !voxels && contentSize >= 4) {
+			numVoxels = std::min((size_t) readU32(content), (contentSize - 4) / 4);
+			voxels = content + 4;
+		}
+		else if (memcmp(chunk, "RGBA", 4) == 0 && contentSize >= 256 * 4) {
+			rgba = content;
+		}
+		pos += 12 + contentSize + childrenSize;
+	}
+	if (!sizeChunk || !voxels) {
+		std::cout << path << " has no model in it" << std::endl;
+		return false;
+	}
+
+	// MagicaVoxel has z up. y is flipped as well as swapped, so the model isn't mirrored.
+	size_t voxX = readU32(sizeChunk), voxY = readU32(sizeChunk + 4), voxZ = readU32(sizeChunk + 8);
+	model.occupancy = OccupancyGrid({voxX, voxZ, voxY});
+	ProgressReporter reporter(progress, numVoxels * 2);
+
+	// Voxels are listed in no particular order, so the first pass fills in the grid and the second puts materials in cube order
+	for (size_t i = 0; i < numVoxels; ++i) {
+		const uint8_t* v = voxels + i * 4;
+		if (v[0] < voxX && v[1] < voxY && v[2] < voxZ) {
+			model.occupancy.set(v[0], v[2], voxY - 1 - v[1], true);
+		}
+		reporter.update(i);
+	}
+	std::vector<size_t> rowStarts = countRowStarts(model.occupancy);
+	model.cubeMaterials.assign(rowStarts.back(), 0);
+	for (size_t i = 0; i < numVoxels; ++i) {
+		const uint8_t* v = voxels + i * 4;
+		if (v[0] < voxX && v[1] < voxY && v[2] < voxZ) {
+			model.cubeMaterials[cubeIndex(model.occupancy, rowStarts, v[0], v[2], voxY - 1 - v[1])] = v[3];
+		}
+		reporter.update(numVoxels + i);
+	}
+
+	// Palette entry i is the color of material i + 1
+	model.palette.clear();
+	if (rgba) {
+		model.palette.resize(256, 0);
+		for (int i = 0; i < 255; ++i) {
+			model.palette[i + 1] = readU32(rgba + i * 4);
+		}
+	}
+	reporter.finish();
+	return true;
+}
+
+bool loadBinvox(const std::string& path, VoxelModel& model, const ImportProgress& progress) {
+	MappedFile file(path);
+	if (!file.isOpen()) return false;
+	file.adviseSequential();
+	const uint8_t* data = file.data();
+	const size_t size = file.size();
+
+	// Text header, ending with a "data" line
+	size_t pos = 0;
+	size_t depth = 0, height = 0, width = 0;
+	bool sawData = false;
+	while (pos < size && !sawData) {
+		const uint8_t* lineEnd = (const uint8_t*) memchr(data + pos, '\n', size - pos);
+		if (!lineEnd) break;
+		std::string line((const char*) data + pos, lineEnd - (data + pos));
+		pos = lineEnd - data + 1;
+		if (line.compare(0, 4, "dim ") == 0) {
+			sscanf(line.c_str() + 4, "%zu %zu %zu", &depth, &height, &width);
+		}
+		else if (line == "data") {
+			sawData = true;
+		}
+	}
+	if (!sawData || depth == 0 || height == 0 || width == 0) {
+		std::cout << path << " is not a binvox file" << std::endl;
+		return false;
+	}
+
+	// Runs of (value, count), with y changing fastest, then z, then x
+	model.occupancy = OccupancyGrid({depth, width, height});
+	model.cubeMaterials.clear();
+	model.palette.clear();
+	ProgressReporter reporter(progress, size);
+	const size_t total = depth * width * height;
+	size_t index = 0;
+	for (; pos + 1 < size && index < total; pos += 2) {
+		uint8_t value = data[pos];
+		size_t end = std::min(index + data[pos + 1], total);
+		if (value) {
+			for (; index < end; ++index) {
+				size_t x = index / (width * height);
+				size_t z = (index / width) % height;
+				size_t y = index % width;
+				model.occupancy.set(x, y, z, true);
+			}
+		}
+		index = end;
+		reporter.update(pos);
+	}
+	reporter.finish();
+	return true;
+}
+
+bool loadRawVoxels(const std::string& path, OccupancyGrid::sizesT sizes, VoxelModel& model, const ImportProgress& progress) {
+	MappedFile file(path);
+	if (!file.isOpen()) return false;
+	file.adviseSequential();
+	if (file.size() < sizes[0] * sizes[1] * sizes[2]) {
+		std::cout << path << " is smaller than " << sizes[0] << "x" << sizes[1] << "x" << sizes[2] << std::endl;
+		return false;
+	}
+
+	// Already in memory order, so materials go straight into cube order
+	model.occupancy = OccupancyGrid(sizes);
+	model.cubeMaterials.clear();
+	model.palette.clear();
+	ProgressReporter reporter(progress, sizes[1] * sizes[2]);
+	const uint8_t* voxel = file.data();
+	for (size_t z = 0; z < sizes[2]; ++z)
+	for (size_t y = 0; y < sizes[1]; ++y) {
+		uint64_t* bits = model.occupancy.row(y, z);
+		for (size_t x = 0; x < sizes[0]; ++x, ++voxel) {
+			if (*voxel) {
+				bits[x / 64] |= uint64_t(1) << (x % 64);
+				model.cubeMaterials.push_back(*voxel);
+			}
+		}
+		reporter.update(z * sizes[1] + y);
+	}
+	reporter.finish();
+	return true;
+}
+
+bool rawVoxelSizes(const std::string& path, OccupancyGrid::sizesT& sizes) {
+	size_t underscore = path.rfind('_');
+	if (underscore == std::string::npos
+		|| sscanf(path.c_str() + underscore + 1, "%zux%zux%zu.raw", &sizes[0], &sizes[1], &sizes[2]) != 3) {
+		std::cout << "Raw voxel file names need the size in them, like model_128x64x128.raw" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadVoxelModel(const std::string& path, VoxelModel& model, const ImportProgress& progress) {
+	auto endsWith = [&path](const char* suffix) {
+		size_t length = strlen(suffix);
+		return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+	};
+	if (endsWith(".vox")) return loadVox(path, model, progress);
+	if (endsWith(".binvox")) return loadBinvox(path, model, progress);
+	if (endsWith(".raw")) {
+		OccupancyGrid::sizesT sizes;
+		return rawVoxelSizes(path, sizes) && loadRawVoxels(path, sizes, model, progress);
+	}
+	std::cout << "Don't know how to load " << path << std::endl;
+	return false;
+}
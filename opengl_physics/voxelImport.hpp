@@ -0,0 +1,39 @@
+#ifndef voxelImport_hpp
+#define voxelImport_hpp
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "occupancyGrid.hpp"
+
+
+struct VoxelModel {
+	OccupancyGrid occupancy{{0, 0, 0}};
+	// One per filled voxel, in memory order, which is the order VoxelStorage numbers cubes in. Empty if the format has no materials.
+	std::vector<uint8_t> cubeMaterials;
+	// RGBA (red in the low byte), indexed by material. Empty if the file didn't have one.
+	std::vector<uint32_t> palette;
+};
+
+// Called with the fraction of the file read so far, a few dozen times over a load
+typedef std::function<void(float)> ImportProgress;
+
+// The files are mapped rather than read, and decoded straight into the grid as they're paged in.
+// All of these print why and return false on failure.
+
+// MagicaVoxel. Only the first model is read, and the scene graph is ignored. Its z up becomes y up.
+bool loadVox(const std::string& path, VoxelModel& model, const ImportProgress& progress = nullptr);
+// binvox, as written by the binvox voxelizer. Has no materials.
+bool loadBinvox(const std::string& path, VoxelModel& model, const ImportProgress& progress = nullptr);
+// One byte per voxel with x fastest, then y, then z. 0 is empty; anything else is filled with that material.
+bool loadRawVoxels(const std::string& path, OccupancyGrid::sizesT sizes, VoxelModel& model, const ImportProgress& progress = nullptr);
+
+// Reads the size out of a raw file's name, like model_128x64x128.raw. Prints why and returns false if it isn't there.
+bool rawVoxelSizes(const std::string& path, OccupancyGrid::sizesT& sizes);
+
+// Picks a loader by extension. Raw files need their size in the name, like model_128x64x128.raw.
+bool loadVoxelModel(const std::string& path, VoxelModel& model, const ImportProgress& progress = nullptr);
+
+
+#endif /* voxelImport_hpp */
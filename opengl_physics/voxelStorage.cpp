@@ -0,0 +1,151 @@
+#include "voxelStorage.hpp"
+#include <cassert>
+
+
+void VoxelStorage::setCubes() {
+	cubesPos.clear();
+	cubesData.clear();
+	
+	const size_t sizeX = storage.sizes[0], sizeY = storage.sizes[1], sizeZ = storage.sizes[2];
+	
+	// Contains the indices of the vertices in toReturn
+	arrayND<int32_t, 3> indexMap(storage.sizes, -1);
+	auto faceStencil = indexMap.faceStencil();
+	
+	// One bit per voxel in the row, set where the voxel has a filled neighbor below it along each axis
+	std::vector<uint64_t> hasBelow[3];
+	for (auto& i : hasBelow) i.resize(storage.wordsPerRow);
+	
+	// Only visits filled voxels, in memory order
+	for (size_t z = 0; z < sizeZ; ++z)
+	for (size_t y = 0; y < sizeY; ++y) {
+		const uint64_t* bits = storage.row(y, z);
+		for (int j = 0; j < 3; ++j) {
+			storage.faceMaskRow(y, z, j, hasBelow[j].data());
+			for (size_t w = 0; w < storage.wordsPerRow; ++w) hasBelow[j][w] = bits[w] & ~hasBelow[j][w];
+		}
+		
+		size_t rowStart = indexMap.index((size_t) 0, y, z);
+		for (size_t w = 0; w < storage.wordsPerRow; ++w) {
+			for (uint64_t left = bits[w]; left != 0; left &= left - 1) {
+				int bit = __builtin_ctzll(left);
+				size_t x = w * 64 + bit;
+				size_t i = rowStart + x;
+				cubesPos.push_back(glm::vec3(x, y, z));
+				cubesData.emplace_back();
+				
+				indexMap.linear()[i] = cubesData.size() - 1;
+				
+				// Get the neighbors above, but not below
+				for (int j = 0; j < 3; ++j) {
+					if ((hasBelow[j][w] >> bit) & 1) {
+						size_t neighbor = i + faceStencil[j];
+						assert(indexMap.linear()[neighbor] >= 0);
+						cubesData.back().neighbors[j] = indexMap.linear()[neighbor];
+						cubesData[indexMap.linear()[neighbor]].neighbors[j + 3] = cubesData.size() - 1;
+					}
+				}
+			}
+		}
+	}
+	
+	arrayND<int32_t, 3> cornerIndexMap(
+	{ sizeX + 1, sizeY + 1, sizeZ + 1 }, -1);
+	auto cornerStencil = indexMap.cornerStencil();
+	std::vector<uint64_t> surfaceCorners(storage.cornerWordsPerRow());
+	
+	// Get vertices between cubes. Only corners with both cubes and air around them are visited.
+	for (size_t z = 0; z <= sizeZ; ++z)
+	for (size_t y = 0; y <= sizeY; ++y) {
+		storage.surfaceCornerRow(y, z, surfaceCorners.data());
+		for (size_t w = 0; w < surfaceCorners.size(); ++w)
+		for (uint64_t left = surfaceCorners[w]; left != 0; left &= left - 1) {
+			size_t x = w * 64 + __builtin_ctzll(left);
+			
+			VertNeighbors thisVert;
+			
+			// Away from the edges, all 8 cubes are in the grid and are a fixed offset from the first
+			bool interior = x > 0 && y > 0 && z > 0 && x < sizeX && y < sizeY && z < sizeZ;
+			size_t base = interior ? indexMap.index(x - 1, y - 1, z - 1) : 0;
+			
+			for (unsigned int i = 0; i < 8; ++i) {
+				if (interior) {
+					thisVert.neighbors[i] = indexMap.linear()[base + cornerStencil[i]];
+				}
+				else {
+					int cubeX = (int) x - !(i & 1);
+					int cubeY = (int) y - !(i & 2);
+					int cubeZ = (int) z - !(i & 4);
+					
+					if (cubeX >= 0 && cubeY >= 0 && cubeZ >= 0
+						&& cubeX < (int) sizeX && cubeY < (int) sizeY && cubeZ < (int) sizeZ) {
+						thisVert.neighbors[i] = indexMap(cubeX, cubeY, cubeZ);
+					}
+				}
+			}
+			
+			vertsNeighbors.push_back(thisVert);
+			cornerIndexMap(x, y, z) = vertsNeighbors.size() - 1;
+		}
+	}
+	
+	// Make faces from those vertices
+	for (size_t i = 0; i < cubesData.size(); ++i) {
+		arrayND<int32_t, 3>::sizesT cubePos = {
+			(size_t) cubesPos[i].x,  (size_t) cubesPos[i].y, (size_t) cubesPos[i].z
+		};
+		for (int j = 0; j < 6; ++j) {
+			if (cubesData[i].neighbors[j] == -1) {
+				arrayND<int32_t, 3>::sizesT cornerPos = cubePos;
+				cornerPos[j % 3] += j / 3;
+				/*
+				// Draw two triangles to make a face
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				cornerPos[(j + 1) % 3] += 1;
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				cornerPos[(j + 1) % 3] -= 1;
+				cornerPos[(j + 2) % 3] += 1;
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				cornerPos[(j + 1) % 3] += 1;
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				cornerPos[(j + 2) % 3] -= 1;
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				 */
+				// Draw a quad which gets processed by geometry shader
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				cornerPos[(j + 1) % 3] += 1;
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				cornerPos[(j + 2) % 3] += 1;
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				cornerPos[(j + 1) % 3] -= 1;
+				faceIndices.push_back(cornerIndexMap(cornerPos));
+				
+				faceCubes.push_back(i);
+			}
+		}
+	}
+	assert(faceCubes.size() * 4 == faceIndices.size());
+}
+
+
+void VoxelStorage::reorderSlabFaces() {
+	for (size_t start = 0, end; start < faceCubes.size(); start = end) {
+		float z = cubesPos[faceCubes[start]].z;
+		for (end = start + 1; end < faceCubes.size() && cubesPos[faceCubes[end]].z == z; ++end) {}
+		reorderFaces(&faceIndices[start * 4], &faceCubes[start], end - start);
+	}
+}
+
+std::vector<uint32_t> VoxelStorage::getEBO() {
+	std::vector<uint32_t> EBO;
+	for (uint32_t i = 0; i < cubesData.size(); ++i) {
+		for (auto j : cubesData[i].neighbors) {
+			if (j == -1) {
+				EBO.push_back(i);
+				break;
+			}
+		}
+	}
+	return EBO;
+}
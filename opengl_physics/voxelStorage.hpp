@@ -0,0 +1,91 @@
+#ifndef voxelStorage_hpp
+#define voxelStorage_hpp
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <glm/glm.hpp>
+#include "arrayND.hpp"
+#include "occupancyGrid.hpp"
+#include "faceOrder.hpp"
+
+
+class VoxelStorage {
+public:
+	OccupancyGrid storage;
+
+	// Every vertex has index of up to 6 connected vertices
+	struct CubeData {
+		CubeData() {
+			for (auto& i : neighbors) {
+				i = -1;
+			}
+		};
+
+		// Order: -x, -y, -z, +x, +y, +z
+		int32_t neighbors[6];
+	};
+	struct VertNeighbors {
+		// Order: mmm, mmp, mpm, mpp, pmm, pmp, ppm, ppp
+		int32_t neighbors[8];
+		VertNeighbors() {
+			for (auto& i : neighbors) {
+				i = -1;
+			}
+		};
+	};
+
+	std::vector<glm::vec3> cubesPos;
+	std::vector<CubeData> cubesData;
+	//std::vector<uint32_t> edgeIndices;
+	// List of vertices on the surface, each of which has up to 8 neighboring cubes
+	std::vector<VertNeighbors> vertsNeighbors;
+	// Quads of vertices that make up the faces
+	std::vector<uint32_t> faceIndices;
+	// Has an entry per face, saying which cube that face belongs to
+	std::vector<uint32_t> faceCubes;
+	// Material of each cube, from an imported model. Empty if the shape didn't have any.
+	std::vector<uint8_t> cubesMaterial;
+
+	// cubesMaterial, if given, has one entry per filled voxel in memory order. Without reorder, faces come in cube order.
+	VoxelStorage(OccupancyGrid storage, std::vector<uint8_t> cubesMaterial = {}, bool reorder = REORDER_FACES) : storage(std::move(storage)), cubesMaterial(std::move(cubesMaterial)) {
+
+		setCubes();
+		if (reorder) reorderSlabFaces();
+		//edgeIndices = getEBO();
+
+	}
+	VoxelStorage(const arrayND<bool, 3>& storage) : VoxelStorage(OccupancyGrid(storage)) {}
+
+	// Every vert is guaranteed to be either a positive x, y, or z in front of the previous vertex
+private:
+	void setCubes();
+	// A z slab at a time, the same as buildTopologyFile, so both come out in the same order
+	void reorderSlabFaces();
+	std::vector<uint32_t> getEBO();
+};
+
+// Which corner of VertNeighbors::neighbors[k] the vertex is, from the neighbor's center, in cube sizes. Same order as stretchyVoxels.vert.
+inline glm::vec3 cornerDirection(int k) {
+	return glm::vec3(k & 1 ? -0.5f : 0.5f, k & 2 ? -0.5f : 0.5f, k & 4 ? -0.5f : 0.5f);
+}
+
+// VoxelStorage's tables without the vectors, so the solver and renderer can read them from wherever they are, including a mapped file
+struct TopologyView {
+	OccupancyGrid::sizesT sizes = {};
+	size_t numCubes = 0, numVerts = 0, numFaces = 0;
+	const glm::vec3* cubesPos = nullptr;
+	const VoxelStorage::CubeData* cubesData = nullptr;
+	const VoxelStorage::VertNeighbors* vertsNeighbors = nullptr;
+	// 4 per face
+	const uint32_t* faceIndices = nullptr;
+	const uint32_t* faceCubes = nullptr;
+
+	TopologyView() = default;
+	TopologyView(const VoxelStorage& voxels) :
+	sizes(voxels.storage.sizes), numCubes(voxels.cubesPos.size()), numVerts(voxels.vertsNeighbors.size()), numFaces(voxels.faceCubes.size()),
+	cubesPos(voxels.cubesPos.data()), cubesData(voxels.cubesData.data()), vertsNeighbors(voxels.vertsNeighbors.data()),
+	faceIndices(voxels.faceIndices.data()), faceCubes(voxels.faceCubes.data()) {}
+};
+
+#endif /* voxelStorage_hpp */
@@ -2,6 +2,9 @@
 #include <string>
 #include <iostream>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
 #include <unistd.h>
 #define GLM_HAS_ONLY_XYZW
 #include <glm/glm.hpp>
@@ -10,191 +13,35 @@
 #include "arrayND.hpp"
 #include "input.hpp"
 #include "loaders.hpp"
+#include "voxelStorage.hpp"
+#include "topologyCache.hpp"
+#include "checkpoint.hpp"
+#include "rewind.hpp"
+#include "surfaceSkin.hpp"
+#include "surfacePicker.hpp"
+#include "constraints.hpp"
+#include "bounds.hpp"
+#include "bodyBatch.hpp"
+#include "stateRing.hpp"
+#include "surfaceLod.hpp"
+#include "shapes.hpp"
+#include "physState.hpp"
+#include "cpuSim.hpp"
 
 
 
-class VoxelStorage {
-public:
-	arrayND<bool, 3> storage;
-	
-	// Every vertex has index of up to 6 connected vertices
-	struct CubeData {
-		CubeData() {
-			for (auto& i : neighbors) {
-				i = -1;
-			}
-		};
-		
-		// Order: -x, -y, -z, +x, +y, +z
-		int32_t neighbors[6];
-	};
-	struct VertNeighbors {
-		// Order: mmm, mmp, mpm, mpp, pmm, pmp, ppm, ppp
-		int32_t neighbors[8];
-		VertNeighbors() {
-			for (auto& i : neighbors) {
-				i = -1;
-			}
-		};
-	};
-	
-	std::vector<glm::vec3> cubesPos;
-	std::vector<CubeData> cubesData;
-	//std::vector<uint32_t> edgeIndices;
-	// List of vertices on the surface, each of which has up to 8 neighboring cubes
-	std::vector<VertNeighbors> vertsNeighbors;
-	// Quads of vertices that make up the faces
-	std::vector<uint32_t> faceIndices;
-	// Has an entry per face, saying which cube that face belongs to
-	std::vector<uint32_t> faceCubes;
-	
-	VoxelStorage(arrayND<bool, 3> storage) : storage(storage) {
-		
-		setCubes();
-		//edgeIndices = getEBO();
-		
-	}
-	
-	// Every vert is guaranteed to be either a positive x, y, or z in front of the previous vertex
-private:
-	void setCubes() {
-		cubesPos.clear();
-		cubesData.clear();
-		
-		// Contains the indices of the vertices in toReturn
-		arrayND<int32_t, 3> indexMap(storage.sizes, -1);
-		
-		for (int i = 0; i < storage.total(); ++i) {
-			if (storage.linear()[i]) {
-				auto coord = storage.ind2coord(i);
-				cubesPos.push_back(glm::vec3(coord[0], coord[1], coord[2]));
-				cubesData.emplace_back();
-				
-				indexMap.linear()[i] = cubesData.size() - 1;
-				
-				// Get the neighbors above, but not below
-				for (int j = 0; j < 3; ++j) {
-					if (coord[j] > 0) {
-
-						auto neighborCoord = coord;
-						neighborCoord[j] -= 1;
-						if (storage[neighborCoord]) {
-							assert(indexMap[neighborCoord] >= 0);
-							cubesData.back().neighbors[j] = indexMap[neighborCoord];
-							cubesData[indexMap[neighborCoord]].neighbors[j + 3] = cubesData.size() - 1;
-						}
-					}
-				}
-			}
-		}
-		
-		arrayND<int32_t, 3> cornerIndexMap(
-		{ storage.sizes[0] + 1, storage.sizes[1] + 1, storage.sizes[2] + 1 }, -1);
-		
-		// Get vertices between cubes
-		for (int z = 0; z <= storage.sizes[2]; ++z)
-		for (int y = 0; y <= storage.sizes[1]; ++y)
-		for (int x = 0; x <= storage.sizes[0]; ++x) {
-			
-			VertNeighbors thisVert;
-			bool allNeighExists = true, allNeighAir = true;
-			
-			for (unsigned int i = 0; i < 8; ++i) {
-				int cubeX = x - !(i & 1);
-				int cubeY = y - !(i & 2);
-				int cubeZ = z - !(i & 4);
-				
-				if (cubeX >= 0 && cubeY >= 0 && cubeZ >= 0
-					&& cubeX < storage.sizes[0] && cubeY < storage.sizes[1] && cubeZ < storage.sizes[2]) {
-					thisVert.neighbors[i] = indexMap[cubeX][cubeY][cubeZ];
-				}
-				allNeighExists = allNeighExists && thisVert.neighbors[i] != -1;
-				allNeighAir = allNeighAir && thisVert.neighbors[i] == -1;
-			}
-			
-			if (!allNeighExists && !allNeighAir) {
-				vertsNeighbors.push_back(thisVert);
-				cornerIndexMap[x][y][z] = vertsNeighbors.size() - 1;
-			}
-		}
-		
-		// Make faces from those vertices
-		for (int i = 0; i < cubesData.size(); ++i) {
-			arrayND<int32_t, 3>::sizesT cubePos = {
-				(size_t) cubesPos[i].x,  (size_t) cubesPos[i].y, (size_t) cubesPos[i].z
-			};
-			for (int j = 0; j < 6; ++j) {
-				if (cubesData[i].neighbors[j] == -1) {
-					arrayND<int32_t, 3>::sizesT cornerPos = cubePos;
-					cornerPos[j % 3] += j / 3;
-					/*
-					// Draw two triangles to make a face
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					cornerPos[(j + 1) % 3] += 1;
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					cornerPos[(j + 1) % 3] -= 1;
-					cornerPos[(j + 2) % 3] += 1;
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					cornerPos[(j + 1) % 3] += 1;
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					cornerPos[(j + 2) % 3] -= 1;
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					 */
-					// Draw a quad which gets processed by geometry shader
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					cornerPos[(j + 1) % 3] += 1;
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					cornerPos[(j + 2) % 3] += 1;
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					cornerPos[(j + 1) % 3] -= 1;
-					faceIndices.push_back(cornerIndexMap[cornerPos]);
-					
-					faceCubes.push_back(i);
-				}
-			}
-		}
-		assert(faceCubes.size() * 4 == faceIndices.size());
-	}
-	
-	
-	std::vector<uint32_t> getEBO() {
-		std::vector<uint32_t> EBO;
-		for (uint32_t i = 0; i < cubesData.size(); ++i) {
-			for (auto j : cubesData[i].neighbors) {
-				if (j == -1) {
-					EBO.push_back(i);
-					break;
-				}
-			}
-		}
-		return EBO;
-	}
-};
-
-arrayND<bool, 3> genSphere(float radius) {
-	unsigned int arrSiz = (unsigned int) ceil(radius*2);
-	arrayND<bool, 3> sphere({arrSiz, arrSiz, arrSiz});
-	
-	
-	for (unsigned i = 0; i < sphere.total(); ++i) {
-		auto coord = sphere.ind2coord(i);
-		sphere.linear()[i] =
-		pow((float) coord[0] - radius + 0.5, 2) + pow((float) coord[1] - radius + 0.5, 2) + pow((float) coord[2] - radius + 0.5, 2)
-		<= pow(radius + 0.1, 2);
-		
-	}
-	
-	return sphere;
-}
-
-
-constexpr float RADIUS = 10;
-constexpr int PHYS_STEPS_PER_FRAME = 2;
-constexpr int SLOWDOWN_FACTOR = 1;
-
 constexpr bool DRAW_CUBES = false;
 constexpr bool DRAW_VECTORS = false;
+// Velocity a right click gives the cube it's on
+constexpr float POKE_SPEED = 40;
+// Cubes left between copies of the body. Twice the coarsest surface's blocks, so no block has cubes from two bodies in it.
+constexpr float BODY_GAP = 8;
+// Runs of visible bricks closer together than this many faces are drawn as one, since another draw costs more than drawing the faces between
+constexpr size_t MIN_CULLED_FACES = 2048;
+// Width in cubes of each level of detail's blocks
+constexpr unsigned LOD_BLOCK_SIZES[NUM_SURFACE_LODS] = {1, 2, 4};
+// A brick is drawn with the coarsest level whose faces come out no bigger than this many pixels across
+constexpr float LOD_MAX_FACE_PIXELS = 4;
 
 
 const GLchar * physOutputs[] = {
@@ -202,6 +49,13 @@ const GLchar * physOutputs[] = {
 	"gl_NextBuffer", "outTurn",
 	"gl_NextBuffer", "debugFeedback" };
 
+// The varyings go into sim.vert's binary but not its source, so they're part of its cache key
+std::string physOutputsKey() {
+	std::string key;
+	for (const GLchar* name : physOutputs) key += std::string(name) + ",";
+	return key;
+}
+
 
 
 struct BufferWithTexture {
@@ -237,95 +91,206 @@ struct BufferWithTexture {
 class VoxelRendererImpl : public VoxelRenderer {
 public:
 
-GLuint voxelRenderShader, vectorRenderShader, physicsShader, pickingShader;
+// All three start compiling before any of them is used
+Program voxelRenderShader, vectorRenderShader, physicsShader;
 GLuint cubeTexture = loadTexture("rubber.jpg");
 //GLuint cubeTexture = loadTexture("astroturf-2.jpeg");
 
-VoxelStorage toRender{genSphere(RADIUS)};
+std::unique_ptr<CachedTopology> body;
+// Copies of the body packed together, when there's more than one
+BodyBatch batch;
+// Read in place, straight out of the cache file when there is one, or out of batch
+TopologyView toRender;
 
 // PhysVBO is read and written by the physics code. DebugFeedbackVBO is written to but not read by the physics code, and DataVBO is read but not written to by the physics code. All three are read by the drawing code.
 	GLuint voxelRenderVAO, vectorRenderVAO, physVAO, dataVBO, vertNeighborVBO, EBO;
 
-struct PhysData3D {
-	glm::vec3 pos = glm::zero<glm::vec3>();
-	//glm::vec3 turn = glm::zero<glm::vec3>();
-	glm::vec3 vel = glm::zero<glm::vec3>();
-	glm::vec3 angVel = glm::zero<glm::vec3>();
-};
-struct PhysData4D {
-	glm::vec4 turn = glm::vec4(0, 0, 0, 1);
-};
-
 struct PhysBuffers {
 	BufferWithTexture data3D{GL_RGB32F, 0, "allVerts3D"}, data4D{GL_RGBA32F, 1, "allVerts4D"};
 };
 PhysBuffers physBuf1, physBuf2;
 	BufferWithTexture debugFeedback{GL_R32F, 3, "debugFeedback"},
-	faceHighlight{GL_R8, 4, "faceHighlight"};
+	faceHighlight{GL_R8, 4, "faceHighlight"},
+	constraintBuf{GL_RGBA32F, 5, "constraints"};
+// Grabs, pins and pokes, applied by sim.vert. Each cube's index into them is a vertex attribute, kept in constraintIdxVBO.
+ConstraintSet constraints;
+GLuint constraintIdxVBO;
+GLint impulseScaleLoc;
 
 size_t physVBO3DSize, physVBO4DSize, feedbackVBOSize;
 
 bool paused = true, doingStep = false;
+// Steps taken since the body was at rest, counting ones before a restored checkpoint
+uint64_t stepCount = 0;
+
+CheckpointSettings checkpoints;
+CheckpointWriter checkpointWriter;
+// The state is copied here on the GPU and read back once the fence says it's done, so saving never waits on the GPU
+GLuint snapshotBuf;
+GLsync snapshotFence = nullptr;
+uint64_t snapshotStep = 0;
+
+RewindBuffer rewindBuffer;
+// Steps between recorded frames
+uint64_t rewindSteps;
+// Every frame is copied to one of these and recorded a couple of frames later, once its fence is done.
+// If all of them are still in flight the frame isn't recorded.
+static constexpr unsigned NUM_READBACKS = 3;
+struct Readback {
+	GLuint buf;
+	GLsync fence = nullptr;
+	uint64_t step;
+} readbacks[NUM_READBACKS];
+// Queued readbacks are readbackHead through readbackTail, mod NUM_READBACKS
+unsigned readbackHead = 0, readbackTail = 0;
+
+// Only when the physics runs on the CPU, in which case it's stepped straight into the ring's buffers and physBuf1 is pointed at whichever
+// has the latest state. Steps before the last one each frame go through scratch.
+std::unique_ptr<CpuSim> cpuSim;
+std::unique_ptr<StateRing> stateRing;
+std::vector<PhysData3D> scratch3D[2];
+std::vector<PhysData4D> scratch4D[2];
+
+// The surface as of the latest readback, for clicking on. A couple of frames behind what's drawn, which is too little to notice.
+SurfaceSkin skin;
+SurfacePicker picker;
+
+// Boxes around each brick of cubes as of the latest readback, so bricks that are off screen aren't drawn
+BodyBounds bounds;
+uint64_t boundsStep = 0;
+// Each level's faces follow the one before's in EBO, and its vertices in vertNeighborVBO
+struct SurfaceLevel {
+	size_t faceStart = 0, numFaces = 0;
+	// Where each brick's faces start in EBO, plus one past the last. Empty for the full surface if its faces aren't grouped by brick,
+	// in which case everything is drawn at full detail.
+	std::vector<uint32_t> brickFaceStarts;
+} surfaceLevels[NUM_SURFACE_LODS];
+// How many pixels tall something a cube high is, divided by its distance along the view
+float lodPixelScale = 0;
+GLint faceOffsetLoc, texScaleLoc;
+FrameStats frameStats;
+// Faces drawn by the GPU, counted a couple of frames behind. A query that hasn't come back yet is left to finish and skipped over.
+static constexpr unsigned NUM_TRIANGLE_QUERIES = 3;
+GLuint triangleQueries[NUM_TRIANGLE_QUERIES];
+bool triangleQueryPending[NUM_TRIANGLE_QUERIES] = {};
+unsigned triangleQueryNext = 0;
+uint64_t trianglesDrawn = 0;
 
 struct ClickData {
 	int cubeSel = -1;
-	int cubeFacesStart = -1, cubeFacesCount = 0;
 	float screenDepth = 1;
 	glm::vec3 worldOffset = glm::zero<glm::vec3>();
 } clickData;
 
-VoxelRendererImpl() :
-vectorRenderShader(linkShaders({
+VoxelRendererImpl(std::unique_ptr<CachedTopology> topology, const CheckpointSettings& checkpointSettings, const RendererSettings& settings) :
+voxelRenderShader(DRAW_CUBES ? std::vector<ShaderSource>{
+	loadShader("voxels.vert", GL_VERTEX_SHADER),
+	loadShader("voxels.frag", GL_FRAGMENT_SHADER),
+	loadShader("voxels.geom", GL_GEOMETRY_SHADER)
+} : std::vector<ShaderSource>{
+	loadShader("stretchyVoxels.vert", GL_VERTEX_SHADER),
+	loadShader("voxels.frag", GL_FRAGMENT_SHADER),
+	loadShader("stretchyVoxels.geom", GL_GEOMETRY_SHADER)
+}),
+vectorRenderShader({
 	loadShader("vectors.vert", GL_VERTEX_SHADER),
 	loadShader("vectors.frag", GL_FRAGMENT_SHADER),
 	loadShader("vectors.geom", GL_GEOMETRY_SHADER)
-})),
-physicsShader(linkShaders({
-	loadShader("sim.vert", GL_VERTEX_SHADER)}, true, [] (GLuint toBeLinked) {
+}),
+physicsShader({
+	loadShader("sim.vert", GL_VERTEX_SHADER)}, [] (GLuint toBeLinked) {
 	glTransformFeedbackVaryings(toBeLinked, sizeof(physOutputs) / sizeof(physOutputs[0]), physOutputs, GL_INTERLEAVED_ATTRIBS);
-})) {
-	GLuint voxelVert, voxelGeom, pickingGeom;
-	
-	if (DRAW_CUBES) {
-		voxelVert = loadShader("voxels.vert", GL_VERTEX_SHADER);
-		voxelGeom = loadShader("voxels.geom", GL_GEOMETRY_SHADER);
-		pickingGeom = voxelGeom;
-	}
-	else {
-		voxelVert = loadShader("stretchyVoxels.vert", GL_VERTEX_SHADER);
-		voxelGeom = loadShader("stretchyVoxels.geom", GL_GEOMETRY_SHADER);
-		pickingGeom = loadShader("quadExpansion.geom", GL_GEOMETRY_SHADER);
-	}
-	GLuint voxelFrag = loadShader("voxels.frag", GL_FRAGMENT_SHADER);
-	GLuint pickingFrag = loadShader("picking.frag", GL_FRAGMENT_SHADER);
-	
-	voxelRenderShader = linkShaders({voxelVert, voxelFrag, voxelGeom}, false);
-	glDeleteShader(voxelFrag);
-	pickingShader = linkShaders({voxelVert, pickingFrag, pickingGeom});
-	
+}, physOutputsKey()),
+body(std::move(topology)),
+batch(settings.numBodies > 1 ? repeatBody(body->view(), settings.numBodies, BODY_GAP) : BodyBatch()),
+toRender(settings.numBodies > 1 ? batch.view() : body->view()),
+constraints(toRender.numCubes),
+checkpoints(checkpointSettings),
+rewindBuffer(toRender.numCubes, settings.rewindBytes),
+rewindSteps(std::max(settings.rewindInterval, 1u) * PHYS_STEPS_PER_FRAME),
+skin(toRender),
+picker(toRender) {
 	
 	glGenVertexArrays(3, &voxelRenderVAO);
 	glBindVertexArray(voxelRenderVAO);
 	
 	// Set the initial positions
-	std::vector<PhysData3D> initPhysData(toRender.cubesPos.size());
-	std::vector<PhysData4D> initTurn(toRender.cubesPos.size());
-	for (unsigned i = 0; i < toRender.cubesPos.size(); ++i) {
-		initPhysData[i].pos = toRender.cubesPos[i];
+	std::vector<PhysData3D> initPhysData;
+	std::vector<PhysData4D> initTurn;
+	initPhysState<float>(toRender, initPhysData, initTurn);
+	for (unsigned i = 0; i < toRender.numCubes; ++i) {
 		//if (i < 10) initPhysData[i].vel = glm::vec3(1, 1, 1);
 		//if (i > toRender.vertsPos.size() - 51) initPhysData[i].vel = glm::vec3(100, 0, 0);
 		//if (i < 50) initPhysData[i].vel = glm::vec3(-100, 0, 0);
 		//initPhysData[i].angVel = glm::vec3(0, 30, 0);
 	}
 	
-	physVBO3DSize = toRender.cubesPos.size() * sizeof(PhysData3D);
-	physVBO4DSize = toRender.cubesPos.size() * sizeof(PhysData4D);
-	feedbackVBOSize = toRender.cubesPos.size() * sizeof(float);
+	physVBO3DSize = toRender.numCubes * sizeof(PhysData3D);
+	physVBO4DSize = toRender.numCubes * sizeof(PhysData4D);
+	feedbackVBOSize = toRender.numCubes * sizeof(float);
+	
+	const PhysData3D* startData = initPhysData.data();
+	const PhysData4D* startTurn = initTurn.data();
+	const MappedCheckpoint* restoreFrom = checkpoints.restoreFrom.get();
+	if (restoreFrom && restoreFrom->isOpen()) {
+		if (restoreFrom->header().occupancyHash == body->occupancyHash() && restoreFrom->numCubes() == toRender.numCubes) {
+			// Uploaded straight from the mapped file
+			startData = restoreFrom->data3D();
+			startTurn = restoreFrom->data4D();
+			stepCount = restoreFrom->header().stepCount;
+		}
+		else {
+			std::cerr << "Checkpoint is of a different body; starting from rest" << std::endl;
+		}
+	}
 	
-	glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data3D.buf);
-	glBufferData(GL_ARRAY_BUFFER, physVBO3DSize, initPhysData.data(), GL_STREAM_COPY);
-	glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data4D.buf);
-	glBufferData(GL_ARRAY_BUFFER, physVBO4DSize, initTurn.data(), GL_STREAM_COPY);
+	// Bricks are cut at each body's start, so culling never has to draw one body for the sake of another
+	std::vector<size_t> bodyStarts;
+	for (size_t i = 0; i < batch.numBodies(); ++i) bodyStarts.push_back(batch.range(i).cubeStart);
+	bounds.layout = BrickLayout(toRender.numCubes, bodyStarts);
+	
+	if (settings.cpuThreads > 0) {
+		cpuSim.reset(new CpuSim(toRender, settings.cpuThreads));
+		cpuSim->constraints = &constraints;
+		cpuSim->bounds = &bounds;
+		stateRing.reset(new StateRing(toRender.numCubes));
+		for (int i = 0; i < 2; ++i) {
+			scratch3D[i].resize(toRender.numCubes);
+			scratch4D[i].resize(toRender.numCubes);
+		}
+		// The ring has its own buffers
+		glDeleteBuffers(1, &physBuf1.data3D.buf);
+		glDeleteBuffers(1, &physBuf1.data4D.buf);
+		publishState(startData, startTurn);
+		std::cout << "Physics on " << cpuSim->numThreads() << " CPU threads, uploaded through "
+		<< (stateRing->isPersistent() ? "persistently mapped buffers" : "glBufferData") << std::endl;
+	}
+	else {
+		glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data3D.buf);
+		glBufferData(GL_ARRAY_BUFFER, physVBO3DSize, startData, GL_STREAM_COPY);
+		glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data4D.buf);
+		glBufferData(GL_ARRAY_BUFFER, physVBO4DSize, startTurn, GL_STREAM_COPY);
+	}
+	skin.update(startData, startTurn);
+	picker.refit(skin.vertPositions());
+	findBrickFaces();
+	computeBounds(startData, toRender.numCubes, bounds);
+	fitBoundsToSurface();
+	boundsStep = stepCount;
+	glGenBuffers(1, &snapshotBuf);
+	if (cpuSim) {
+		// Every state is already on the CPU, so there's nothing to read back
+		if (rewindBuffer.maxBytes() > 0) rewindBuffer.record(stepCount, startData, startTurn);
+	}
+	else {
+		for (Readback& readback : readbacks) {
+			glGenBuffers(1, &readback.buf);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buf);
+			glBufferData(GL_COPY_WRITE_BUFFER, physVBO3DSize + physVBO4DSize, nullptr, GL_STREAM_READ);
+		}
+		// So the starting state can be gone back to
+		queueReadback();
+	}
 	
 	if (DRAW_CUBES) setPosTurnDrawAttrs();
 	
@@ -344,14 +309,12 @@ physicsShader(linkShaders({
 	}
 	// neighbor data
 	glBindBuffer(GL_ARRAY_BUFFER, dataVBO);
-	glBufferData(GL_ARRAY_BUFFER, toRender.cubesData.size() * sizeof(VoxelStorage::CubeData), toRender.cubesData.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, toRender.numCubes * sizeof(VoxelStorage::CubeData), toRender.cubesData, GL_STATIC_DRAW);
 	if (DRAW_CUBES) {
 		setVertDataAttrs(voxelRenderShader);
-		setVertDataAttrs(pickingShader);
 	}
 	else {
-		glBindBuffer(GL_ARRAY_BUFFER, vertNeighborVBO);
-		glBufferData(GL_ARRAY_BUFFER, toRender.vertsNeighbors.size() * sizeof(VoxelStorage::VertNeighbors), toRender.vertsNeighbors.data(), GL_STATIC_DRAW);
+		uploadSurfaces();
 		
 		glVertexAttribIPointer(0, 4, GL_INT, sizeof(int32_t) * 8, (void *) 0);
 		glEnableVertexAttribArray(0);
@@ -359,34 +322,33 @@ physicsShader(linkShaders({
 		glEnableVertexAttribArray(1);
 
 		initPhysBufferTextures(voxelRenderShader);
-		initPhysBufferTextures(pickingShader);
 		
 		debugFeedback.addToShader(voxelRenderShader);
 		faceHighlight.addToShader(voxelRenderShader);
 	}
 	
 	// CPU-set highlight color: one byte per face, might change
-	uint8_t* highlightClearData = (uint8_t*) calloc(1, toRender.faceCubes.size());
-	/*for (int i = 0; i < toRender.faceCubes.size(); ++i) {
+	uint8_t* highlightClearData = (uint8_t*) calloc(1, toRender.numFaces);
+	/*for (int i = 0; i < toRender.numFaces; ++i) {
 		highlightClearData[i] = 255;
 	}*/
 	glBindBuffer(GL_ARRAY_BUFFER, faceHighlight.buf);
-	glBufferData(GL_ARRAY_BUFFER, toRender.faceCubes.size(), highlightClearData, GL_DYNAMIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, toRender.numFaces, highlightClearData, GL_DYNAMIC_DRAW);
 	free(highlightClearData);
 	
 	
 	
 	glUseProgram(voxelRenderShader);
 	glUniform1i(glGetUniformLocation(voxelRenderShader, "cubeTexture"), 2);
+	faceOffsetLoc = glGetUniformLocation(voxelRenderShader, "faceOffset");
+	texScaleLoc = glGetUniformLocation(voxelRenderShader, "texScale");
+	glUniform1f(texScaleLoc, 1);
+	glGenQueries(NUM_TRIANGLE_QUERIES, triangleQueries);
 	
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
 	if (DRAW_CUBES) {
+		//glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		//glBufferData(GL_ELEMENT_ARRAY_BUFFER, toRender.edgeIndices.size() * sizeof(uint32_t), toRender.edgeIndices.data(), GL_STATIC_DRAW);
 	}
-	else {
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, toRender.faceIndices.size() * sizeof(uint32_t), toRender.faceIndices.data(), GL_STATIC_DRAW);
-	}
 	
 	if (DRAW_VECTORS) {
 		// Drawing debug vectors
@@ -410,9 +372,21 @@ physicsShader(linkShaders({
 	setVertDataAttrs(physicsShader);
 	initPhysBufferTextures(physicsShader);
 	
-	glUniform1f(glGetUniformLocation(physicsShader, "timeDelta"), 1.0/60.0/PHYS_STEPS_PER_FRAME);
-	
-	initPicking();
+	glUniform1f(glGetUniformLocation(physicsShader, "timeDelta"), PHYS_TIME_DELTA);
+	impulseScaleLoc = glGetUniformLocation(physicsShader, "impulseScale");
+	
+	// Nothing constrained to start with
+	glGenBuffers(1, &constraintIdxVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, constraintIdxVBO);
+	std::vector<int32_t> noConstraints(toRender.numCubes, -1);
+	glBufferData(GL_ARRAY_BUFFER, toRender.numCubes * sizeof(int32_t), noConstraints.data(), GL_DYNAMIC_DRAW);
+	glVertexAttribIPointer(6, 1, GL_INT, sizeof(int32_t), 0);
+	glEnableVertexAttribArray(6);
+	// Never read while empty, but a texture buffer can't have nothing in it
+	glBindBuffer(GL_ARRAY_BUFFER, constraintBuf.buf);
+	CubeConstraint placeholder;
+	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeConstraint), &placeholder, GL_DYNAMIC_DRAW);
+	constraintBuf.addToShader(physicsShader);
 
 	addKeyListener(GLFW_KEY_P, [this](int scancode, int action, int mods) {
 		if (action == GLFW_PRESS) paused = !paused;
@@ -424,11 +398,25 @@ physicsShader(linkShaders({
 		}
 	});
 	
+	addKeyListener(GLFW_KEY_K, [this](int scancode, int action, int mods) {
+		if (action == GLFW_PRESS) startSnapshot();
+	});
+	// Back a frame, or a second with shift. Pauses, so it can be stepped or run again from there.
+	addKeyListener(GLFW_KEY_LEFT_BRACKET, [this](int scancode, int action, int mods) {
+		if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+			rewindBy(mods & GLFW_MOD_SHIFT ? uint64_t(1 / PHYS_TIME_DELTA) : PHYS_STEPS_PER_FRAME);
+		}
+	});
+	
+	// Drag to pull a cube along, shift-click to pin it where it is or let it go again, and right click to poke it
 	addClickListener([this](int button, int action, int mods) {
 		if (button == GLFW_MOUSE_BUTTON_LEFT) {
-			if (action == GLFW_PRESS) mouseDown();
+			if (action == GLFW_PRESS) mouseDown(mods);
 			else if (action == GLFW_RELEASE) mouseUp();
 		}
+		else if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
+			poke();
+		}
 	});
 }
 	
@@ -489,7 +477,7 @@ void physicsStep(PhysBuffers inVBOs, PhysBuffers outVBOs) {
 	inVBOs.data4D.bindTex();
 	
 	glBeginTransformFeedback(GL_POINTS);
-	glDrawArrays(GL_POINTS, 0, toRender.cubesPos.size());
+	glDrawArrays(GL_POINTS, 0, toRender.numCubes);
 	glEndTransformFeedback();
 	//glFlush();
 }
@@ -498,10 +486,6 @@ void physicsStep(PhysBuffers inVBOs, PhysBuffers outVBOs) {
 void doPhysics() {
 	if (paused && !doingStep) return;
 
-	glUseProgram(physicsShader);
-	glBindVertexArray(physVAO);
-	glEnable(GL_RASTERIZER_DISCARD);
-	
 	assert(PHYS_STEPS_PER_FRAME % 2 == 0);
 	assert(PHYS_STEPS_PER_FRAME / 2 % SLOWDOWN_FACTOR == 0);
 	
@@ -510,22 +494,254 @@ void doPhysics() {
 		stepsToDo = 1;
 		doingStep = false;
 	}
+	if (cpuSim) {
+		cpuPhysics(stepsToDo * 2);
+		return;
+	}
 
+	glUseProgram(physicsShader);
+	glBindVertexArray(physVAO);
+	glEnable(GL_RASTERIZER_DISCARD);
+	
+	uploadConstraints();
+	constraintBuf.bindTex();
+	// Only the first step gets the impulses
+	glUniform1f(impulseScaleLoc, constraints.hasImpulses() ? 1 : 0);
 	for (int i = 0; i < stepsToDo; ++i) {
 		physicsStep(physBuf1, physBuf2);
+		glUniform1f(impulseScaleLoc, 0);
 		physicsStep(physBuf2, physBuf1);
 	}
+	frameStats.physicsDraws += stepsToDo * 2;
+	constraints.impulsesApplied();
+	stepCount += stepsToDo * 2;
 	
 	glCheckError();
 	
 	glDisable(GL_RASTERIZER_DISCARD);
+	queueReadback();
+}
+
+// Every step but the last goes into scratch, and the last straight into the next of the ring's buffers
+void cpuPhysics(int steps) {
+	const PhysData3D* in3D = stateRing->current3D();
+	const PhysData4D* in4D = stateRing->current4D();
+	for (int i = 0; i < steps; ++i) {
+		PhysData3D* out3D = scratch3D[i % 2].data();
+		PhysData4D* out4D = scratch4D[i % 2].data();
+		if (i == steps - 1) stateRing->beginWrite(out3D, out4D);
+		cpuSim->step(in3D, in4D, out3D, out4D, nullptr, PHYS_TIME_DELTA);
+		in3D = out3D;
+		in4D = out4D;
+	}
+	stateRing->endWrite();
+	stepCount += steps;
+	usePublishedState();
+	// The solver reads the constraints in place, so there's nothing to upload
+	constraints.takeChangedCubes();
+	constraints.takeRecordsChanged();
+	stateArrived(stepCount, stateRing->current3D(), stateRing->current4D());
+	glCheckError();
+}
+
+// Makes a state from the CPU the one that's drawn and stepped from next
+void publishState(const PhysData3D* data3D, const PhysData4D* data4D) {
+	PhysData3D* out3D;
+	PhysData4D* out4D;
+	stateRing->beginWrite(out3D, out4D);
+	memcpy((void*) out3D, data3D, physVBO3DSize);
+	memcpy((void*) out4D, data4D, physVBO4DSize);
+	stateRing->endWrite();
+	usePublishedState();
+}
+
+void usePublishedState() {
+	physBuf1.data3D.buf = stateRing->currentBuf3D();
+	physBuf1.data4D.buf = stateRing->currentBuf4D();
+}
+
+// Sends what changed since the last step. The constraints themselves are few and small, so they go up whole.
+void uploadConstraints() {
+	std::vector<uint32_t> changed = constraints.takeChangedCubes();
+	if (!changed.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, constraintIdxVBO);
+		for (uint32_t cube : changed) {
+			glBufferSubData(GL_ARRAY_BUFFER, cube * sizeof(int32_t), sizeof(int32_t), constraints.indices() + cube);
+		}
+	}
+	if (constraints.takeRecordsChanged() && !constraints.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, constraintBuf.buf);
+		glBufferData(GL_ARRAY_BUFFER, constraints.size() * sizeof(CubeConstraint), constraints.data(), GL_DYNAMIC_DRAW);
+	}
+	glCheckError();
+}
+
+// Copies the current state to be recorded for rewinding, once the GPU gets to it
+void queueReadback() {
+	if (readbackTail - readbackHead == NUM_READBACKS) return;
+	Readback& readback = readbacks[readbackTail % NUM_READBACKS];
+	glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buf);
+	glBindBuffer(GL_COPY_READ_BUFFER, physBuf1.data3D.buf);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, physVBO3DSize);
+	glBindBuffer(GL_COPY_READ_BUFFER, physBuf1.data4D.buf);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, physVBO3DSize, physVBO4DSize);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.step = stepCount;
+	++readbackTail;
+	glCheckError();
+}
+
+// Records every readback that's done, oldest first
+void finishReadbacks() {
+	while (readbackHead != readbackTail) {
+		Readback& readback = readbacks[readbackHead % NUM_READBACKS];
+		GLenum status = glClientWaitSync(readback.fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) return;
+		glDeleteSync(readback.fence);
+		readback.fence = nullptr;
+		++readbackHead;
+		if (status == GL_WAIT_FAILED) continue;
+		
+		glBindBuffer(GL_COPY_READ_BUFFER, readback.buf);
+		const uint8_t* mapped = (const uint8_t*) glMapBufferRange(GL_COPY_READ_BUFFER, 0, physVBO3DSize + physVBO4DSize, GL_MAP_READ_BIT);
+		if (mapped) {
+			stateArrived(readback.step, (const PhysData3D*) mapped, (const PhysData4D*) (mapped + physVBO3DSize));
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+		}
+	}
+	glCheckError();
+}
+
+// A state the CPU can read, from a readback or the CPU solver. Recorded for rewinding and taken as the surface to click on.
+void stateArrived(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D) {
+	if (rewindBuffer.maxBytes() > 0 && (rewindBuffer.empty() || step >= rewindBuffer.newestStep() + rewindSteps)) rewindBuffer.record(step, data3D, data4D);
+	if (skin.update(data3D, data4D) > 0) picker.refit(skin.vertPositions());
+	// The CPU solver works out the bounds as it goes
+	if (!cpuSim) computeBounds(data3D, toRender.numCubes, bounds);
+	fitBoundsToSurface();
+	boundsStep = step;
+}
+
+// The bounds need the skin to be of the same state
+void fitBoundsToSurface() {
+	const std::vector<uint32_t>& brickFaceStarts = surfaceLevels[0].brickFaceStarts;
+	if (!brickFaceStarts.empty() && !bounds.all.empty()) bounds.addSurface(skin.vertPositions().data(), toRender.faceIndices, brickFaceStarts.data());
+}
+
+void dropReadbacks() {
+	for (; readbackHead != readbackTail; ++readbackHead) {
+		Readback& readback = readbacks[readbackHead % NUM_READBACKS];
+		glDeleteSync(readback.fence);
+		readback.fence = nullptr;
+	}
+}
+
+// Puts the body back how it was steps ago, or as close after that as is still kept
+void rewindBy(uint64_t steps) {
+	finishReadbacks();
+	// Anything still in flight is newer than where this is going
+	dropReadbacks();
+	paused = true;
+	if (rewindBuffer.empty()) return;
+	
+	uint64_t target = stepCount > steps ? stepCount - steps : 0;
+	target = std::max(target, rewindBuffer.oldestStep());
+	std::vector<PhysData3D> data3D(toRender.numCubes);
+	std::vector<PhysData4D> data4D(toRender.numCubes);
+	int64_t step = rewindBuffer.rewind(target, data3D.data(), data4D.data());
+	if (step < 0) return;
+	
+	if (cpuSim) {
+		publishState(data3D.data(), data4D.data());
+	}
+	else {
+		glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data3D.buf);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, physVBO3DSize, data3D.data());
+		glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data4D.buf);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, physVBO4DSize, data4D.data());
+	}
+	stepCount = step;
+	skin.update(data3D.data(), data4D.data());
+	picker.refit(skin.vertPositions());
+	computeBounds(data3D.data(), toRender.numCubes, bounds);
+	fitBoundsToSurface();
+	boundsStep = stepCount;
+	glCheckError();
+	
+	std::cout << "Back to step " << stepCount << "; " << (rewindBuffer.newestStep() - rewindBuffer.oldestStep()) * PHYS_TIME_DELTA
+		<< "s kept in " << rewindBuffer.bytesUsed() / (1 << 20) << " of " << rewindBuffer.maxBytes() / (1 << 20) << " MB" << std::endl;
+}
+
+// Copies the current state on the GPU, to be read back and saved once it's done. The CPU solver's is already in memory, so it's saved straight away;
+// copying its ring slot on the GPU wouldn't be covered by the slot's fence, and the solver could write the slot again before the copy ran.
+void startSnapshot() {
+	if (snapshotFence || checkpointWriter.busy()) {
+		std::cout << "Still saving the last checkpoint" << std::endl;
+		return;
+	}
+	if (stateRing) {
+		saveCheckpoint(stepCount, stateRing->current3D(), stateRing->current4D());
+		return;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, snapshotBuf);
+	glBufferData(GL_COPY_WRITE_BUFFER, physVBO3DSize + physVBO4DSize, nullptr, GL_STREAM_READ);
+	glBindBuffer(GL_COPY_READ_BUFFER, physBuf1.data3D.buf);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, physVBO3DSize);
+	glBindBuffer(GL_COPY_READ_BUFFER, physBuf1.data4D.buf);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, physVBO3DSize, physVBO4DSize);
+	snapshotFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	snapshotStep = stepCount;
+	glCheckError();
+}
+
+// Once the copy is done, hands it to the writer thread
+void finishSnapshot() {
+	if (!snapshotFence) return;
+	GLenum status = glClientWaitSync(snapshotFence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) return;
+	glDeleteSync(snapshotFence);
+	snapshotFence = nullptr;
+	if (status == GL_WAIT_FAILED) return;
+	
+	glBindBuffer(GL_COPY_READ_BUFFER, snapshotBuf);
+	const uint8_t* mapped = (const uint8_t*) glMapBufferRange(GL_COPY_READ_BUFFER, 0, physVBO3DSize + physVBO4DSize, GL_MAP_READ_BIT);
+	if (mapped) {
+		saveCheckpoint(snapshotStep, (const PhysData3D*) mapped, (const PhysData4D*) (mapped + physVBO3DSize));
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+	}
+	glCheckError();
+}
+
+// Hands a copy of the state to the writer thread
+void saveCheckpoint(uint64_t step, const PhysData3D* data3D, const PhysData4D* data4D) {
+	CheckpointState state;
+	state.occupancyHash = body->occupancyHash();
+	state.stepCount = step;
+	state.data3D.assign(data3D, data3D + toRender.numCubes);
+	state.data4D.assign(data4D, data4D + toRender.numCubes);
+	// Materials are one body's worth, repeated for each body of a batch, or already the whole batch's if they came from a checkpoint of one
+	const std::vector<uint8_t>& materials = checkpoints.cubesMaterial;
+	if (!materials.empty() && toRender.numCubes % materials.size() == 0) {
+		state.cubesMaterial.reserve(toRender.numCubes);
+		for (size_t i = 0; i < toRender.numCubes; i += materials.size()) state.cubesMaterial.insert(state.cubesMaterial.end(), materials.begin(), materials.end());
+	}
+	else if (!materials.empty()) {
+		std::cerr << "Materials don't line up with the cubes; saving without them" << std::endl;
+	}
+	state.palette = checkpoints.palette;
+	checkpointWriter.save(checkpoints.path, std::move(state));
+	std::cout << "Saving step " << step << " to " << checkpoints.path << std::endl;
 }
 
 glm::mat4 prevTransform{1.0f};
 	
 void render(glm::mat4 view, glm::mat4 projection) override {
-	
+	frameStats = FrameStats();
+	size_t stallsBefore = stateRing ? stateRing->stalls : 0;
 	doPhysics();
+	if (stateRing) frameStats.stateRingStalls = stateRing->stalls - stallsBefore;
+	finishSnapshot();
+	finishReadbacks();
 	
 	if (clickData.cubeSel != -1) doDrag();
 	
@@ -534,6 +750,7 @@ void render(glm::mat4 view, glm::mat4 projection) override {
 	
 	auto totalTransform = projection * view * model;
 	prevTransform = totalTransform;
+	lodPixelScale = projection[1][1] * windowData.height / 2;
 	
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -545,6 +762,8 @@ void render(glm::mat4 view, glm::mat4 projection) override {
 		glUseProgram(vectorRenderShader);
 		drawVectors(totalTransform);
 	}
+	// Whatever's drawn from has to be left alone until the GPU's done
+	if (stateRing) stateRing->fenceCurrent();
 	
 	//glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
 	
@@ -565,7 +784,8 @@ void drawVoxels(glm::mat4 transform, GLuint shader) {
 		//glDrawElements(GL_POINTS, toRender.edgeIndices.size(), GL_UNSIGNED_INT, nullptr);
 		
 		// Draw everything
-		glDrawArrays(GL_POINTS, 0, toRender.cubesPos.size());
+		glDrawArrays(GL_POINTS, 0, toRender.numCubes);
+		++frameStats.surfaceDraws;
 	}
 	else {
 		physBuf1.data3D.bindTex();
@@ -573,99 +793,206 @@ void drawVoxels(glm::mat4 transform, GLuint shader) {
 		debugFeedback.bindTex();
 		faceHighlight.bindTex();
 		
-		glDrawElements(GL_LINES_ADJACENCY, toRender.faceIndices.size(), GL_UNSIGNED_INT, nullptr);
+		unsigned queryIdx = triangleQueryNext;
+		if (triangleQueryPending[queryIdx]) {
+			GLuint available = 0;
+			glGetQueryObjectuiv(triangleQueries[queryIdx], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint triangles = 0;
+				glGetQueryObjectuiv(triangleQueries[queryIdx], GL_QUERY_RESULT, &triangles);
+				trianglesDrawn = triangles;
+				triangleQueryPending[queryIdx] = false;
+			}
+		}
+		bool querying = !triangleQueryPending[queryIdx];
+		if (querying) glBeginQuery(GL_PRIMITIVES_GENERATED, triangleQueries[queryIdx]);
+		drawVisibleFaces(transform);
+		if (querying) {
+			glEndQuery(GL_PRIMITIVES_GENERATED);
+			triangleQueryPending[queryIdx] = true;
+			triangleQueryNext = (queryIdx + 1) % NUM_TRIANGLE_QUERIES;
+		}
+		frameStats.trianglesDrawn = trianglesDrawn;
+	}
+}
+
+// Faces are emitted cube by cube, so each brick's are one run. Bricks are only ever in order, but checked anyway since culling would drop faces otherwise.
+void findBrickFaces() {
+	std::vector<uint32_t>& brickFaceStarts = surfaceLevels[0].brickFaceStarts;
+	size_t numBricks = bounds.layout.numBricks();
+	brickFaceStarts.assign(numBricks + 1, 0);
+	size_t brick = 0;
+	for (size_t face = 0; face < toRender.numFaces; ++face) {
+		size_t faceBrick = bounds.layout.brickOf(toRender.faceCubes[face]);
+		if (faceBrick < brick) {
+			std::cerr << "Faces aren't grouped by brick; drawing all of them" << std::endl;
+			brickFaceStarts.clear();
+			return;
+		}
+		while (brick < faceBrick) brickFaceStarts[++brick] = face;
 	}
+	while (brick < numBricks) brickFaceStarts[++brick] = toRender.numFaces;
+}
+
+// Puts the full surface and the coarser ones after it into vertNeighborVBO and EBO. The coarser ones are only any use if bricks can be
+// drawn separately, and are built here instead of being cached with the topology since they take a few milliseconds.
+void uploadSurfaces() {
+	std::vector<SurfaceLod> lods;
+	if (!surfaceLevels[0].brickFaceStarts.empty()) {
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned level = 1; level < NUM_SURFACE_LODS; ++level) lods.push_back(buildSurfaceLod(toRender, LOD_BLOCK_SIZES[level], bounds.layout));
+		std::cout << "Built coarser surfaces in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+		<< " ms; faces: " << toRender.numFaces;
+		for (const SurfaceLod& lod : lods) std::cout << ", " << lod.numFaces();
+		std::cout << std::endl;
+	}
+	
+	size_t numVerts = toRender.numVerts;
+	surfaceLevels[0].numFaces = toRender.numFaces;
+	for (size_t i = 0; i < lods.size(); ++i) {
+		SurfaceLevel& level = surfaceLevels[i + 1];
+		level.faceStart = surfaceLevels[i].faceStart + surfaceLevels[i].numFaces;
+		level.numFaces = lods[i].numFaces();
+		numVerts += lods[i].numVerts();
+	}
+	const SurfaceLevel& last = surfaceLevels[lods.size()];
+	size_t numFaces = last.faceStart + last.numFaces;
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vertNeighborVBO);
+	glBufferData(GL_ARRAY_BUFFER, numVerts * sizeof(VoxelStorage::VertNeighbors), nullptr, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, toRender.numVerts * sizeof(VoxelStorage::VertNeighbors), toRender.vertsNeighbors);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numFaces * 4 * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, toRender.numFaces * 4 * sizeof(uint32_t), toRender.faceIndices);
+	size_t vertStart = toRender.numVerts;
+	for (size_t i = 0; i < lods.size(); ++i) {
+		SurfaceLod& lod = lods[i];
+		SurfaceLevel& level = surfaceLevels[i + 1];
+		for (uint32_t& idx : lod.faceIndices) idx += vertStart;
+		for (uint32_t start : lod.brickFaceStarts) level.brickFaceStarts.push_back(level.faceStart + start);
+		glBufferSubData(GL_ARRAY_BUFFER, vertStart * sizeof(VoxelStorage::VertNeighbors), lod.numVerts() * sizeof(VoxelStorage::VertNeighbors), lod.vertsNeighbors.data());
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, level.faceStart * 4 * sizeof(uint32_t), lod.faceIndices.size() * sizeof(uint32_t), lod.faceIndices.data());
+		vertStart += lod.numVerts();
+	}
+}
+
+// The coarsest level whose faces come out at most LOD_MAX_FACE_PIXELS across, at the nearest corner of brick
+unsigned surfaceLevelFor(const Aabb& brick, glm::mat4 transform) {
+	// Clip space w, which is what the projection divides by
+	glm::vec4 wRow(transform[0][3], transform[1][3], transform[2][3], transform[3][3]);
+	float nearest = INFINITY;
+	for (int c = 0; c < 8; ++c) {
+		glm::vec4 corner(c & 1 ? brick.max.x : brick.min.x, c & 2 ? brick.max.y : brick.min.y, c & 4 ? brick.max.z : brick.min.z, 1);
+		nearest = std::min(nearest, glm::dot(wRow, corner));
+	}
+	if (nearest <= 0) return 0;
+	float cubePixels = lodPixelScale / nearest;
+	unsigned level = 0;
+	while (level + 1 < NUM_SURFACE_LODS && surfaceLevels[level + 1].numFaces > 0 && LOD_BLOCK_SIZES[level + 1] * cubePixels <= LOD_MAX_FACE_PIXELS) {
+		++level;
+	}
+	return level;
+}
+
+// Faces start through end of EBO, all of one level. faceOffset is where they start, since gl_PrimitiveID starts over with each draw,
+// or -1 for the coarser levels, which don't have highlights.
+void drawFaces(unsigned level, size_t start, size_t end) {
+	if (end == start) return;
+	glUniform1i(faceOffsetLoc, level == 0 ? GLint(start) : -1);
+	glUniform1f(texScaleLoc, LOD_BLOCK_SIZES[level]);
+	glDrawElements(GL_LINES_ADJACENCY, (end - start) * 4, GL_UNSIGNED_INT, (void*) (start * 4 * sizeof(uint32_t)));
+	++frameStats.surfaceDraws;
+	frameStats.facesDrawn += end - start;
+	frameStats.lodFacesDrawn[level] += end - start;
+}
+
+// One draw per run of bricks in view that are at the same level of detail. Neighboring bricks at different levels can leave a crack
+// or overlap between them, but only where faces are a few pixels across.
+void drawVisibleFaces(glm::mat4 transform) {
+	if (surfaceLevels[0].brickFaceStarts.empty() || bounds.all.empty()) {
+		drawFaces(0, 0, toRender.numFaces);
+		return;
+	}
+	Frustum frustum(transform);
+	// How far any cube could have gone since the readback the bounds are from
+	float slack = bounds.maxSpeed * (stepCount - boundsStep) * PHYS_TIME_DELTA;
+	
+	unsigned runLevel = 0;
+	size_t runStart = 0, runEnd = 0;
+	for (size_t b = 0; b < bounds.layout.numBodies(); ++b) {
+		// Bodies off screen skip all their bricks at once. Padded for the coarsest surface, whose faces can reach the furthest.
+		Aabb body = bounds.bodies[b];
+		body.pad(slack + LOD_BLOCK_SIZES[NUM_SURFACE_LODS - 1]);
+		if (!frustum.intersects(body)) continue;
+		for (size_t i = bounds.layout.bodyBrickStarts[b]; i < bounds.layout.bodyBrickStarts[b + 1]; ++i) {
+			Aabb brick = bounds.bricks[i];
+			brick.pad(slack);
+			if (brick.empty()) continue;
+			unsigned level = surfaceLevelFor(brick, transform);
+			// A coarse face can be made from the cubes of the next brick over
+			if (level > 0) brick.pad(LOD_BLOCK_SIZES[level]);
+			if (!frustum.intersects(brick)) continue;
+			const std::vector<uint32_t>& brickFaceStarts = surfaceLevels[level].brickFaceStarts;
+			if (level != runLevel || brickFaceStarts[i] > runEnd + MIN_CULLED_FACES) {
+				drawFaces(runLevel, runStart, runEnd);
+				runLevel = level;
+				runStart = brickFaceStarts[i];
+			}
+			runEnd = brickFaceStarts[i + 1];
+		}
+	}
+	drawFaces(runLevel, runStart, runEnd);
 }
 void drawVectors(glm::mat4 transform) {
 	glBindVertexArray(vectorRenderVAO);
 	glUniformMatrix4fv(glGetUniformLocation(vectorRenderShader, "transform"), 1, GL_FALSE, glm::value_ptr(transform));
 	
-	glDrawArrays(GL_POINTS, 0, toRender.cubesPos.size());
+	glDrawArrays(GL_POINTS, 0, toRender.numCubes);
+	++frameStats.surfaceDraws;
 }
 
+FrameStats lastFrameStats() const override { return frameStats; }
+void setPaused(bool pause) override { paused = pause; }
+bool animating() const override {
+	return !paused || doingStep || clickData.cubeSel != -1 || readbackHead != readbackTail || snapshotFence != nullptr;
+}
+
+
+// Casts a ray from the cursor through the surface as of the latest readback, and returns the cube it hit, or -1. Doesn't touch the GPU.
+int pickCube(glm::vec3& rayDir) {
+	glm::dvec2 virtualCursor;
+	glfwGetCursorPos(windowData.window, &virtualCursor.x, &virtualCursor.y);
+	glm::ivec4 viewport(0, 0, windowData.width, windowData.height);
 	
-GLuint pickerFBO, pickerColorBuf, pickerDepthStencilBuf;
-void initPicking() {
-	glGenFramebuffers(1, &pickerFBO);
-	glGenRenderbuffers(2, &pickerColorBuf);
-	
-	glBindRenderbuffer(GL_RENDERBUFFER, pickerColorBuf);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
-	glBindRenderbuffer(GL_RENDERBUFFER, pickerDepthStencilBuf);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, 1, 1);
-	
-	glBindFramebuffer(GL_FRAMEBUFFER, pickerFBO);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, pickerColorBuf);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, pickerDepthStencilBuf);
+	glm::vec3 cursor(virtualCursor.x, windowData.height - virtualCursor.y, 0);
+	glm::vec3 nearPoint = glm::unProject(cursor, glm::mat4(1.0f), prevTransform, viewport);
+	cursor.z = 1;
+	glm::vec3 farPoint = glm::unProject(cursor, glm::mat4(1.0f), prevTransform, viewport);
 	
-	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	std::cerr << "Picking framebuffer is not complete!" << std::endl;
+	rayDir = farPoint - nearPoint;
+	SurfacePicker::Hit hit;
+	if (!picker.raycast(nearPoint, rayDir, hit)) return -1;
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	std::cout << "clicked face " << hit.face << std::endl;
+	return toRender.faceCubes[hit.face];
 }
 
 void getClickPos() {
 	glm::dvec2 virtualCursor;
 	glfwGetCursorPos(windowData.window, &virtualCursor.x, &virtualCursor.y);
-	
-	// COLUMN WISE!
-	glm::mat4 pixelTransform(
-		windowData.width, 0, 0, 0,
-		0, windowData.height, 0, 0,
-		0, 0, 1, 0,
-		windowData.width - virtualCursor.x * 2, virtualCursor.y * 2 - windowData.height, 0, 1
-	);
-	int oldViewport[4];
-	glGetIntegerv(GL_VIEWPORT, oldViewport);
-	glBindFramebuffer(GL_FRAMEBUFFER, pickerFBO);
-	glViewport(0, 0, 1, 1);
-	
-	glDisable(GL_MULTISAMPLE);
-	
-	glClearColor(1, 1, 1, 1);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	drawVoxels(pixelTransform * prevTransform, pickingShader);
-	
-	glReadBuffer(GL_COLOR_ATTACHMENT0);
-	//std::vector<uint8_t> data(40000);
-	//glReadPixels(0, 0, 100, 100, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-	//dumpImage(data.data(), 100, 100);
-	
-	uint8_t pickedPixel[4];
-	glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pickedPixel);
-	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
-	
-	std::cout << "clicked r:" << (int) pickedPixel[0] << " g:" << (int) pickedPixel[1] << " b:" << (int) pickedPixel[2] << " a:" << (int) pickedPixel[3] << std::endl;
-	
-	int faceID = pickedPixel[0] +
-	pickedPixel[1] * 0x100 +
-	pickedPixel[2] * 0x10000;
-	
-	if (faceID >= 0xFFFFFF) return;
-	
-	std::cout << "clicked face " << faceID << std::endl;
-	
-	clickData.cubeSel = toRender.faceCubes[faceID];
+	glm::vec3 rayDir;
+	clickData.cubeSel = pickCube(rayDir);
+	if (clickData.cubeSel == -1) return;
 	std::cout << "clicked cube " << clickData.cubeSel << std::endl;
 	
-	glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data3D.buf);
-	glm::vec3 pickedCubePos;
-	glGetBufferSubData(GL_ARRAY_BUFFER, clickData.cubeSel * sizeof(PhysData3D), sizeof(glm::vec3), &pickedCubePos);
+	glm::vec3 pickedCubePos = skin.cubePositions()[clickData.cubeSel];
 	
 	// Highlight selected cube
-	for (int queryFace = faceID + 1; toRender.faceCubes[queryFace] == clickData.cubeSel; ++queryFace) {
-		++clickData.cubeFacesCount;
-	}
-	for (int queryFace = faceID; toRender.faceCubes[queryFace] == clickData.cubeSel; --queryFace) {
-		++clickData.cubeFacesCount;
-		clickData.cubeFacesStart = queryFace;
-	}
-	
 	glBindBuffer(GL_ARRAY_BUFFER, faceHighlight.buf);
-	uint8_t fullHighlights[6] = { 255, 255, 255, 255, 255, 255 };
-	glBufferSubData(GL_ARRAY_BUFFER, clickData.cubeFacesStart, clickData.cubeFacesCount, &fullHighlights);
+	uint8_t fullHighlight = 255;
+	for (const uint32_t* face = picker.cubeFacesBegin(clickData.cubeSel); face != picker.cubeFacesEnd(clickData.cubeSel); ++face) {
+		glBufferSubData(GL_ARRAY_BUFFER, *face, 1, &fullHighlight);
+	}
 	
 	std::cout << "cube pos: x:" << pickedCubePos.x << " y:" << pickedCubePos.y << " z:" << pickedCubePos.z << std::endl;
 	/*
@@ -696,8 +1023,24 @@ void getClickPos() {
 }
 
 
-void mouseDown() {
+void mouseDown(int mods) {
+	if (mods & GLFW_MOD_SHIFT) {
+		glm::vec3 rayDir;
+		int cube = pickCube(rayDir);
+		if (cube == -1) return;
+		const CubeConstraint* existing = constraints.find(cube);
+		if (existing && existing->pinned != 0) constraints.release(cube);
+		else constraints.pin(cube, skin.cubePositions()[cube]);
+		return;
+	}
 	getClickPos();
+	if (clickData.cubeSel != -1) constraints.grab(clickData.cubeSel, skin.cubePositions()[clickData.cubeSel]);
+}
+
+void poke() {
+	glm::vec3 rayDir;
+	int cube = pickCube(rayDir);
+	if (cube != -1) constraints.impulse(cube, glm::normalize(rayDir) * POKE_SPEED);
 }
 
 void doDrag() {
@@ -706,27 +1049,28 @@ void doDrag() {
 	
 	glm::vec3 mouseWorld = glm::unProject(glm::vec3(cursorPos.x, windowData.height - cursorPos.y, clickData.screenDepth), glm::mat4(1.0f), prevTransform, glm::ivec4(0, 0, windowData.width, windowData.height));
 	
-	glm::vec3 newCubePos = mouseWorld + clickData.worldOffset;
-	
-	glBindBuffer(GL_ARRAY_BUFFER, physBuf1.data3D.buf);
-	glBufferSubData(GL_ARRAY_BUFFER, clickData.cubeSel * sizeof(PhysData3D), sizeof(glm::vec3), &newCubePos);
+	// The solver pulls the cube there, rather than it being moved there
+	constraints.moveTarget(clickData.cubeSel, mouseWorld + clickData.worldOffset);
 }
 	
 void mouseUp() {
 	if (clickData.cubeSel != -1) {
 		// Unhighlight
 		glBindBuffer(GL_ARRAY_BUFFER, faceHighlight.buf);
-		uint8_t noHighlights[6] = { 0, 0, 0, 0, 0, 0 };
-		glBufferSubData(GL_ARRAY_BUFFER, clickData.cubeFacesStart, clickData.cubeFacesCount, &noHighlights);
+		uint8_t noHighlight = 0;
+		for (const uint32_t* face = picker.cubeFacesBegin(clickData.cubeSel); face != picker.cubeFacesEnd(clickData.cubeSel); ++face) {
+			glBufferSubData(GL_ARRAY_BUFFER, *face, 1, &noHighlight);
+		}
 		
+		constraints.release(clickData.cubeSel);
 		clickData = ClickData();
 	}
 }
 	
 };
 
-std::unique_ptr<VoxelRenderer> getVoxelRenderer() {
-	return std::make_unique<VoxelRendererImpl>();
+std::unique_ptr<VoxelRenderer> getVoxelRenderer(std::unique_ptr<CachedTopology> body, const CheckpointSettings& checkpoints, const RendererSettings& settings) {
+	return std::make_unique<VoxelRendererImpl>(std::move(body), checkpoints, settings);
 }
 
 
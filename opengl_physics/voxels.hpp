@@ -5,14 +5,58 @@
 #include <memory>
 
 
+constexpr float RADIUS = 10;
+constexpr int PHYS_STEPS_PER_FRAME = 2;
+constexpr int SLOWDOWN_FACTOR = 1;
+constexpr float PHYS_TIME_DELTA = 1.0/60.0/PHYS_STEPS_PER_FRAME;
+// How much memory holding frames to rewind to can use, unless --rewind-mb says otherwise. About 40 KB a frame per thousand cubes.
+constexpr size_t DEFAULT_REWIND_BYTES = size_t(256) << 20;
+// Frames between the ones kept to rewind to. Recording one costs about a tenth of a CPU solver step, so keeping every frame would slow it by about 5%.
+constexpr unsigned DEFAULT_REWIND_INTERVAL = 4;
+
+
+// The full surface, then ones made of 2x2x2 and 4x4x4 blocks for bricks too far away for the full one to show
+constexpr unsigned NUM_SURFACE_LODS = 3;
+
+// What the last render call sent to the GPU
+struct FrameStats {
+	unsigned physicsDraws = 0, surfaceDraws = 0;
+	size_t facesDrawn = 0;
+	// Of facesDrawn, how many were from each level of detail
+	size_t lodFacesDrawn[NUM_SURFACE_LODS] = {};
+	// Counted by the GPU, from a query a frame or two old so it's never waited on
+	uint64_t trianglesDrawn = 0;
+	// Times the CPU solver had to wait for the GPU to be done with a state slot
+	unsigned stateRingStalls = 0;
+};
+
 class VoxelRenderer {
 public:
 	virtual void render(glm::mat4 view, glm::mat4 projection) = 0;
+	virtual FrameStats lastFrameStats() const = 0;
+	virtual void setPaused(bool paused) = 0;
+	// Whether the next frame would look different without any input: the sim's running or about to step, a cube's being dragged,
+	// or something's still being read back
+	virtual bool animating() const = 0;
 	virtual ~VoxelRenderer() = default;
 };
 
 
-std::unique_ptr<VoxelRenderer> getVoxelRenderer();
+struct RendererSettings {
+	// Copies of the body side by side, all simulated and drawn together
+	unsigned numBodies = 1;
+	// Threads to run the physics on the CPU with instead of the GPU, or 0 for the GPU
+	unsigned cpuThreads = 0;
+	// For frames to rewind to. 0 doesn't keep any.
+	size_t rewindBytes = DEFAULT_REWIND_BYTES;
+	// Rewinding goes back to the closest kept frame at or before where it's asked to
+	unsigned rewindInterval = DEFAULT_REWIND_INTERVAL;
+};
+
+class CachedTopology;
+struct CheckpointSettings;
+// Drops the body onto the floor
+std::unique_ptr<VoxelRenderer> getVoxelRenderer(std::unique_ptr<CachedTopology> body, const CheckpointSettings& checkpoints, const RendererSettings& settings = RendererSettings());
 
 
 #endif /* voxels_hpp */
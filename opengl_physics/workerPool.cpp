@@ -0,0 +1,71 @@
+#include "workerPool.hpp"
+#include <algorithm>
+
+
+WorkerPool::WorkerPool(unsigned numThreads) {
+	for (unsigned i = 1; i < std::max(numThreads, 1u); ++i) {
+		threads.emplace_back(&WorkerPool::threadMain, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+	for (auto& i : threads) {
+		i.join();
+	}
+}
+
+void WorkerPool::runShare(unsigned worker) {
+	size_t grains = (currentCount + currentGrain - 1) / currentGrain;
+	size_t begin = std::min(grains * worker / size() * currentGrain, currentCount);
+	size_t end = std::min(grains * (worker + 1) / size() * currentGrain, currentCount);
+	if (begin < end) (*currentFunc)(begin, end, worker);
+}
+
+void WorkerPool::parallelFor(size_t count, size_t grain, const RangeFunc& func) {
+	currentFunc = &func;
+	currentCount = count;
+	currentGrain = std::max(grain, (size_t) 1);
+
+	if (threads.empty()) {
+		runShare(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		remaining = (unsigned) threads.size();
+		++generation;
+	}
+	workReady.notify_all();
+
+	runShare(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this] { return remaining == 0; });
+}
+
+void WorkerPool::threadMain(unsigned worker) {
+	unsigned seenGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workReady.wait(lock, [&] { return stopping || generation != seenGeneration; });
+			if (stopping) return;
+			seenGeneration = generation;
+		}
+
+		runShare(worker);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = --remaining == 0;
+		}
+		if (last) workDone.notify_one();
+	}
+}
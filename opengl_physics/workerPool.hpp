@@ -0,0 +1,42 @@
+#ifndef workerPool_hpp
+#define workerPool_hpp
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+// A fixed set of threads that split loops over cubes between them. The calling thread does a share of the work too, so a pool of 1 runs everything inline.
+class WorkerPool {
+public:
+	// (begin, end, worker)
+	typedef std::function<void(size_t, size_t, unsigned)> RangeFunc;
+
+	explicit WorkerPool(unsigned threads = 1);
+	~WorkerPool();
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	unsigned size() const { return (unsigned) threads.size() + 1; }
+
+	// Splits [0, count) into one contiguous range per worker, with every boundary a multiple of grain, and returns once all of them are done.
+	// Worker n always gets the nth range, so per-worker results can be merged in a fixed order.
+	void parallelFor(size_t count, size_t grain, const RangeFunc& func);
+
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workReady, workDone;
+	const RangeFunc* currentFunc = nullptr;
+	size_t currentCount = 0, currentGrain = 1;
+	unsigned generation = 0, remaining = 0;
+	bool stopping = false;
+
+	void runShare(unsigned worker);
+	void threadMain(unsigned worker);
+};
+
+
+#endif /* workerPool_hpp */